@@ -0,0 +1,21 @@
+#ifndef ATTACKS_H
+#define ATTACKS_H
+
+
+#include <stdint.h>  // for uint64_t
+#include "chess.h"
+
+
+/* Every square one side attacks, whether empty, friendly or enemy */
+typedef struct {
+	uint64_t by_type[6];  // Indexed by [PieceType]
+	uint64_t all;
+} AttackMap;
+
+
+/* FUNCTION DEFINITIONS */
+void compute_attack_map(Board* board_ptr, Colour colour, AttackMap* attacks_ptr);
+bool square_attacked(AttackMap* attacks_ptr, Square square);
+
+
+#endif  /* ATTACKS_H */
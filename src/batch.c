@@ -0,0 +1,254 @@
+#include <pthread.h>  // for pthread_create, pthread_cond_t and pthread_mutex_t
+#include <stdbool.h>  // for bool
+#include <stdio.h>  // for fgets, fopen, feof, getc, printf and putchar
+#include <stdlib.h>  // for atoi, atoll, malloc and free
+#include <string.h>  // for strchr, strcmp, strcpy and strcspn
+#include <unistd.h>  // for sysconf
+#include "chess.h"
+#include "board.h"
+#include "interface.h"
+#include "search.h"
+#include "tt.h"
+
+
+#define BATCH_QUEUE_SIZE 1024  // Positions in flight, read but not yet written
+#define BATCH_LINE_LENGTH 256
+#define DEFAULT_BATCH_DEPTH 6
+#define BATCH_HASH_MB 16  // Per worker
+
+
+typedef enum {
+	SLOT_EMPTY,
+	SLOT_PENDING,
+	SLOT_RUNNING,
+	SLOT_DONE,
+} SlotState;
+
+
+typedef struct {
+	SlotState state;
+	char fen[BATCH_LINE_LENGTH];
+	char* error;  // Why the line was rejected, 0 for positions to search
+	Move best_move;
+	int score;
+	int depth;
+	long long nodes;
+} BatchSlot;
+
+
+/* Positions are numbered in input order and live in slot number % size
+   until written, which bounds memory however long the input is */
+typedef struct {
+	SearchLimits limits;
+	BatchSlot slots[BATCH_QUEUE_SIZE];
+
+	pthread_mutex_t lock;
+	pthread_cond_t work_ready;  // Signalled when a position is read or input ends
+	pthread_cond_t work_done;  // Signalled when a position has been analysed
+	long long read_count;
+	long long next_to_run;
+	long long next_to_write;
+	bool end_of_input;
+} BatchQueue;
+
+
+/* Each worker keeps one board and one set of search tables for its whole
+   life, so the per-position cost is only setup_board and the search. The
+   transposition table is not cleared between positions, the age counter
+   lets the new search overwrite stale entries instead */
+void* batch_worker(void* arg) {
+	BatchQueue* queue_ptr = arg;
+	Board* board_ptr = malloc(sizeof(Board));
+	SearchInfo* info_ptr = malloc(sizeof(SearchInfo));
+	info_ptr->options = default_search_options;
+	info_ptr->verbose = false;
+	TranspositionTable tt;
+	tt_init(&tt, BATCH_HASH_MB, 1, false);
+	info_ptr->tt_ptr = &tt;
+	info_ptr->trace_ptr = 0;
+	info_ptr->control_ptr = 0;
+
+	while (1) {
+		pthread_mutex_lock(&queue_ptr->lock);
+		while (queue_ptr->next_to_run == queue_ptr->read_count && !queue_ptr->end_of_input) {
+			pthread_cond_wait(&queue_ptr->work_ready, &queue_ptr->lock);
+		}
+		if (queue_ptr->next_to_run == queue_ptr->read_count) {
+			pthread_mutex_unlock(&queue_ptr->lock);
+			break;
+		}
+		BatchSlot* slot_ptr = &queue_ptr->slots[queue_ptr->next_to_run++ % BATCH_QUEUE_SIZE];
+		slot_ptr->state = SLOT_RUNNING;
+		pthread_mutex_unlock(&queue_ptr->lock);
+
+		if (!slot_ptr->error) {
+			setup_board(board_ptr, slot_ptr->fen);
+			clear_search_tables(info_ptr);
+			info_ptr->limits = queue_ptr->limits;
+			search(board_ptr, info_ptr);
+		}
+
+		pthread_mutex_lock(&queue_ptr->lock);
+		if (!slot_ptr->error) {
+			slot_ptr->best_move = info_ptr->best_move;
+			slot_ptr->score = info_ptr->best_score;
+			slot_ptr->depth = info_ptr->completed_depth;
+			slot_ptr->nodes = info_ptr->nodes;
+		}
+		slot_ptr->state = SLOT_DONE;
+		pthread_cond_signal(&queue_ptr->work_done);
+		pthread_mutex_unlock(&queue_ptr->lock);
+	}
+
+	tt_free(&tt);
+	free(info_ptr);
+	free(board_ptr);
+	return 0;
+}
+
+
+/* EPD operations can contain quotes, which JSON needs escaped */
+void print_json_string(char* string) {
+	putchar('"');
+	for (int i = 0; string[i]; i++) {
+		if (string[i] == '"' || string[i] == '\\') {
+			putchar('\\');
+		}
+		putchar(string[i]);
+	}
+	putchar('"');
+}
+
+
+void print_batch_result(long long id, BatchSlot* slot_ptr) {
+	if (slot_ptr->error) {
+		printf("{\"id\":%lld,\"fen\":", id);
+		print_json_string(slot_ptr->fen);
+		printf(",\"error\":\"%s\"}\n", slot_ptr->error);
+		return;
+	}
+
+	char move_string[6] = "none";
+	if (slot_ptr->best_move.from != NONE) {
+		move_to_string(&slot_ptr->best_move, move_string);
+	}
+
+	printf("{\"id\":%lld,\"fen\":", id);
+	print_json_string(slot_ptr->fen);
+	printf(",\"bestmove\":\"%s\",", move_string);
+	if (slot_ptr->score >= MATE_BOUND) {
+		printf("\"mate\":%d,", (MATE_SCORE - slot_ptr->score + 1) / 2);
+	}
+	else if (slot_ptr->score <= -MATE_BOUND) {
+		printf("\"mate\":%d,", -(MATE_SCORE + slot_ptr->score) / 2);
+	}
+	else {
+		printf("\"cp\":%d,", slot_ptr->score);
+	}
+	printf("\"depth\":%d,\"nodes\":%lld}\n", slot_ptr->depth, slot_ptr->nodes);
+}
+
+
+/* Writes every finished result at the front of the queue, keeping the
+   output in input order. Called with the lock held */
+void flush_batch_results(BatchQueue* queue_ptr) {
+	while (queue_ptr->next_to_write < queue_ptr->next_to_run) {
+		BatchSlot* slot_ptr = &queue_ptr->slots[queue_ptr->next_to_write % BATCH_QUEUE_SIZE];
+		if (slot_ptr->state != SLOT_DONE) {
+			break;
+		}
+		print_batch_result(queue_ptr->next_to_write, slot_ptr);
+		slot_ptr->state = SLOT_EMPTY;
+		queue_ptr->next_to_write++;
+	}
+	fflush(stdout);
+}
+
+
+/* Analyses FEN/EPD lines from a file (or stdin) on a pool of threads and
+   writes one JSON object per position in input order. Usage:
+     batch [file] [depth N] [nodes N] [threads N] */
+void run_batch(int argc, char** argv) {
+	static BatchQueue queue;
+	FILE* input = stdin;
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	queue.limits = (SearchLimits){.depth = DEFAULT_BATCH_DEPTH};
+
+	for (int i = 0; i < argc; i++) {
+		char* value = i + 1 < argc ? argv[i + 1] : "0";
+		if (strcmp(argv[i], "depth") == 0) { queue.limits.depth = atoi(value); i++; }
+		else if (strcmp(argv[i], "nodes") == 0) { queue.limits.nodes = atoll(value); queue.limits.depth = 0; i++; }
+		else if (strcmp(argv[i], "threads") == 0) { threads = atoi(value); i++; }
+		else if (input == stdin && (input = fopen(argv[i], "r"))) {}
+		else {
+			printf("Unknown batch argument or unreadable file: %s\n", argv[i]);
+			return;
+		}
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+
+	pthread_mutex_init(&queue.lock, 0);
+	pthread_cond_init(&queue.work_ready, 0);
+	pthread_cond_init(&queue.work_done, 0);
+
+	pthread_t workers[threads];
+	for (int i = 0; i < threads; i++) {
+		pthread_create(&workers[i], 0, batch_worker, &queue);
+	}
+
+	char line[BATCH_LINE_LENGTH];
+	while (fgets(line, sizeof(line), input)) {
+		// fgets stops early on long lines, the rest must not be read as another position
+		char* error = 0;
+		if (!strchr(line, '\n') && !feof(input)) {
+			error = "line too long";
+			int c;
+			while ((c = getc(input)) != '\n' && c != EOF) {}
+		}
+		line[strcspn(line, "\r\n")] = 0;
+		if (line[0] == 0 || line[0] == '#') {
+			continue;
+		}
+		if (!error && !validate_fen(line)) {
+			error = "invalid fen";
+		}
+
+		pthread_mutex_lock(&queue.lock);
+		// Wait for the writer to free the slot this position maps to
+		flush_batch_results(&queue);
+		while (queue.read_count - queue.next_to_write >= BATCH_QUEUE_SIZE) {
+			pthread_cond_wait(&queue.work_done, &queue.lock);
+			flush_batch_results(&queue);
+		}
+		BatchSlot* slot_ptr = &queue.slots[queue.read_count % BATCH_QUEUE_SIZE];
+		strcpy(slot_ptr->fen, line);
+		slot_ptr->error = error;
+		slot_ptr->state = SLOT_PENDING;
+		queue.read_count++;
+		pthread_cond_signal(&queue.work_ready);
+		pthread_mutex_unlock(&queue.lock);
+	}
+
+	pthread_mutex_lock(&queue.lock);
+	queue.end_of_input = true;
+	pthread_cond_broadcast(&queue.work_ready);
+	flush_batch_results(&queue);
+	while (queue.next_to_write < queue.read_count) {
+		pthread_cond_wait(&queue.work_done, &queue.lock);
+		flush_batch_results(&queue);
+	}
+	pthread_mutex_unlock(&queue.lock);
+
+	for (int i = 0; i < threads; i++) {
+		pthread_join(workers[i], 0);
+	}
+
+	pthread_cond_destroy(&queue.work_done);
+	pthread_cond_destroy(&queue.work_ready);
+	pthread_mutex_destroy(&queue.lock);
+	if (input != stdin) {
+		fclose(input);
+	}
+}
@@ -0,0 +1,9 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+
+/* FUNCTION DEFINITIONS */
+void run_batch(int argc, char** argv);
+
+
+#endif  /* BATCH_H */
@@ -0,0 +1,83 @@
+#include <stdio.h>  // for printf
+#include <stdlib.h>  // for atoi
+#include <string.h>  // for strcmp
+#include <time.h>  // for clock
+#include "chess.h"
+#include "board.h"
+#include "search.h"
+#include "trace.h"
+#include "tt.h"
+
+
+#define DEFAULT_BENCH_DEPTH 5
+#define BENCH_HASH_MB 16
+
+
+// Perft suite positions plus a spread of middlegames and endgames
+char* bench_positions[] = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+	"r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 8",
+	"2r3k1/pp3ppp/4p3/3p4/3P4/P3P3/1P3PPP/2R3K1 w - - 0 25",
+	"8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 50",
+	"6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 30",
+};
+
+
+/* Fixed depth searches over bench_positions. Arguments are an optional depth
+   followed by flags switching off individual search techniques, e.g.
+   "bench 6 no-lmr no-null". "trace <file>" records every node for the trace
+   report */
+void run_bench(int argc, char** argv) {
+	static SearchInfo info;
+	static TranspositionTable tt;
+	static SearchTrace trace;
+	int depth = DEFAULT_BENCH_DEPTH;
+	info.options = default_search_options;
+	info.trace_ptr = 0;
+	info.control_ptr = 0;
+
+	for (int i = 0; i < argc; i++) {
+		if (parse_search_option(argv[i], &info.options)) { continue; }
+		else if (strcmp(argv[i], "trace") == 0 && i + 1 < argc) {
+			if (!trace_open(&trace, argv[++i])) {
+				printf("could not open %s\n", argv[i]);
+				return;
+			}
+			info.trace_ptr = &trace;
+		}
+		else if (atoi(argv[i]) > 0) { depth = atoi(argv[i]); }
+		else { printf("Unknown bench argument: %s\n", argv[i]); return; }
+	}
+
+	tt_init(&tt, BENCH_HASH_MB, 1, false);
+	info.tt_ptr = &tt;
+
+	int position_count = sizeof(bench_positions) / sizeof(bench_positions[0]);
+	long long total_nodes = 0;
+	float start_time = (float)clock()/CLOCKS_PER_SEC;
+
+	for (int i = 0; i < position_count; i++) {
+		Board board = {};
+		setup_board(&board, bench_positions[i]);
+		clear_search_tables(&info);
+		tt_clear(&tt, 1);
+		info.limits = (SearchLimits){.depth = depth};
+
+		search(&board, &info);
+		total_nodes += info.nodes;
+		printf("[%d] score: %d nodes: %lld\n", i + 1, info.best_score, info.nodes);
+	}
+
+	float time_elapsed = (float)clock()/CLOCKS_PER_SEC - start_time;
+	printf("\ndepth: %d nodes: %lld time: %.3fs nps: %.0f\n", depth, total_nodes, time_elapsed, total_nodes / time_elapsed);
+	tt_free(&tt);
+	if (info.trace_ptr) {
+		trace_close(&trace);
+		printf("traced %lld events\n", trace.written);
+	}
+}
@@ -0,0 +1,9 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+
+/* FUNCTION DEFINITIONS */
+void run_bench(int argc, char** argv);
+
+
+#endif  /* BENCH_H */
@@ -0,0 +1,353 @@
+#include <stdbool.h>  // for bool
+#include <stdint.h>  // for uint64_t
+#include <string.h>  // for memcpy and memset
+#include "chess.h"
+#include "bitboard_batch.h"
+
+
+/*
+ * Attacks, pins and legal move counts for many positions at once. Each
+ * field of a PositionBlock is an array over positions, so one bitboard
+ * operation is done for a whole lane group with a single vector
+ * instruction:
+ *
+ *   AVX-512  8 positions per register
+ *   AVX2     4 positions per register
+ *   SSE2     2 positions per register
+ *   scalar   1 position at a time
+ *
+ * The widest the compiler targets is chosen, as in attacks.c. Moves are
+ * counted without being listed. Sliding moves are generated with one fill
+ * per direction for all of a side's sliders together, which counts each
+ * move once because only the nearest slider behind a square reaches it
+ * along a direction. Pinned pieces join the fills along their pin only.
+ */
+
+
+#if defined(__AVX512F__)
+#define LANE_COUNT 8
+#elif defined(__AVX2__)
+#define LANE_COUNT 4
+#elif defined(__SSE2__)
+#define LANE_COUNT 2
+#else
+#define LANE_COUNT 1
+#endif
+
+// GCC lowers operations on the vector type to the widest instructions available
+typedef uint64_t Lanes __attribute__((vector_size(LANE_COUNT * sizeof(uint64_t))));
+
+
+#define NOT_A_FILE 0xFEFEFEFEFEFEFEFEULL
+#define NOT_H_FILE 0x7F7F7F7F7F7F7F7FULL
+#define NOT_AB_FILE 0xFCFCFCFCFCFCFCFCULL
+#define NOT_GH_FILE 0x3F3F3F3F3F3F3F3FULL
+#define RANK_3 0x0000000000FF0000ULL
+#define RANK_8 0xFF00000000000000ULL
+
+#define KINGSIDE_EMPTY ((1ULL << F1) | (1ULL << G1))
+#define KINGSIDE_SAFE ((1ULL << E1) | (1ULL << F1) | (1ULL << G1))
+#define QUEENSIDE_EMPTY ((1ULL << B1) | (1ULL << C1) | (1ULL << D1))
+#define QUEENSIDE_SAFE ((1ULL << C1) | (1ULL << D1) | (1ULL << E1))
+
+
+/* N E NE NW, then the opposites in the same order, so direction & 3 is the
+   line a piece moves along and lines 0 and 1 are the orthogonal ones */
+static const int direction_shifts[8] = {8, 1, 9, 7, -8, -1, -9, -7};
+
+// Stops a shift wrapping from one edge of the board to the other
+static const uint64_t direction_masks[8] = {
+	~0ULL, NOT_A_FILE, NOT_A_FILE, NOT_H_FILE, ~0ULL, NOT_H_FILE, NOT_H_FILE, NOT_A_FILE,
+};
+
+static const int knight_shifts[8] = {17, 15, 10, 6, -15, -17, -6, -10};
+static const uint64_t knight_masks[8] = {
+	NOT_A_FILE, NOT_H_FILE, NOT_AB_FILE, NOT_GH_FILE, NOT_A_FILE, NOT_H_FILE, NOT_AB_FILE, NOT_GH_FILE,
+};
+
+
+ALWAYS_INLINE Lanes load_lanes(const uint64_t* source) {
+	Lanes lanes;
+	memcpy(&lanes, source, sizeof(Lanes));
+	return lanes;
+}
+
+
+ALWAYS_INLINE void store_lanes(uint64_t* destination, Lanes lanes) {
+	memcpy(destination, &lanes, sizeof(Lanes));
+}
+
+
+/* All ones in the lanes where bits is not empty */
+ALWAYS_INLINE Lanes nonzero_lanes(Lanes bits) {
+	return (Lanes)(bits != 0);
+}
+
+
+ALWAYS_INLINE bool any_lane(Lanes bits) {
+	for (int i = 0; i < LANE_COUNT; i++) {
+		if (bits[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+ALWAYS_INLINE Lanes shift_lanes(Lanes bits, int shift) {
+	return shift > 0 ? bits << shift : bits >> -shift;
+}
+
+
+/* Kogge-Stone occluded fill: the squares generators reach along direction
+   through empty squares, including the first blocker */
+ALWAYS_INLINE Lanes slide(Lanes generators, Lanes empty, int direction) {
+	int shift = direction_shifts[direction];
+	uint64_t mask = direction_masks[direction];
+	empty &= mask;
+	generators |= empty & shift_lanes(generators, shift);
+	empty &= shift_lanes(empty, shift);
+	generators |= empty & shift_lanes(generators, shift * 2);
+	empty &= shift_lanes(empty, shift * 2);
+	generators |= empty & shift_lanes(generators, shift * 4);
+	return shift_lanes(generators, shift) & mask;
+}
+
+
+ALWAYS_INLINE Lanes knight_jump(Lanes knights, int jump) {
+	return shift_lanes(knights, knight_shifts[jump]) & knight_masks[jump];
+}
+
+
+ALWAYS_INLINE Lanes knight_lanes(Lanes knights) {
+	Lanes attacks = knight_jump(knights, 0);
+	for (int i = 1; i < 8; i++) {
+		attacks |= knight_jump(knights, i);
+	}
+	return attacks;
+}
+
+
+ALWAYS_INLINE Lanes king_lanes(Lanes kings) {
+	Lanes sideways = ((kings << 1) & NOT_A_FILE) | ((kings >> 1) & NOT_H_FILE);
+	Lanes row = kings | sideways;
+	return sideways | (row << 8) | (row >> 8);
+}
+
+
+// The side to move always moves up the board
+ALWAYS_INLINE Lanes own_pawn_lanes(Lanes pawns) {
+	return ((pawns << 9) & NOT_A_FILE) | ((pawns << 7) & NOT_H_FILE);
+}
+
+
+ALWAYS_INLINE Lanes enemy_pawn_lanes(Lanes pawns) {
+	return ((pawns >> 9) & NOT_H_FILE) | ((pawns >> 7) & NOT_A_FILE);
+}
+
+
+ALWAYS_INLINE void count_moves(int* counts, Lanes targets) {
+	for (int i = 0; i < LANE_COUNT; i++) {
+		counts[i] += __builtin_popcountll(targets[i]);
+	}
+}
+
+
+// A pawn reaching the last rank has four moves, one per promotion piece
+ALWAYS_INLINE void count_pawn_moves(int* counts, Lanes targets) {
+	for (int i = 0; i < LANE_COUNT; i++) {
+		counts[i] += __builtin_popcountll(targets[i] & ~RANK_8) + 4 * __builtin_popcountll(targets[i] & RANK_8);
+	}
+}
+
+
+/* Whether the king would be safe on the given occupancy with the given enemy
+   pawns, which is all an en passant capture changes */
+ALWAYS_INLINE Lanes king_safe_lanes(Lanes king, Lanes occupied, Lanes enemy_pawns, Lanes* enemy) {
+	Lanes hits = (enemy_pawns & own_pawn_lanes(king)) | (enemy[KNIGHT] & knight_lanes(king));
+	Lanes orthogonal = enemy[ROOK] | enemy[QUEEN];
+	Lanes diagonal = enemy[BISHOP] | enemy[QUEEN];
+	for (int direction = 0; direction < 8; direction++) {
+		hits |= slide(king, ~occupied, direction) & ((direction & 3) < 2 ? orthogonal : diagonal);
+	}
+	return ~nonzero_lanes(hits);
+}
+
+
+void analyse_lanes(PositionBlock* block_ptr, int first, BlockAnalysis* analysis_ptr) {
+	Lanes own[6];
+	Lanes enemy[6];
+	Lanes own_all = {};
+	Lanes enemy_all = {};
+	for (int type = PAWN; type <= KING; type++) {
+		own[type] = load_lanes(&block_ptr->own[type][first]);
+		enemy[type] = load_lanes(&block_ptr->enemy[type][first]);
+		own_all |= own[type];
+		enemy_all |= enemy[type];
+	}
+	Lanes occupied = own_all | enemy_all;
+	Lanes empty = ~occupied;
+	Lanes king = own[KING];
+	Lanes enemy_orthogonal = enemy[ROOK] | enemy[QUEEN];
+	Lanes enemy_diagonal = enemy[BISHOP] | enemy[QUEEN];
+
+	// Enemy sliders see through the king, so it cannot step back along a check
+	Lanes attacked = enemy_pawn_lanes(enemy[PAWN]) | knight_lanes(enemy[KNIGHT]) | king_lanes(enemy[KING]);
+	Lanes checkers = (enemy[PAWN] & own_pawn_lanes(king)) | (enemy[KNIGHT] & knight_lanes(king));
+	Lanes check_rays = {};
+	Lanes pinned_on[4] = {};
+	for (int direction = 0; direction < 8; direction++) {
+		Lanes sliders = (direction & 3) < 2 ? enemy_orthogonal : enemy_diagonal;
+		attacked |= slide(sliders, empty | king, direction);
+
+		Lanes ray = slide(king, empty, direction);
+		Lanes checker = ray & sliders;
+		checkers |= checker;
+		check_rays |= ray & nonzero_lanes(checker);
+
+		// Looking through the first piece of ours finds what pins it
+		Lanes blocker = ray & own_all;
+		Lanes pin_ray = slide(king, empty | blocker, direction);
+		pinned_on[direction & 3] |= blocker & nonzero_lanes(pin_ray & sliders);
+	}
+	Lanes pinned = pinned_on[0] | pinned_on[1] | pinned_on[2] | pinned_on[3];
+
+	// Other pieces may go anywhere outside check, must capture or block a
+	// single checker and cannot help against two
+	Lanes in_check = nonzero_lanes(checkers);
+	Lanes double_check = nonzero_lanes(checkers & (checkers - 1));
+	Lanes targets = ~own_all & (~in_check | check_rays | checkers) & ~double_check;
+
+	int counts[LANE_COUNT] = {};
+	count_moves(counts, king_lanes(king) & ~own_all & ~attacked);
+
+	Lanes castling = load_lanes(&block_ptr->castling[first]);
+	Lanes can_castle = ~in_check & 1;
+	Lanes kingside = nonzero_lanes(castling & (1ULL << H1)) & ~nonzero_lanes(occupied & KINGSIDE_EMPTY) & ~nonzero_lanes(attacked & KINGSIDE_SAFE);
+	Lanes queenside = nonzero_lanes(castling & (1ULL << A1)) & ~nonzero_lanes(occupied & QUEENSIDE_EMPTY) & ~nonzero_lanes(attacked & QUEENSIDE_SAFE);
+	count_moves(counts, (kingside & can_castle) | ((queenside & can_castle) << 1));
+
+	Lanes knights = own[KNIGHT] & ~pinned;
+	for (int jump = 0; jump < 8; jump++) {
+		count_moves(counts, knight_jump(knights, jump) & targets);
+	}
+
+	Lanes own_orthogonal = own[ROOK] | own[QUEEN];
+	Lanes own_diagonal = own[BISHOP] | own[QUEEN];
+	for (int direction = 0; direction < 8; direction++) {
+		Lanes sliders = (direction & 3) < 2 ? own_orthogonal : own_diagonal;
+		sliders &= ~pinned | pinned_on[direction & 3];
+		count_moves(counts, slide(sliders, empty, direction) & targets);
+	}
+
+	// Pushes stay on the file, each capture on its own diagonal
+	Lanes pushers = own[PAWN] & (~pinned | pinned_on[0]);
+	Lanes single_pushes = (pushers << 8) & empty;
+	Lanes double_pushes = ((single_pushes & RANK_3) << 8) & empty;
+	Lanes east_captures = ((own[PAWN] & (~pinned | pinned_on[2])) << 9) & NOT_A_FILE & enemy_all;
+	Lanes west_captures = ((own[PAWN] & (~pinned | pinned_on[3])) << 7) & NOT_H_FILE & enemy_all;
+	count_pawn_moves(counts, (single_pushes & targets) | (double_pushes & targets));
+	count_pawn_moves(counts, east_captures & targets);
+	count_pawn_moves(counts, west_captures & targets);
+
+	// Rare and awkward to pin down (the captured pawn may be the checker, or
+	// both pawns may leave a rank), so checked by replaying the capture
+	Lanes en_passant = load_lanes(&block_ptr->en_passant[first]);
+	Lanes east_capturer = (en_passant >> 9) & NOT_H_FILE & own[PAWN];
+	Lanes west_capturer = (en_passant >> 7) & NOT_A_FILE & own[PAWN];
+	if (any_lane(east_capturer | west_capturer)) {
+		Lanes captured = en_passant >> 8;
+		Lanes remaining_pawns = enemy[PAWN] & ~captured;
+		Lanes after = occupied ^ en_passant ^ captured;
+		Lanes east_legal = king_safe_lanes(king, after ^ east_capturer, remaining_pawns, enemy);
+		Lanes west_legal = king_safe_lanes(king, after ^ west_capturer, remaining_pawns, enemy);
+		count_moves(counts, (nonzero_lanes(east_capturer) & east_legal & 1) | (nonzero_lanes(west_capturer) & west_legal & 2));
+	}
+
+	store_lanes(&analysis_ptr->attacked[first], attacked);
+	store_lanes(&analysis_ptr->checkers[first], checkers);
+	store_lanes(&analysis_ptr->pinned[first], pinned);
+	for (int i = 0; i < LANE_COUNT; i++) {
+		analysis_ptr->legal_moves[first + i] = counts[i];
+	}
+}
+
+
+/* Unused positions are left empty, which the kernel handles like any other */
+void load_position_block(PositionBlock* block_ptr, Board** board_ptrs, int count) {
+	memset(block_ptr, 0, sizeof(PositionBlock));
+	block_ptr->count = count;
+	for (int i = 0; i < count; i++) {
+		Board* board_ptr = board_ptrs[i];
+		Colour us = board_ptr->current_turn;
+		int mirror = us == WHITE ? 0 : 56;
+		block_ptr->mirrored[i] = us == BLACK;
+
+		for (Colour player = WHITE; player <= BLACK; player++) {
+			for (int j = 0; j < 16; j++) {
+				Piece* piece_ptr = &board_ptr->player_pieces[player][j];
+				if (!piece_ptr->alive) {
+					continue;
+				}
+				uint64_t bit = 1ULL << (piece_ptr->square ^ mirror);
+				if (player == us) {
+					block_ptr->own[piece_ptr->type][i] |= bit;
+				}
+				else {
+					block_ptr->enemy[piece_ptr->type][i] |= bit;
+				}
+			}
+		}
+
+		if (board_ptr->en_passant_target != NONE) {
+			block_ptr->en_passant[i] = 1ULL << (board_ptr->en_passant_target ^ mirror);
+		}
+		if (board_ptr->castling_rights[us][KINGSIDE]) {
+			block_ptr->castling[i] |= 1ULL << H1;
+		}
+		if (board_ptr->castling_rights[us][QUEENSIDE]) {
+			block_ptr->castling[i] |= 1ULL << A1;
+		}
+	}
+}
+
+
+void analyse_position_block(PositionBlock* block_ptr, BlockAnalysis* analysis_ptr) {
+	for (int first = 0; first < POSITION_BLOCK_SIZE; first += LANE_COUNT) {
+		analyse_lanes(block_ptr, first, analysis_ptr);
+	}
+
+	// Back to the orientation of the boards
+	for (int i = 0; i < block_ptr->count; i++) {
+		if (block_ptr->mirrored[i]) {
+			analysis_ptr->attacked[i] = __builtin_bswap64(analysis_ptr->attacked[i]);
+			analysis_ptr->checkers[i] = __builtin_bswap64(analysis_ptr->checkers[i]);
+			analysis_ptr->pinned[i] = __builtin_bswap64(analysis_ptr->pinned[i]);
+		}
+	}
+}
+
+
+void batch_legal_move_counts(Board** board_ptrs, int count, int* move_counts) {
+	PositionBlock block;
+	BlockAnalysis analysis;
+	for (int first = 0; first < count; first += POSITION_BLOCK_SIZE) {
+		int block_count = count - first < POSITION_BLOCK_SIZE ? count - first : POSITION_BLOCK_SIZE;
+		load_position_block(&block, &board_ptrs[first], block_count);
+		analyse_position_block(&block, &analysis);
+		for (int i = 0; i < block_count; i++) {
+			move_counts[first + i] = analysis.legal_moves[i];
+		}
+	}
+}
+
+
+/* Legal move count for one position, running a single lane group of the
+   kernel rather than a whole block */
+int count_legal_moves(Board* board_ptr) {
+	PositionBlock block;
+	BlockAnalysis analysis;
+	load_position_block(&block, &board_ptr, 1);
+	analyse_lanes(&block, 0, &analysis);
+	return analysis.legal_moves[0];
+}
@@ -0,0 +1,43 @@
+#ifndef BITBOARD_BATCH_H
+#define BITBOARD_BATCH_H
+
+
+#include <stdbool.h>  // for bool
+#include <stdint.h>  // for uint64_t
+#include "chess.h"
+
+
+#define POSITION_BLOCK_SIZE 8  // Positions analysed together, a multiple of every lane count
+
+
+/* Structure of arrays: entry [i] of every field belongs to position i. Each
+   position is stored from the side to move's point of view, mirrored top to
+   bottom when black is to move, so every lane runs the same white to move
+   code */
+typedef struct {
+	uint64_t own[6][POSITION_BLOCK_SIZE];  // Indexed by [PieceType][position]
+	uint64_t enemy[6][POSITION_BLOCK_SIZE];
+	uint64_t en_passant[POSITION_BLOCK_SIZE];  // Target square, 0 for none
+	uint64_t castling[POSITION_BLOCK_SIZE];  // A1 and H1 for each side the king may still castle to
+	bool mirrored[POSITION_BLOCK_SIZE];
+	int count;
+} PositionBlock;
+
+
+/* Results in the orientation of the original boards */
+typedef struct {
+	uint64_t attacked[POSITION_BLOCK_SIZE];  // By the opponent, seen through the king
+	uint64_t checkers[POSITION_BLOCK_SIZE];
+	uint64_t pinned[POSITION_BLOCK_SIZE];  // Pieces of the side to move pinned to its king
+	int legal_moves[POSITION_BLOCK_SIZE];
+} BlockAnalysis;
+
+
+/* FUNCTION DEFINITIONS */
+void load_position_block(PositionBlock* block_ptr, Board** board_ptrs, int count);
+void analyse_position_block(PositionBlock* block_ptr, BlockAnalysis* analysis_ptr);
+void batch_legal_move_counts(Board** board_ptrs, int count, int* move_counts);
+int count_legal_moves(Board* board_ptr);
+
+
+#endif  /* BITBOARD_BATCH_H */
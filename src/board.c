@@ -1,6 +1,26 @@
 #include <stdbool.h>  // for bool
 #include <stdlib.h>  // for atoi function
+#include <string.h>  // for memcpy, memset and strchr
 #include "chess.h"
+#include "board.h"
+#include "move_generation.h"
+#include "zobrist.h"
+
+
+const Square king_start_square[2] = {E1, E8};
+const Square castle_rook_from[2][2] = {{A1, H1}, {A8, H8}};
+const Square castle_rook_to[2][2] = {{D1, F1}, {D8, F8}};
+const Square castle_king_to[2][2] = {{C1, G1}, {C8, G8}};
+// Squares between king and rook that must be empty to castle
+const Square castle_empty_squares[2][2][3] = {
+	{{D1, C1, B1}, {F1, G1, NONE}},
+	{{D8, C8, B8}, {F8, G8, NONE}},
+};
+// Squares the king crosses and lands on, which must not be attacked
+const Square castle_king_path[2][2][2] = {
+	{{D1, C1}, {F1, G1}},
+	{{D8, C8}, {F8, G8}},
+};
 
 
 bool inside_board(int file, int rank) {
@@ -54,9 +74,87 @@ void symbol_to_piece_init(Piece* piece_ptr, char symbol, Square square) {
 }
 
 
-/* TODO: Add error handling for invalid FEN strings */
+/* Checks the fields setup_board relies on: eight ranks of eight squares,
+   one king and at most sixteen pieces a side, no pawns on the back ranks,
+   the side to move, castling rights and en passant square. Counters are
+   optional as in EPD. The position must also be reachable as far as move
+   generation cares: the side that just moved is not in check, and an en
+   passant square is behind a pawn that has just pushed two squares */
+bool validate_fen(char* fen_string) {
+	char placement[8][8] = {};  // Indexed by [rank][file], the eighth rank first
+	int piece_count[2] = {0};
+	int king_count[2] = {0};
+	int rank = 0;
+	int file = 0;
+	int i;
+	for (i = 0; fen_string[i] && fen_string[i] != ' '; i++) {
+		char c = fen_string[i];
+		if (c == '/') {
+			if (file != 8 || ++rank > 7) { return false; }
+			file = 0;
+		}
+		else if (c > '0' && c < '9') {
+			file += c - '0';
+		}
+		else if (strchr("PNBRQKpnbrqk", c)) {
+			Colour colour = c >= 'a' ? BLACK : WHITE;
+			piece_count[colour]++;
+			king_count[colour] += c == 'K' || c == 'k';
+			// Pawns can never stand on the first or last rank
+			if ((c == 'P' || c == 'p') && (rank == 0 || rank == 7)) { return false; }
+			if (file < 8) { placement[rank][file] = c; }
+			file++;
+		}
+		else {
+			return false;
+		}
+		if (file > 8) { return false; }
+	}
+	if (rank != 7 || file != 8) { return false; }
+	for (int colour = 0; colour < 2; colour++) {
+		if (king_count[colour] != 1 || piece_count[colour] > 16) { return false; }
+	}
+
+	if (fen_string[i] != ' ' || (fen_string[i + 1] != 'w' && fen_string[i + 1] != 'b') || fen_string[i + 2] != ' ') {
+		return false;
+	}
+	Colour turn = fen_string[i + 1] == 'w' ? WHITE : BLACK;
+	for (i += 3; fen_string[i] && fen_string[i] != ' '; i++) {
+		if (!strchr("KQkq-", fen_string[i])) { return false; }
+	}
+	if (fen_string[i] != ' ') { return false; }
+
+	i++;
+	if (fen_string[i] != '-') {
+		// Rows counted from the eighth rank: the en passant square, the pushed
+		// pawn in front of it and the square the pawn came from
+		int ep_file = fen_string[i] - 'a';
+		int ep_row = turn == WHITE ? 2 : 5;
+		int pawn_row = turn == WHITE ? 3 : 4;
+		int start_row = turn == WHITE ? 1 : 6;
+		if (
+			ep_file < 0 || ep_file > 7 || fen_string[i + 1] != (turn == WHITE ? '6' : '3') ||
+			placement[pawn_row][ep_file] != (turn == WHITE ? 'p' : 'P') ||
+			placement[ep_row][ep_file] || placement[start_row][ep_file]
+		) {
+			return false;
+		}
+	}
+
+	Board board;
+	setup_board(&board, fen_string);
+	return !king_in_check(&board, get_opponent_colour(turn));
+}
+
+
+/* Expects a well formed FEN, see validate_fen */
 // rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1
 void setup_board(Board* board_ptr, char* fen_string) {
+	// Clear anything left behind by a previous position
+	memset(board_ptr->squares, 0, sizeof(board_ptr->squares));
+	memset(board_ptr->player_pieces, 0, sizeof(board_ptr->player_pieces));
+	memset(board_ptr->piece_counts, 0, sizeof(board_ptr->piece_counts));
+
 	// To keep track of next free index in player_pieces
 	int piece_len[2] = {0};
 
@@ -92,6 +190,7 @@ void setup_board(Board* board_ptr, char* fen_string) {
 			}
 			// Board square points to piece in player_pieces array
 			board_ptr->squares[square] = piece_ptr;
+			board_ptr->piece_counts[piece.colour][piece.type]++;
 			x++;
 		}
 	}
@@ -104,7 +203,7 @@ void setup_board(Board* board_ptr, char* fen_string) {
 	// Read and setup castling rights from fen string
 	board_ptr->castling_rights[WHITE][KINGSIDE] = false;
 	board_ptr->castling_rights[WHITE][QUEENSIDE] = false;
-	board_ptr->castling_rights[BLACK][QUEENSIDE] = false;
+	board_ptr->castling_rights[BLACK][KINGSIDE] = false;
 	board_ptr->castling_rights[BLACK][QUEENSIDE] = false;
 	for (i += 2; (c = fen_string[i]) != ' '; i++) {
 		switch (c) {
@@ -123,6 +222,21 @@ void setup_board(Board* board_ptr, char* fen_string) {
 		}
 	}
 
+	// Drop rights the pieces on the board cannot back up, as castling
+	// would otherwise move a rook that is not there
+	for (Colour colour = WHITE; colour <= BLACK; colour++) {
+		Piece* king_ptr = board_ptr->squares[king_start_square[colour]];
+		for (int side = 0; side < 2; side++) {
+			Piece* rook_ptr = board_ptr->squares[castle_rook_from[colour][side]];
+			if (
+				!king_ptr || king_ptr->type != KING || king_ptr->colour != colour ||
+				!rook_ptr || rook_ptr->type != ROOK || rook_ptr->colour != colour
+			) {
+				board_ptr->castling_rights[colour][side] = false;
+			}
+		}
+	}
+
 	// Read and setup en passant target from fen string
 	c = fen_string[++i];
 	board_ptr->en_passant_target = NONE;
@@ -133,19 +247,24 @@ void setup_board(Board* board_ptr, char* fen_string) {
 		board_ptr->en_passant_target = coordinate_to_index(file, rank);
 	}
 
-	// Read and setup half moves and full moves from fen string
-	i += 2;
-	int digits;
-	for (digits = 0; (c = fen_string[i+digits]) != ' '; digits++) {}
-	char half_moves[digits];
-	for (int j = 0; j < digits; j++) { half_moves[j] = fen_string[i + j]; }
-	board_ptr->half_moves = atoi(half_moves);
-
-	i += digits + 1;
-	for (digits = 0; (c = fen_string[i+digits]); digits++) {}
-	char full_moves[digits];
-	for (int j = 0; j < digits; j++) { full_moves[j] = fen_string[i + j]; }
-	board_ptr->full_moves = atoi(full_moves);
+	// Read and setup half moves and full moves from fen string. EPD lines
+	// leave them out, so fall back to the values of a fresh game
+	board_ptr->half_moves = 0;
+	board_ptr->full_moves = 1;
+	if (fen_string[++i] == ' ' && fen_string[i + 1] >= '0' && fen_string[i + 1] <= '9') {
+		i++;
+		board_ptr->half_moves = atoi(&fen_string[i]);
+		while (fen_string[i] && fen_string[i] != ' ') { i++; }
+		if (fen_string[i] == ' ' && fen_string[i + 1] >= '0' && fen_string[i + 1] <= '9') {
+			board_ptr->full_moves = atoi(&fen_string[i]);
+		}
+	}
+
+	// Start the position history from this position
+	board_ptr->material_key = compute_material_key(board_ptr);
+	board_ptr->hash = compute_hash(board_ptr);
+	board_ptr->history[0] = board_ptr->hash;
+	board_ptr->history_count = 1;
 }
 
 
@@ -159,4 +278,17 @@ Colour get_opponent_colour(Colour player_colour) {
 
 void switch_current_turn(Board* board_ptr) {
 	board_ptr->current_turn = get_opponent_colour(board_ptr->current_turn);
+	board_ptr->hash ^= zobrist_side_key;
+}
+
+
+/* squares points into player_pieces, so the pointers are moved to the copy */
+void copy_board(Board* destination_ptr, Board* source_ptr) {
+	memcpy(destination_ptr, source_ptr, sizeof(Board));
+	for (int square = 0; square < 64; square++) {
+		Piece* piece_ptr = source_ptr->squares[square];
+		if (piece_ptr) {
+			destination_ptr->squares[square] = &destination_ptr->player_pieces[0][0] + (piece_ptr - &source_ptr->player_pieces[0][0]);
+		}
+	}
 }
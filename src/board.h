@@ -5,14 +5,26 @@
 #include "chess.h"
 
 
+/* Castling geometry, indexed by [colour][CastleSide] */
+extern const Square king_start_square[2];
+extern const Square castle_rook_from[2][2];
+extern const Square castle_rook_to[2][2];
+extern const Square castle_king_to[2][2];
+extern const Square castle_empty_squares[2][2][3];
+extern const Square castle_king_path[2][2][2];
+
+
 /* FUNCTION DEFINITIONS */
 bool inside_board(int file, int rank);
 int index_to_file(Square square);
 int index_to_rank(Square square);
 Square position_to_index(int x, int y);
 Square coordinate_to_index(int file, int rank);
+bool validate_fen(char* fen_string);
 void setup_board(Board* board_ptr, char* fen_string);
+Colour get_opponent_colour(Colour player_colour);
 void switch_current_turn(Board* board_ptr);
+void copy_board(Board* destination_ptr, Board* source_ptr);
 
 
 #endif  /* BOARD_H */
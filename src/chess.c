@@ -1,11 +1,22 @@
 #include <stdbool.h>  // for bool
 #include "chess.h"
 #include "board.h"
-#include "move_generation.h"
-#include "interface.h"
+#include "zobrist.h"
 
 
-void perform_promotion(MoveType move_type, Piece* piece_ptr) {
+ALWAYS_INLINE void add_material(Board* board_ptr, Colour colour, PieceType type) {
+	board_ptr->material_key ^= zobrist_piece_keys[colour][type][board_ptr->piece_counts[colour][type]];
+	board_ptr->piece_counts[colour][type]++;
+}
+
+
+ALWAYS_INLINE void remove_material(Board* board_ptr, Colour colour, PieceType type) {
+	board_ptr->piece_counts[colour][type]--;
+	board_ptr->material_key ^= zobrist_piece_keys[colour][type][board_ptr->piece_counts[colour][type]];
+}
+
+
+ALWAYS_INLINE void perform_promotion(MoveType move_type, Board* board_ptr, Piece* piece_ptr, const Colour us) {
 	if (move_type == PROMOTION_KNIGHT || move_type == CAPTURE_PROMOTION_KNIGHT) {
 		piece_ptr->type = KNIGHT;
 	}
@@ -18,31 +29,41 @@ void perform_promotion(MoveType move_type, Piece* piece_ptr) {
 	else if (move_type == PROMOTION_QUEEN || move_type == CAPTURE_PROMOTION_QUEEN) {
 		piece_ptr->type = QUEEN;
 	}
+	else {
+		return;
+	}
+	remove_material(board_ptr, us, PAWN);
+	add_material(board_ptr, us, piece_ptr->type);
 }
 
 
-void unperform_promotion(MoveType move_type, Piece* piece_ptr) {
+ALWAYS_INLINE void unperform_promotion(MoveType move_type, Board* board_ptr, Piece* piece_ptr, const Colour us) {
 	if (
 		move_type == PROMOTION_KNIGHT || move_type == CAPTURE_PROMOTION_KNIGHT || 
 		move_type == PROMOTION_BISHOP || move_type == CAPTURE_PROMOTION_BISHOP ||
 		move_type == PROMOTION_ROOK || move_type == CAPTURE_PROMOTION_ROOK ||
 		move_type == PROMOTION_QUEEN || move_type == CAPTURE_PROMOTION_QUEEN
 	) {
+		remove_material(board_ptr, us, piece_ptr->type);
+		add_material(board_ptr, us, PAWN);
 		piece_ptr->type = PAWN;
 	}
 }
 
 
-Piece* perform_en_passant(Move* move_ptr, Board* board_ptr) {
+ALWAYS_INLINE Square en_passant_capture_square(Square to, const Colour us) {
+	// The double pushed pawn sits one rank behind the en passant target
+	return to + (us == WHITE ? -8 : 8);
+}
+
+
+ALWAYS_INLINE Piece* perform_en_passant(Move* move_ptr, Board* board_ptr, const Colour us) {
 	if (move_ptr->type != EN_PASSANT) {
 		return 0;
 	}
-	
-	// Find square where double pushed pawn is
-	Square ep_square = move_ptr->to;
-	ep_square += board_ptr->current_turn == WHITE ? -8 : 8;
 
 	// Remove double pushed pawn from board
+	Square ep_square = en_passant_capture_square(move_ptr->to, us);
 	Piece* captured_ep_piece_ptr = board_ptr->squares[ep_square];
 	board_ptr->squares[ep_square] = 0;
 
@@ -50,89 +71,82 @@ Piece* perform_en_passant(Move* move_ptr, Board* board_ptr) {
 }
 
 
-void unperform_en_passant(Move* move_ptr, Board* board_ptr, Piece* captured_ep_piece_ptr) {
+ALWAYS_INLINE void unperform_en_passant(Move* move_ptr, Board* board_ptr, Piece* captured_ep_piece_ptr, const Colour us) {
 	if (move_ptr->type != EN_PASSANT) {
 		return;
 	}
-	
-	// Find square where double pushed pawn is
-	Square ep_square = move_ptr->to;
-	ep_square += board_ptr->current_turn == WHITE ? -8 : 8;
 
 	// Place double pushed pawn back on board
+	Square ep_square = en_passant_capture_square(move_ptr->to, us);
 	board_ptr->squares[ep_square] = captured_ep_piece_ptr;
 }
 
 
-void perform_castle(MoveType move_type, Board* board_ptr) {
+ALWAYS_INLINE void move_rook(Board* board_ptr, Square from, Square to) {
+	board_ptr->squares[to] = board_ptr->squares[from];
+	board_ptr->squares[from] = 0;
+	board_ptr->squares[to]->square = to;
+}
+
+
+ALWAYS_INLINE void hash_castle(Board* board_ptr, Square from, Square to, const Colour us) {
+	board_ptr->hash ^= zobrist_piece_keys[us][ROOK][from] ^ zobrist_piece_keys[us][ROOK][to];
+}
+
+
+ALWAYS_INLINE void perform_castle(MoveType move_type, Board* board_ptr, const Colour us) {
 	// Only need to teleport rook to other side of king
-	if (move_type == CASTLE_KINGSIDE && board_ptr->current_turn == WHITE) {
-		board_ptr->squares[F1] = board_ptr->squares[H1];
-		board_ptr->squares[H1] = 0;
-		board_ptr->squares[F1]->square = F1;
-	}
-	else if (move_type == CASTLE_QUEENSIDE && board_ptr->current_turn == WHITE) {
-		board_ptr->squares[D1] = board_ptr->squares[A1];
-		board_ptr->squares[A1] = 0;
-		board_ptr->squares[D1]->square = D1;
-	}
-	else if (move_type == CASTLE_KINGSIDE && board_ptr->current_turn == BLACK) {
-		board_ptr->squares[F8] = board_ptr->squares[H8];
-		board_ptr->squares[H8] = 0;
-		board_ptr->squares[F8]->square = F8;
-	}
-	else if (move_type == CASTLE_QUEENSIDE && board_ptr->current_turn == BLACK) {
-		board_ptr->squares[D8] = board_ptr->squares[A8];
-		board_ptr->squares[A8] = 0;
-		board_ptr->squares[D8]->square = D8;
+	if (move_type == CASTLE_KINGSIDE) {
+		move_rook(board_ptr, castle_rook_from[us][KINGSIDE], castle_rook_to[us][KINGSIDE]);
+		hash_castle(board_ptr, castle_rook_from[us][KINGSIDE], castle_rook_to[us][KINGSIDE], us);
+	}
+	else if (move_type == CASTLE_QUEENSIDE) {
+		move_rook(board_ptr, castle_rook_from[us][QUEENSIDE], castle_rook_to[us][QUEENSIDE]);
+		hash_castle(board_ptr, castle_rook_from[us][QUEENSIDE], castle_rook_to[us][QUEENSIDE], us);
 	}
 }
 
 
-void unperform_castle(MoveType move_type, Board* board_ptr) {
+ALWAYS_INLINE void unperform_castle(MoveType move_type, Board* board_ptr, const Colour us) {
 	// Only need to un-teleport rook back to starting square
-	if (move_type == CASTLE_KINGSIDE && board_ptr->current_turn == WHITE) {
-		board_ptr->squares[H1] = board_ptr->squares[F1];
-		board_ptr->squares[F1] = 0;
-		board_ptr->squares[H1]->square = H1;
-	}
-	else if (move_type == CASTLE_QUEENSIDE && board_ptr->current_turn == WHITE) {
-		board_ptr->squares[A1] = board_ptr->squares[D1];
-		board_ptr->squares[D1] = 0;
-		board_ptr->squares[A1]->square = A1;
-	}
-	else if (move_type == CASTLE_KINGSIDE && board_ptr->current_turn == BLACK) {
-		board_ptr->squares[H8] = board_ptr->squares[F8];
-		board_ptr->squares[F8] = 0;
-		board_ptr->squares[H8]->square = H8;
-	}
-	else if (move_type == CASTLE_QUEENSIDE && board_ptr->current_turn == BLACK) {
-		board_ptr->squares[A8] = board_ptr->squares[D8];
-		board_ptr->squares[D8] = 0;
-		board_ptr->squares[A8]->square = A8;
+	if (move_type == CASTLE_KINGSIDE) {
+		move_rook(board_ptr, castle_rook_to[us][KINGSIDE], castle_rook_from[us][KINGSIDE]);
+	}
+	else if (move_type == CASTLE_QUEENSIDE) {
+		move_rook(board_ptr, castle_rook_to[us][QUEENSIDE], castle_rook_from[us][QUEENSIDE]);
 	}
 }
 
 
-Piece* make_move(Move* move_ptr, Board* board_ptr) {
+ALWAYS_INLINE Piece* make_move_template(Move* move_ptr, Board* board_ptr, const Colour us) {
+	const Colour them = us == WHITE ? BLACK : WHITE;
 	Piece* piece_ptr = board_ptr->squares[move_ptr->from];
 	Piece* target_ptr = board_ptr->squares[move_ptr->to];
-	
+
+	// Pawn moves reset the fifty move counter
+	board_ptr->half_moves = piece_ptr->type == PAWN ? 0 : board_ptr->half_moves + 1;
+	board_ptr->hash ^= zobrist_piece_keys[us][piece_ptr->type][move_ptr->from];
+
 	board_ptr->squares[piece_ptr->square] = 0;
 	piece_ptr->square = move_ptr->to;
 	board_ptr->squares[piece_ptr->square] = piece_ptr;
 
 	// Perform special moves
-	perform_promotion(move_ptr->type, piece_ptr);
-	Piece* ep_target = perform_en_passant(move_ptr, board_ptr);
+	perform_promotion(move_ptr->type, board_ptr, piece_ptr, us);
+	Piece* ep_target = perform_en_passant(move_ptr, board_ptr, us);
 	if (ep_target) {
 		target_ptr = ep_target;
 	}
-	perform_castle(move_ptr->type, board_ptr);
+	perform_castle(move_ptr->type, board_ptr, us);
+
+	board_ptr->hash ^= zobrist_piece_keys[us][piece_ptr->type][move_ptr->to];
 
-	// Set captured piece to dead
+	// Set captured piece to dead, en passant included
 	if (target_ptr) {
 		target_ptr->alive = false;
+		remove_material(board_ptr, them, target_ptr->type);
+		board_ptr->half_moves = 0;
+		board_ptr->hash ^= zobrist_piece_keys[them][target_ptr->type][target_ptr->square];
 		return target_ptr;
 	}
 
@@ -140,7 +154,7 @@ Piece* make_move(Move* move_ptr, Board* board_ptr) {
 }
 
 
-void undo_move(Move* move_ptr, Board* board_ptr, Piece* captured_piece_ptr) {
+ALWAYS_INLINE void undo_move_template(Move* move_ptr, Board* board_ptr, Piece* captured_piece_ptr, const Colour us) {
 	Piece* piece_ptr = board_ptr->squares[move_ptr->to];
 
 	if (move_ptr->type == EN_PASSANT) {
@@ -155,123 +169,266 @@ void undo_move(Move* move_ptr, Board* board_ptr, Piece* captured_piece_ptr) {
 	board_ptr->squares[piece_ptr->square] = piece_ptr;
 
 	// Unperform special moves
-	unperform_promotion(move_ptr->type, piece_ptr);
-	unperform_en_passant(move_ptr, board_ptr, captured_piece_ptr);
-	unperform_castle(move_ptr->type, board_ptr);
+	unperform_promotion(move_ptr->type, board_ptr, piece_ptr, us);
+	unperform_en_passant(move_ptr, board_ptr, captured_piece_ptr, us);
+	unperform_castle(move_ptr->type, board_ptr, us);
 
 	// Set captured piece to alive
 	if (captured_piece_ptr) {
 		captured_piece_ptr->alive = true;
+		add_material(board_ptr, captured_piece_ptr->colour, captured_piece_ptr->type);
 	}
 }
 
 
-void update_en_passant_target(Move* move_ptr, Board* board_ptr) {
+ALWAYS_INLINE void update_en_passant_target_template(Move* move_ptr, Board* board_ptr, const Colour us) {
+	if (board_ptr->en_passant_target != NONE) {
+		board_ptr->hash ^= zobrist_en_passant_keys[board_ptr->en_passant_target % 8];
+	}
+
 	board_ptr->en_passant_target = NONE;
 	if (move_ptr->type == DOUBLE_PAWN_PUSH) {
 		// Find square as if pawn had only moved once
-		Square ep_square = move_ptr->to;
-		ep_square += board_ptr->current_turn == WHITE ? -8 : 8;
-		board_ptr->en_passant_target = ep_square;
+		board_ptr->en_passant_target = en_passant_capture_square(move_ptr->to, us);
+		board_ptr->hash ^= zobrist_en_passant_keys[board_ptr->en_passant_target % 8];
 	}
 }
 
 
-void update_castling_rights(Move* move_ptr, Board* board_ptr) {
+ALWAYS_INLINE void remove_castling_right(Board* board_ptr, Colour colour, CastleSide side) {
+	board_ptr->castling_rights[colour][side] = false;
+	board_ptr->hash ^= zobrist_castling_keys[colour][side];
+}
+
+
+ALWAYS_INLINE void update_castling_rights_template(Move* move_ptr, Board* board_ptr, const Colour us) {
+	const Colour them = us == WHITE ? BLACK : WHITE;
+
 	// If move was castling set rights to false
 	if (move_ptr->type == CASTLE_KINGSIDE || move_ptr->type == CASTLE_QUEENSIDE) {
-		board_ptr->castling_rights[board_ptr->current_turn][KINGSIDE] = false;
-		board_ptr->castling_rights[board_ptr->current_turn][QUEENSIDE] = false;
+		if (board_ptr->castling_rights[us][KINGSIDE]) {
+			remove_castling_right(board_ptr, us, KINGSIDE);
+		}
+		if (board_ptr->castling_rights[us][QUEENSIDE]) {
+			remove_castling_right(board_ptr, us, QUEENSIDE);
+		}
 		return;
 	}
 
-	if (board_ptr->current_turn == WHITE) {
-		// If player moved rook or king and can still castle
-		if (board_ptr->castling_rights[WHITE][KINGSIDE]) {
-			if (move_ptr->from == E1 || move_ptr->from == H1) {
-				board_ptr->castling_rights[WHITE][KINGSIDE] = false;
-			}
+	// If player moved rook or king and can still castle
+	if (board_ptr->castling_rights[us][KINGSIDE]) {
+		if (move_ptr->from == king_start_square[us] || move_ptr->from == castle_rook_from[us][KINGSIDE]) {
+			remove_castling_right(board_ptr, us, KINGSIDE);
 		}
-		if (board_ptr->castling_rights[WHITE][QUEENSIDE]) {
-			if (move_ptr->from == E1 || move_ptr->from == A1) {
-				board_ptr->castling_rights[WHITE][QUEENSIDE] = false;
-			}
+	}
+	if (board_ptr->castling_rights[us][QUEENSIDE]) {
+		if (move_ptr->from == king_start_square[us] || move_ptr->from == castle_rook_from[us][QUEENSIDE]) {
+			remove_castling_right(board_ptr, us, QUEENSIDE);
 		}
+	}
 
-		// If player captured opponents rook and they can still castle
-		if (board_ptr->castling_rights[BLACK][KINGSIDE]) {
-			if (move_ptr->to == H8) {
-				board_ptr->castling_rights[BLACK][KINGSIDE] = false;
-			}
+	// If player captured opponents rook and they can still castle
+	if (board_ptr->castling_rights[them][KINGSIDE]) {
+		if (move_ptr->to == castle_rook_from[them][KINGSIDE]) {
+			remove_castling_right(board_ptr, them, KINGSIDE);
 		}
-		if (board_ptr->castling_rights[BLACK][QUEENSIDE]) {
-			if (move_ptr->to == A8) {
-				board_ptr->castling_rights[BLACK][QUEENSIDE] = false;
-			}
+	}
+	if (board_ptr->castling_rights[them][QUEENSIDE]) {
+		if (move_ptr->to == castle_rook_from[them][QUEENSIDE]) {
+			remove_castling_right(board_ptr, them, QUEENSIDE);
 		}
 	}
+}
+
+
+/* Public entry points dispatch on the side to move once, then run a copy of
+   the template with the colour folded to a constant */
+Piece* make_move(Move* move_ptr, Board* board_ptr) {
+	if (board_ptr->current_turn == WHITE) {
+		return make_move_template(move_ptr, board_ptr, WHITE);
+	}
+	return make_move_template(move_ptr, board_ptr, BLACK);
+}
+
+
+void undo_move(Move* move_ptr, Board* board_ptr, Piece* captured_piece_ptr) {
+	if (board_ptr->current_turn == WHITE) {
+		undo_move_template(move_ptr, board_ptr, captured_piece_ptr, WHITE);
+	}
 	else {
-		// If player moved rook or king and can still castle
-		if (board_ptr->castling_rights[BLACK][KINGSIDE]) {
-			if (move_ptr->from == E8 || move_ptr->from == H8) {
-				board_ptr->castling_rights[BLACK][KINGSIDE] = false;
-			}
-		}
-		if (board_ptr->castling_rights[BLACK][QUEENSIDE]) {
-			if (move_ptr->from == E8 || move_ptr->from == A8) {
-				board_ptr->castling_rights[BLACK][QUEENSIDE] = false;
-			}
-		}
+		undo_move_template(move_ptr, board_ptr, captured_piece_ptr, BLACK);
+	}
+}
 
-		// If player captured opponents rook and they can still castle
-		if (board_ptr->castling_rights[WHITE][KINGSIDE]) {
-			if (move_ptr->to == H1) {
-				board_ptr->castling_rights[WHITE][KINGSIDE] = false;
-			}
-		}
-		if (board_ptr->castling_rights[WHITE][QUEENSIDE]) {
-			if (move_ptr->to == A1) {
-				board_ptr->castling_rights[WHITE][QUEENSIDE] = false;
-			}
-		}
+
+void update_en_passant_target(Move* move_ptr, Board* board_ptr) {
+	if (board_ptr->current_turn == WHITE) {
+		update_en_passant_target_template(move_ptr, board_ptr, WHITE);
+	}
+	else {
+		update_en_passant_target_template(move_ptr, board_ptr, BLACK);
+	}
+}
+
+
+void update_castling_rights(Move* move_ptr, Board* board_ptr) {
+	if (board_ptr->current_turn == WHITE) {
+		update_castling_rights_template(move_ptr, board_ptr, WHITE);
+	}
+	else {
+		update_castling_rights_template(move_ptr, board_ptr, BLACK);
+	}
+}
+
+
+void play_move(Move* move_ptr, Board* board_ptr, MoveUndo* undo_ptr) {
+	// Save irreversible board data
+	undo_ptr->en_passant_target = board_ptr->en_passant_target;
+	undo_ptr->castling_rights[WHITE][KINGSIDE] = board_ptr->castling_rights[WHITE][KINGSIDE];
+	undo_ptr->castling_rights[WHITE][QUEENSIDE] = board_ptr->castling_rights[WHITE][QUEENSIDE];
+	undo_ptr->castling_rights[BLACK][KINGSIDE] = board_ptr->castling_rights[BLACK][KINGSIDE];
+	undo_ptr->castling_rights[BLACK][QUEENSIDE] = board_ptr->castling_rights[BLACK][QUEENSIDE];
+	undo_ptr->half_moves = board_ptr->half_moves;
+	undo_ptr->hash = board_ptr->hash;
+
+	undo_ptr->captured_piece_ptr = make_move(move_ptr, board_ptr);
+
+	// Update board state
+	update_en_passant_target(move_ptr, board_ptr);
+	update_castling_rights(move_ptr, board_ptr);
+	if (board_ptr->current_turn == BLACK) {
+		board_ptr->full_moves++;
+	}
+
+	// Change turn
+	switch_current_turn(board_ptr);
+
+	// Record new position for repetition detection
+	if (board_ptr->history_count < MAX_GAME_PLY) {
+		board_ptr->history[board_ptr->history_count] = board_ptr->hash;
+	}
+	board_ptr->history_count++;
+}
+
+
+void unplay_move(Move* move_ptr, Board* board_ptr, MoveUndo* undo_ptr) {
+	board_ptr->history_count--;
+
+	switch_current_turn(board_ptr);
+	if (board_ptr->current_turn == BLACK) {
+		board_ptr->full_moves--;
 	}
+
+	undo_move(move_ptr, board_ptr, undo_ptr->captured_piece_ptr);
+
+	// Overwrite irreversible board data with saved data
+	board_ptr->en_passant_target = undo_ptr->en_passant_target;
+	board_ptr->castling_rights[WHITE][KINGSIDE] = undo_ptr->castling_rights[WHITE][KINGSIDE];
+	board_ptr->castling_rights[WHITE][QUEENSIDE] = undo_ptr->castling_rights[WHITE][QUEENSIDE];
+	board_ptr->castling_rights[BLACK][KINGSIDE] = undo_ptr->castling_rights[BLACK][KINGSIDE];
+	board_ptr->castling_rights[BLACK][QUEENSIDE] = undo_ptr->castling_rights[BLACK][QUEENSIDE];
+	board_ptr->half_moves = undo_ptr->half_moves;
+	board_ptr->hash = undo_ptr->hash;
 }
 
 
-void play_game() {
-	char* fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
-	Board board = {};
-	MoveList move_list = {};  
-	setup_board(&board, fen);
+/* Passes the turn without moving, for null move pruning. The half move clock
+   is reset so repetition detection does not look back across the null move */
+void play_null_move(Board* board_ptr, MoveUndo* undo_ptr) {
+	undo_ptr->captured_piece_ptr = 0;
+	undo_ptr->en_passant_target = board_ptr->en_passant_target;
+	undo_ptr->half_moves = board_ptr->half_moves;
+	undo_ptr->hash = board_ptr->hash;
+
+	if (board_ptr->en_passant_target != NONE) {
+		board_ptr->hash ^= zobrist_en_passant_keys[board_ptr->en_passant_target % 8];
+		board_ptr->en_passant_target = NONE;
+	}
+	board_ptr->half_moves = 0;
+	switch_current_turn(board_ptr);
+
+	if (board_ptr->history_count < MAX_GAME_PLY) {
+		board_ptr->history[board_ptr->history_count] = board_ptr->hash;
+	}
+	board_ptr->history_count++;
+}
+
+
+void unplay_null_move(Board* board_ptr, MoveUndo* undo_ptr) {
+	board_ptr->history_count--;
+	switch_current_turn(board_ptr);
+	board_ptr->en_passant_target = undo_ptr->en_passant_target;
+	board_ptr->half_moves = undo_ptr->half_moves;
+	board_ptr->hash = undo_ptr->hash;
+}
+
+
+/* Returns how many earlier positions in the history match the current one.
+   Only positions since the last capture or pawn move (bounded by the half
+   move clock) with the same side to move can match, so the scan starts four
+   plies back and steps by two. */
+int count_repetitions(Board* board_ptr) {
+	int current = board_ptr->history_count - 1;
+	if (current >= MAX_GAME_PLY) {
+		return 0;
+	}
+
+	int oldest = current - board_ptr->half_moves;
+	if (oldest < 0) {
+		oldest = 0;
+	}
+
+	int repetitions = 0;
+	for (int i = current - 4; i >= oldest; i -= 2) {
+		if (board_ptr->history[i] == board_ptr->hash) {
+			repetitions++;
+		}
+	}
+	return repetitions;
+}
 
-	while (1) {
-		// Generate all moves in a position for current player
-		move_list.move_count = 0;  // Instead of clearing moves
-		generate_pseudo_moves(&move_list, &board);
-		find_legal_moves(&move_list, &board);
 
-		// Display board and moves
-		print_board(&board);
-		print_board_details(&board);
-		print_move_list(&move_list);
+/* Cheaper test for search, where a single repetition is scored as a draw */
+bool is_repetition(Board* board_ptr) {
+	int current = board_ptr->history_count - 1;
+	if (current >= MAX_GAME_PLY) {
+		return false;
+	}
 
-		// Check for gameover
-		if (move_list.move_count == 0) {
-			break;
+	int oldest = current - board_ptr->half_moves;
+	if (oldest < 0) {
+		oldest = 0;
+	}
+
+	for (int i = current - 4; i >= oldest; i -= 2) {
+		if (board_ptr->history[i] == board_ptr->hash) {
+			return true;
 		}
+	}
+	return false;
+}
 
-		// Get move
-		int i = get_move_index(&move_list);
-		Move* selected_move_ptr = &move_list.moves[i];
 
-		// Make move
-		make_move(selected_move_ptr, &board);
+/* Checkmate takes priority, so callers should check for legal moves first */
+bool is_fifty_move_draw(Board* board_ptr) {
+	return board_ptr->half_moves >= 100;
+}
 
-		// Update board state
-		update_en_passant_target(selected_move_ptr, &board);
-		update_castling_rights(selected_move_ptr, &board);
 
-		// Change turn
-		switch_current_turn(&board);
+/* Bare kings, or a single minor piece against a bare king */
+bool is_insufficient_material(Board* board_ptr) {
+	int minor_pieces = 0;
+	for (Colour colour = WHITE; colour <= BLACK; colour++) {
+		for (int i = 1; i < 16; i++) {
+			Piece* piece_ptr = &board_ptr->player_pieces[colour][i];
+			if (!piece_ptr->alive) {
+				continue;
+			}
+			if (piece_ptr->type != KNIGHT && piece_ptr->type != BISHOP) {
+				return false;
+			}
+			minor_pieces++;
+		}
 	}
+	return minor_pieces <= 1;
 }
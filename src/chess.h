@@ -3,6 +3,13 @@
 
 
 #include <stdbool.h>  // for bool
+#include <stdint.h>  // for uint16_t and uint64_t
+
+
+/* Forces the compiler to instantiate a copy of the function at every call
+   site, so arguments that are compile-time constants (colour, generation
+   type) get folded away. Used to build per-colour specialisations. */
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
 
 
 typedef enum {
@@ -59,6 +66,15 @@ typedef enum {
 } MoveType;
 
 
+/* Which subset of pseudo-legal moves to generate */
+typedef enum {
+	GEN_ALL,
+	GEN_CAPTURES,  // Captures, en passant and promotions
+	GEN_QUIETS,  // Every move GEN_CAPTURES leaves out
+	GEN_EVASIONS,  // Superset of the legal replies to a check
+} GenType;
+
+
 typedef struct {
 	Square from;
 	Square to;
@@ -66,8 +82,32 @@ typedef struct {
 } Move;
 
 
+/* Moves stored in 16 bits as from | to << 6 | type << 12. A1 to A1 is never
+   a real move, so zero doubles as "no move" */
+ALWAYS_INLINE uint16_t pack_move(Move* move_ptr) {
+	if (move_ptr->from == NONE) {
+		return 0;
+	}
+	return move_ptr->from | move_ptr->to << 6 | move_ptr->type << 12;
+}
+
+
+ALWAYS_INLINE Move unpack_move(uint16_t packed) {
+	if (packed == 0) {
+		return (Move){NONE, NONE, QUIET_MOVE};
+	}
+	return (Move){packed & 63, (packed >> 6) & 63, packed >> 12};
+}
+
+
+#define MAX_MOVES 218  // 218 is the maximum number of moves valid position
+#define MAX_PLY 128  // Deepest line perft or search will walk
+#define MAX_GAME_PLY 2048  // Longest game the position history can hold
+
+
+/* View onto a slice of the per-thread move stack, see push_move_list */
 typedef struct {
-	Move moves[218];  // 218 is the maximum number of moves valid position
+	Move* moves;
 	int move_count;
 } MoveList;
 
@@ -90,15 +130,38 @@ typedef struct {
 
 	Square en_passant_target;
 	bool castling_rights[2][2];
+
+	uint64_t hash;  // Zobrist key, updated incrementally by play_move
+	uint64_t material_key;  // Zobrist key of piece_counts, updated by make_move and undo_move
+	uint8_t piece_counts[2][6];  // Alive pieces, indexed by [Colour][PieceType]
+	uint64_t history[MAX_GAME_PLY];  // Keys of every position reached so far
+	int history_count;
 } Board;
 
 
+/* Irreversible board data saved by play_move so unplay_move can restore it */
+typedef struct {
+	Piece* captured_piece_ptr;
+	Square en_passant_target;
+	bool castling_rights[2][2];
+	int half_moves;
+	uint64_t hash;
+} MoveUndo;
+
+
 /* FUNCTION DEFINITIONS */
 Piece* make_move(Move* move_ptr, Board* board_ptr);
 void undo_move(Move* move_ptr, Board* board_ptr, Piece* captured_piece_ptr);
 void update_en_passant_target(Move* move_ptr, Board* board_ptr);
 void update_castling_rights(Move* move_ptr, Board* board_ptr);
-void play_game();
+void play_move(Move* move_ptr, Board* board_ptr, MoveUndo* undo_ptr);
+void unplay_move(Move* move_ptr, Board* board_ptr, MoveUndo* undo_ptr);
+void play_null_move(Board* board_ptr, MoveUndo* undo_ptr);
+void unplay_null_move(Board* board_ptr, MoveUndo* undo_ptr);
+int count_repetitions(Board* board_ptr);
+bool is_repetition(Board* board_ptr);
+bool is_fifty_move_draw(Board* board_ptr);
+bool is_insufficient_material(Board* board_ptr);
 
 
 #endif  /* CHESS_H */
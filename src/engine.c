@@ -0,0 +1,336 @@
+// gcc -O2 -fPIC -fvisibility=hidden -c engine.c attacks.c bitboard_batch.c board.c chess.c evaluate.c interface.c material.c move_generation.c perft.c search.c timeman.c trace.c tt.c zobrist.c
+// gcc -shared -o libchess.so *.o -lm -lpthread  or  ar rcs libchess.a *.o
+#include <pthread.h>  // for pthread_create and pthread_join
+#include <stdbool.h>  // for bool
+#include <stdlib.h>  // for malloc and free
+#include <string.h>  // for strcpy and strlen
+#include <unistd.h>  // for sysconf
+#include "chess.h"
+#include "board.h"
+#include "engine.h"
+#include "interface.h"
+#include "move_generation.h"
+#include "perft.h"
+#include "search.h"
+#include "tt.h"
+
+
+#define MAX_FEN_LENGTH 128
+#define BATCH_HASH_MB 16  // Per thread when the caller passes 0
+
+
+struct ChessPosition {
+	Board board;
+	Move moves[MAX_GAME_PLY];  // Moves made through the API, for unmake
+	MoveUndo undos[MAX_GAME_PLY];
+	int move_count;
+};
+
+
+struct ChessEngine {
+	SearchInfo info;
+	TranspositionTable tt;
+};
+
+
+ChessPosition* chess_position_create() {
+	ChessPosition* position_ptr = malloc(sizeof(ChessPosition));
+	if (position_ptr) {
+		chess_position_set_fen(position_ptr, CHESS_START_FEN);
+	}
+	return position_ptr;
+}
+
+
+void chess_position_destroy(ChessPosition* position_ptr) {
+	free(position_ptr);
+}
+
+
+/* The position is left unchanged if the FEN is rejected */
+ChessStatus chess_position_set_fen(ChessPosition* position_ptr, const char* fen) {
+	char fen_copy[MAX_FEN_LENGTH];
+	if (!fen || strlen(fen) >= MAX_FEN_LENGTH) {
+		return CHESS_INVALID_FEN;
+	}
+	strcpy(fen_copy, fen);
+	if (!validate_fen(fen_copy)) {
+		return CHESS_INVALID_FEN;
+	}
+	setup_board(&position_ptr->board, fen_copy);
+	position_ptr->move_count = 0;
+	return CHESS_OK;
+}
+
+
+/* Writes up to capacity legal moves and returns how many there are in
+   total, so a small buffer can be detected */
+int chess_generate_legal_moves(ChessPosition* position_ptr, ChessMove* moves, int capacity) {
+	MoveList* move_list_ptr = push_move_list();
+	generate_pseudo_moves(move_list_ptr, &position_ptr->board);
+	find_legal_moves(move_list_ptr, &position_ptr->board);
+	for (int i = 0; i < move_list_ptr->move_count && i < capacity; i++) {
+		moves[i] = pack_move(&move_list_ptr->moves[i]);
+	}
+	int move_count = move_list_ptr->move_count;
+	pop_move_list();
+	return move_count;
+}
+
+
+/* Moves are checked, so a stale or corrupt ChessMove is refused rather than
+   corrupting the position */
+ChessStatus chess_make_move(ChessPosition* position_ptr, ChessMove move) {
+	Board* board_ptr = &position_ptr->board;
+	if (position_ptr->move_count >= MAX_GAME_PLY - 1 || board_ptr->history_count >= MAX_GAME_PLY - 1) {
+		return CHESS_HISTORY_FULL;
+	}
+
+	Move candidate = unpack_move(move);
+	MoveList* move_list_ptr = push_move_list();
+	generate_pseudo_moves(move_list_ptr, board_ptr);
+	bool found = false;
+	for (int i = 0; i < move_list_ptr->move_count && !found; i++) {
+		Move* move_ptr = &move_list_ptr->moves[i];
+		found = move_ptr->from == candidate.from && move_ptr->to == candidate.to && move_ptr->type == candidate.type;
+	}
+	pop_move_list();
+	if (!found || !is_legal_move(&candidate, board_ptr)) {
+		return CHESS_ILLEGAL_MOVE;
+	}
+
+	int index = position_ptr->move_count++;
+	position_ptr->moves[index] = candidate;
+	play_move(&position_ptr->moves[index], board_ptr, &position_ptr->undos[index]);
+	return CHESS_OK;
+}
+
+
+ChessStatus chess_unmake_move(ChessPosition* position_ptr) {
+	if (position_ptr->move_count == 0) {
+		return CHESS_NO_MOVE_TO_UNMAKE;
+	}
+	int index = --position_ptr->move_count;
+	unplay_move(&position_ptr->moves[index], &position_ptr->board, &position_ptr->undos[index]);
+	return CHESS_OK;
+}
+
+
+ChessStatus chess_move_from_uci(ChessPosition* position_ptr, const char* uci, ChessMove* move_ptr) {
+	char uci_copy[6];
+	if (!uci || strlen(uci) > 5) {
+		return CHESS_ILLEGAL_MOVE;
+	}
+	strcpy(uci_copy, uci);
+	Move move;
+	if (!string_to_move(&position_ptr->board, uci_copy, &move)) {
+		return CHESS_ILLEGAL_MOVE;
+	}
+	*move_ptr = pack_move(&move);
+	return CHESS_OK;
+}
+
+
+/* buffer must hold at least 6 characters */
+void chess_move_to_uci(ChessMove move, char* buffer) {
+	Move unpacked = unpack_move(move);
+	move_to_string(&unpacked, buffer);
+}
+
+
+long long chess_perft(ChessPosition* position_ptr, int depth) {
+	if (depth <= 0) {
+		return 1;
+	}
+	return perft(&position_ptr->board, depth);
+}
+
+
+/* Returns 0 if the memory for the search tables cannot be allocated */
+ChessEngine* chess_engine_create(size_t hash_megabytes) {
+	ChessEngine* engine_ptr = malloc(sizeof(ChessEngine));
+	if (!engine_ptr) {
+		return 0;
+	}
+	if (!tt_init(&engine_ptr->tt, hash_megabytes ? hash_megabytes : 1, sysconf(_SC_NPROCESSORS_ONLN), false)) {
+		free(engine_ptr);
+		return 0;
+	}
+	engine_ptr->info.options = default_search_options;
+	engine_ptr->info.verbose = false;
+	engine_ptr->info.tt_ptr = &engine_ptr->tt;
+	engine_ptr->info.trace_ptr = 0;
+	engine_ptr->info.control_ptr = 0;
+	clear_search_tables(&engine_ptr->info);
+	return engine_ptr;
+}
+
+
+void chess_engine_destroy(ChessEngine* engine_ptr) {
+	if (engine_ptr) {
+		tt_free(&engine_ptr->tt);
+		free(engine_ptr);
+	}
+}
+
+
+void chess_engine_new_game(ChessEngine* engine_ptr) {
+	clear_search_tables(&engine_ptr->info);
+	tt_clear(&engine_ptr->tt, sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+
+void chess_search(ChessEngine* engine_ptr, ChessPosition* position_ptr, const ChessSearchLimits* limits_ptr, ChessSearchResult* result_ptr) {
+	SearchInfo* info_ptr = &engine_ptr->info;
+	info_ptr->limits = (SearchLimits){
+		.depth = limits_ptr->depth,
+		.nodes = limits_ptr->nodes,
+		.move_time = limits_ptr->move_time_ms,
+	};
+	search(&position_ptr->board, info_ptr);
+
+	*result_ptr = (ChessSearchResult){.status = CHESS_OK};
+	if (info_ptr->best_move.from == NONE) {
+		// Mate or stalemate, there is nothing to play
+		strcpy(result_ptr->best_move_uci, "0000");
+	}
+	else {
+		result_ptr->best_move = pack_move(&info_ptr->best_move);
+		move_to_string(&info_ptr->best_move, result_ptr->best_move_uci);
+	}
+
+	int score = info_ptr->best_score;
+	result_ptr->score = score;
+	if (score >= MATE_BOUND) {
+		result_ptr->mate = (MATE_SCORE - score + 1) / 2;
+	}
+	else if (score <= -MATE_BOUND) {
+		result_ptr->mate = -(MATE_SCORE + score) / 2;
+	}
+	result_ptr->depth = info_ptr->completed_depth;
+	result_ptr->nodes = info_ptr->nodes;
+}
+
+
+/*
+ * Batch calls share one driver. Worker threads claim the next position with
+ * an atomic add, and each owns its ChessPosition and, when searching, its
+ * ChessEngine for the whole call. Results are written by index, so they are
+ * in input order with no further synchronisation.
+ */
+
+
+typedef struct BatchCall BatchCall;
+
+struct BatchCall {
+	const char* const* fens;
+	int count;
+	int next;
+	bool needs_engine;
+	void (*run_one)(BatchCall* call_ptr, int index, ChessPosition* position_ptr, ChessEngine* engine_ptr);
+
+	// Arguments and outputs of the particular call
+	int depth;
+	const ChessSearchLimits* limits_ptr;
+	size_t hash_megabytes;
+	long long* node_counts;
+	ChessMove* moves;
+	int* move_counts;
+	ChessSearchResult* results;
+};
+
+
+void* batch_call_worker(void* arg) {
+	BatchCall* call_ptr = arg;
+	ChessPosition* position_ptr = malloc(sizeof(ChessPosition));
+	ChessEngine* engine_ptr = call_ptr->needs_engine ? chess_engine_create(call_ptr->hash_megabytes) : 0;
+
+	int index;
+	while ((index = __atomic_fetch_add(&call_ptr->next, 1, __ATOMIC_RELAXED)) < call_ptr->count) {
+		call_ptr->run_one(call_ptr, index, position_ptr, engine_ptr);
+	}
+
+	chess_engine_destroy(engine_ptr);
+	free(position_ptr);
+	return 0;
+}
+
+
+void run_batch_call(BatchCall* call_ptr, int threads) {
+	if (threads > call_ptr->count) {
+		threads = call_ptr->count;
+	}
+	if (threads <= 1) {
+		batch_call_worker(call_ptr);
+		return;
+	}
+	pthread_t workers[threads];
+	for (int i = 0; i < threads; i++) {
+		pthread_create(&workers[i], 0, batch_call_worker, call_ptr);
+	}
+	for (int i = 0; i < threads; i++) {
+		pthread_join(workers[i], 0);
+	}
+}
+
+
+void perft_one(BatchCall* call_ptr, int index, ChessPosition* position_ptr, ChessEngine* engine_ptr) {
+	if (!position_ptr || chess_position_set_fen(position_ptr, call_ptr->fens[index]) != CHESS_OK) {
+		call_ptr->node_counts[index] = -1;
+		return;
+	}
+	call_ptr->node_counts[index] = chess_perft(position_ptr, call_ptr->depth);
+}
+
+
+void legal_moves_one(BatchCall* call_ptr, int index, ChessPosition* position_ptr, ChessEngine* engine_ptr) {
+	if (!position_ptr || chess_position_set_fen(position_ptr, call_ptr->fens[index]) != CHESS_OK) {
+		call_ptr->move_counts[index] = -1;
+		return;
+	}
+	ChessMove* moves = call_ptr->moves + (long long)index * CHESS_MAX_MOVES;
+	call_ptr->move_counts[index] = chess_generate_legal_moves(position_ptr, moves, CHESS_MAX_MOVES);
+}
+
+
+void search_one(BatchCall* call_ptr, int index, ChessPosition* position_ptr, ChessEngine* engine_ptr) {
+	ChessSearchResult* result_ptr = &call_ptr->results[index];
+	if (!engine_ptr || !position_ptr) {
+		*result_ptr = (ChessSearchResult){.status = CHESS_OUT_OF_MEMORY};
+		return;
+	}
+	if (chess_position_set_fen(position_ptr, call_ptr->fens[index]) != CHESS_OK) {
+		*result_ptr = (ChessSearchResult){.status = CHESS_INVALID_FEN};
+		return;
+	}
+	// Positions are unrelated, so only the table ages between them
+	clear_search_tables(&engine_ptr->info);
+	chess_search(engine_ptr, position_ptr, call_ptr->limits_ptr, result_ptr);
+}
+
+
+/* node_counts[i] is -1 for a FEN that was rejected */
+void chess_perft_batch(const char* const* fens, int count, int depth, long long* node_counts, int threads) {
+	BatchCall call = {.fens = fens, .count = count, .run_one = perft_one, .depth = depth, .node_counts = node_counts};
+	run_batch_call(&call, threads);
+}
+
+
+/* moves must hold count * CHESS_MAX_MOVES entries, the moves of position i
+   start at i * CHESS_MAX_MOVES. move_counts[i] is -1 for a rejected FEN */
+void chess_legal_moves_batch(const char* const* fens, int count, ChessMove* moves, int* move_counts, int threads) {
+	BatchCall call = {
+		.fens = fens, .count = count, .run_one = legal_moves_one, .moves = moves, .move_counts = move_counts
+	};
+	run_batch_call(&call, threads);
+}
+
+
+void chess_search_batch(const char* const* fens, int count, const ChessSearchLimits* limits_ptr, ChessSearchResult* results, size_t hash_megabytes, int threads) {
+	BatchCall call = {
+		.fens = fens, .count = count, .needs_engine = true, .run_one = search_one,
+		.limits_ptr = limits_ptr, .hash_megabytes = hash_megabytes ? hash_megabytes : BATCH_HASH_MB,
+		.results = results,
+	};
+	run_batch_call(&call, threads);
+}
@@ -0,0 +1,80 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+
+#include <stddef.h>  // for size_t
+#include <stdint.h>  // for uint16_t
+
+
+/*
+ * Embeddable C API. Positions and engines are independent objects, so any
+ * number of threads may use the library at once as long as no single object
+ * is used by two threads at the same time. This header is self contained and
+ * is the only one an embedder needs.
+ */
+
+
+#define CHESS_API __attribute__((visibility("default")))
+
+#define CHESS_START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+#define CHESS_MAX_MOVES 218  // Size of a buffer that can hold every legal move
+
+
+typedef enum {
+	CHESS_OK = 0,
+	CHESS_INVALID_FEN = -1,
+	CHESS_ILLEGAL_MOVE = -2,
+	CHESS_NO_MOVE_TO_UNMAKE = -3,
+	CHESS_HISTORY_FULL = -4,
+	CHESS_OUT_OF_MEMORY = -5,
+} ChessStatus;
+
+
+/* Opaque move, only meaningful for the position it was generated in */
+typedef uint16_t ChessMove;
+
+typedef struct ChessPosition ChessPosition;
+typedef struct ChessEngine ChessEngine;
+
+
+/* Zero fields mean no limit, at least one should be set */
+typedef struct {
+	int depth;
+	long long nodes;
+	int move_time_ms;
+} ChessSearchLimits;
+
+
+typedef struct {
+	ChessStatus status;
+	ChessMove best_move;  // 0 when the game is already over
+	char best_move_uci[6];  // "0000" when the game is already over
+	int score;  // Centipawns from the side to move's point of view
+	int mate;  // Moves to mate, negative when being mated, 0 for none
+	int depth;
+	long long nodes;
+} ChessSearchResult;
+
+
+/* FUNCTION DEFINITIONS */
+CHESS_API ChessPosition* chess_position_create();
+CHESS_API void chess_position_destroy(ChessPosition* position_ptr);
+CHESS_API ChessStatus chess_position_set_fen(ChessPosition* position_ptr, const char* fen);
+CHESS_API int chess_generate_legal_moves(ChessPosition* position_ptr, ChessMove* moves, int capacity);
+CHESS_API ChessStatus chess_make_move(ChessPosition* position_ptr, ChessMove move);
+CHESS_API ChessStatus chess_unmake_move(ChessPosition* position_ptr);
+CHESS_API ChessStatus chess_move_from_uci(ChessPosition* position_ptr, const char* uci, ChessMove* move_ptr);
+CHESS_API void chess_move_to_uci(ChessMove move, char* buffer);
+CHESS_API long long chess_perft(ChessPosition* position_ptr, int depth);
+
+CHESS_API ChessEngine* chess_engine_create(size_t hash_megabytes);
+CHESS_API void chess_engine_destroy(ChessEngine* engine_ptr);
+CHESS_API void chess_engine_new_game(ChessEngine* engine_ptr);
+CHESS_API void chess_search(ChessEngine* engine_ptr, ChessPosition* position_ptr, const ChessSearchLimits* limits_ptr, ChessSearchResult* result_ptr);
+
+CHESS_API void chess_perft_batch(const char* const* fens, int count, int depth, long long* node_counts, int threads);
+CHESS_API void chess_legal_moves_batch(const char* const* fens, int count, ChessMove* moves, int* move_counts, int threads);
+CHESS_API void chess_search_batch(const char* const* fens, int count, const ChessSearchLimits* limits_ptr, ChessSearchResult* results, size_t hash_megabytes, int threads);
+
+
+#endif  /* ENGINE_H */
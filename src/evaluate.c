@@ -0,0 +1,214 @@
+#include <stdbool.h>  // for bool
+#include "chess.h"
+#include "evaluate.h"
+#include "material.h"
+
+
+// Indexed by [GamePhase][PieceType]
+const int piece_value[2][6] = {
+	{100, 320, 330, 500, 900, 0},
+	{120, 300, 320, 540, 950, 0},
+};
+
+
+/* Indexed by [GamePhase][PieceType][square]. Tables are laid out as the
+   board is printed (rank 8 first) from WHITE's point of view, so WHITE
+   looks squares up with square ^ 56 and BLACK with square directly. */
+const int piece_square_table[2][6][64] = {
+	{
+		{  // PAWN
+			0, 0, 0, 0, 0, 0, 0, 0,
+			50, 50, 50, 50, 50, 50, 50, 50,
+			10, 10, 20, 30, 30, 20, 10, 10,
+			5, 5, 10, 25, 25, 10, 5, 5,
+			0, 0, 0, 20, 20, 0, 0, 0,
+			5, -5, -10, 0, 0, -10, -5, 5,
+			5, 10, 10, -20, -20, 10, 10, 5,
+			0, 0, 0, 0, 0, 0, 0, 0,
+		},
+		{  // KNIGHT
+			-50, -40, -30, -30, -30, -30, -40, -50,
+			-40, -20, 0, 0, 0, 0, -20, -40,
+			-30, 0, 10, 15, 15, 10, 0, -30,
+			-30, 5, 15, 20, 20, 15, 5, -30,
+			-30, 0, 15, 20, 20, 15, 0, -30,
+			-30, 5, 10, 15, 15, 10, 5, -30,
+			-40, -20, 0, 5, 5, 0, -20, -40,
+			-50, -40, -30, -30, -30, -30, -40, -50,
+		},
+		{  // BISHOP
+			-20, -10, -10, -10, -10, -10, -10, -20,
+			-10, 0, 0, 0, 0, 0, 0, -10,
+			-10, 0, 5, 10, 10, 5, 0, -10,
+			-10, 5, 5, 10, 10, 5, 5, -10,
+			-10, 0, 10, 10, 10, 10, 0, -10,
+			-10, 10, 10, 10, 10, 10, 10, -10,
+			-10, 5, 0, 0, 0, 0, 5, -10,
+			-20, -10, -10, -10, -10, -10, -10, -20,
+		},
+		{  // ROOK
+			0, 0, 0, 0, 0, 0, 0, 0,
+			5, 10, 10, 10, 10, 10, 10, 5,
+			-5, 0, 0, 0, 0, 0, 0, -5,
+			-5, 0, 0, 0, 0, 0, 0, -5,
+			-5, 0, 0, 0, 0, 0, 0, -5,
+			-5, 0, 0, 0, 0, 0, 0, -5,
+			-5, 0, 0, 0, 0, 0, 0, -5,
+			0, 0, 0, 5, 5, 0, 0, 0,
+		},
+		{  // QUEEN
+			-20, -10, -10, -5, -5, -10, -10, -20,
+			-10, 0, 0, 0, 0, 0, 0, -10,
+			-10, 0, 5, 5, 5, 5, 0, -10,
+			-5, 0, 5, 5, 5, 5, 0, -5,
+			0, 0, 5, 5, 5, 5, 0, -5,
+			-10, 5, 5, 5, 5, 5, 0, -10,
+			-10, 0, 5, 0, 0, 0, 0, -10,
+			-20, -10, -10, -5, -5, -10, -10, -20,
+		},
+		{  // KING
+			-30, -40, -40, -50, -50, -40, -40, -30,
+			-30, -40, -40, -50, -50, -40, -40, -30,
+			-30, -40, -40, -50, -50, -40, -40, -30,
+			-30, -40, -40, -50, -50, -40, -40, -30,
+			-20, -30, -30, -40, -40, -30, -30, -20,
+			-10, -20, -20, -20, -20, -20, -20, -10,
+			20, 20, 0, 0, 0, 0, 20, 20,
+			20, 30, 10, 0, 0, 10, 30, 20,
+		},
+	},
+	{
+		{  // PAWN
+			0, 0, 0, 0, 0, 0, 0, 0,
+			80, 80, 80, 80, 80, 80, 80, 80,
+			50, 50, 50, 50, 50, 50, 50, 50,
+			30, 30, 30, 30, 30, 30, 30, 30,
+			15, 15, 15, 15, 15, 15, 15, 15,
+			5, 5, 5, 5, 5, 5, 5, 5,
+			0, 0, 0, 0, 0, 0, 0, 0,
+			0, 0, 0, 0, 0, 0, 0, 0,
+		},
+		{  // KNIGHT
+			-50, -40, -30, -30, -30, -30, -40, -50,
+			-40, -20, 0, 0, 0, 0, -20, -40,
+			-30, 0, 10, 15, 15, 10, 0, -30,
+			-30, 5, 15, 20, 20, 15, 5, -30,
+			-30, 0, 15, 20, 20, 15, 0, -30,
+			-30, 5, 10, 15, 15, 10, 5, -30,
+			-40, -20, 0, 5, 5, 0, -20, -40,
+			-50, -40, -30, -30, -30, -30, -40, -50,
+		},
+		{  // BISHOP
+			-20, -10, -10, -10, -10, -10, -10, -20,
+			-10, 0, 0, 0, 0, 0, 0, -10,
+			-10, 0, 5, 10, 10, 5, 0, -10,
+			-10, 5, 5, 10, 10, 5, 5, -10,
+			-10, 0, 10, 10, 10, 10, 0, -10,
+			-10, 10, 10, 10, 10, 10, 10, -10,
+			-10, 5, 0, 0, 0, 0, 5, -10,
+			-20, -10, -10, -10, -10, -10, -10, -20,
+		},
+		{  // ROOK
+			0, 0, 0, 0, 0, 0, 0, 0,
+			5, 10, 10, 10, 10, 10, 10, 5,
+			-5, 0, 0, 0, 0, 0, 0, -5,
+			-5, 0, 0, 0, 0, 0, 0, -5,
+			-5, 0, 0, 0, 0, 0, 0, -5,
+			-5, 0, 0, 0, 0, 0, 0, -5,
+			-5, 0, 0, 0, 0, 0, 0, -5,
+			0, 0, 0, 5, 5, 0, 0, 0,
+		},
+		{  // QUEEN
+			-20, -10, -10, -5, -5, -10, -10, -20,
+			-10, 0, 0, 0, 0, 0, 0, -10,
+			-10, 0, 5, 5, 5, 5, 0, -10,
+			-5, 0, 5, 5, 5, 5, 0, -5,
+			0, 0, 5, 5, 5, 5, 0, -5,
+			-10, 5, 5, 5, 5, 5, 0, -10,
+			-10, 0, 5, 0, 0, 0, 0, -10,
+			-20, -10, -10, -5, -5, -10, -10, -20,
+		},
+		{  // KING
+			-50, -40, -30, -20, -20, -30, -40, -50,
+			-30, -20, -10, 0, 0, -10, -20, -30,
+			-30, -10, 20, 30, 30, 20, -10, -30,
+			-30, -10, 30, 40, 40, 30, -10, -30,
+			-30, -10, 30, 40, 40, 30, -10, -30,
+			-30, -10, 20, 30, 30, 20, -10, -30,
+			-30, -30, 0, 0, 0, 0, -30, -30,
+			-50, -30, -30, -30, -30, -30, -30, -50,
+		},
+	},
+};
+
+
+// How much each piece type counts towards the middlegame, indexed by [PieceType]
+const int phase_weight[6] = {0, 1, 1, 2, 4, 0};
+
+
+/* Returns MAX_PHASE with all pieces on the board, down to 0 in a pawn endgame */
+int game_phase(Board* board_ptr) {
+	int phase = 0;
+	for (Colour colour = WHITE; colour <= BLACK; colour++) {
+		for (int i = 1; i < 16; i++) {
+			Piece* piece_ptr = &board_ptr->player_pieces[colour][i];
+			if (piece_ptr->alive) {
+				phase += phase_weight[piece_ptr->type];
+			}
+		}
+	}
+	// Promotions can push the phase past its starting value
+	return phase > MAX_PHASE ? MAX_PHASE : phase;
+}
+
+
+bool has_non_pawn_material(Board* board_ptr, Colour colour) {
+	// Index 0 is always the king
+	for (int i = 1; i < 16; i++) {
+		Piece* piece_ptr = &board_ptr->player_pieces[colour][i];
+		if (piece_ptr->alive && piece_ptr->type != PAWN) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/* Tapered material and piece-square evaluation, in centipawns from the
+   point of view of the side to move. Material comes from the material table,
+   which also hands known endgames to their own evaluators */
+int evaluate(Board* board_ptr) {
+	MaterialEntry* material_ptr = probe_material(board_ptr);
+	if (material_ptr->endgame == ENDGAME_DRAW) {
+		return 0;
+	}
+	if (material_ptr->endgame != ENDGAME_GENERAL) {
+		return evaluate_endgame(board_ptr, material_ptr);
+	}
+
+	// Indexed by [GamePhase], from WHITE's point of view
+	int score[2] = {material_ptr->material[MIDGAME], material_ptr->material[ENDGAME]};
+	for (Colour colour = WHITE; colour <= BLACK; colour++) {
+		int sign = colour == WHITE ? 1 : -1;
+		int flip = colour == WHITE ? 56 : 0;
+		for (int i = 0; i < 16; i++) {
+			Piece* piece_ptr = &board_ptr->player_pieces[colour][i];
+			if (!piece_ptr->alive) {
+				continue;
+			}
+			int square = piece_ptr->square ^ flip;
+			score[MIDGAME] += sign * piece_square_table[MIDGAME][piece_ptr->type][square];
+			score[ENDGAME] += sign * piece_square_table[ENDGAME][piece_ptr->type][square];
+		}
+	}
+
+	// Bishops on opposite colours hold many endgames a pawn or two down
+	if (material_ptr->opposite_bishops && opposite_coloured_bishops(board_ptr)) {
+		score[ENDGAME] = score[ENDGAME] * OPPOSITE_BISHOPS_SCALE / SCALE_NORMAL;
+	}
+
+	int phase = material_ptr->phase;
+	int tapered = (score[MIDGAME] * phase + score[ENDGAME] * (MAX_PHASE - phase)) / MAX_PHASE;
+
+	return board_ptr->current_turn == WHITE ? tapered : -tapered;
+}
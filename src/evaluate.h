@@ -0,0 +1,28 @@
+#ifndef EVALUATE_H
+#define EVALUATE_H
+
+
+#include "chess.h"
+
+
+typedef enum {
+	MIDGAME,
+	ENDGAME,
+} GamePhase;
+
+
+#define MAX_PHASE 24  // Phase weight of all minor and major pieces on the board
+
+
+extern const int piece_value[2][6];
+extern const int piece_square_table[2][6][64];
+extern const int phase_weight[6];
+
+
+/* FUNCTION DEFINITIONS */
+int game_phase(Board* board_ptr);
+bool has_non_pawn_material(Board* board_ptr, Colour colour);
+int evaluate(Board* board_ptr);
+
+
+#endif  /* EVALUATE_H */
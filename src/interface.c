@@ -1,9 +1,12 @@
+#include <stdbool.h>  // for bool
 #include <stdio.h>  // for getchar, printf and scanf
+#include <string.h>  // for strchr, strcmp, strcpy, strlen and strncmp
 #include "chess.h"
 #include "board.h"
+#include "move_generation.h"
 
 
-char* square_name[] = {
+const char* const square_name[] = {
 	"A1", "B1", "C1", "D1", "E1", "F1", "G1", "H1", 
 	"A2", "B2", "C2", "D2", "E2", "F2", "G2", "H2", 
 	"A3", "B3", "C3", "D3", "E3", "F3", "G3", "H3", 
@@ -15,12 +18,217 @@ char* square_name[] = {
 };
 
 
-char piece_symbol_table[2][6] = {
+const char piece_symbol_table[2][6] = {
 	{'P', 'N', 'B', 'R', 'Q', 'K'},
 	{'p', 'n', 'b', 'r', 'q', 'k'},
 };
 
 
+/* Writes the move in coordinate notation (e.g. "e2e4", "e7e8q"), buffer
+   must hold at least 6 characters */
+void move_to_string(Move* move_ptr, char* buffer) {
+	buffer[0] = 'a' + index_to_file(move_ptr->from);
+	buffer[1] = '1' + index_to_rank(move_ptr->from);
+	buffer[2] = 'a' + index_to_file(move_ptr->to);
+	buffer[3] = '1' + index_to_rank(move_ptr->to);
+	buffer[4] = 0;
+
+	switch (move_ptr->type) {
+		case PROMOTION_KNIGHT: case CAPTURE_PROMOTION_KNIGHT: buffer[4] = 'n'; break;
+		case PROMOTION_BISHOP: case CAPTURE_PROMOTION_BISHOP: buffer[4] = 'b'; break;
+		case PROMOTION_ROOK: case CAPTURE_PROMOTION_ROOK: buffer[4] = 'r'; break;
+		case PROMOTION_QUEEN: case CAPTURE_PROMOTION_QUEEN: buffer[4] = 'q'; break;
+		default: break;
+	}
+	buffer[5] = 0;
+}
+
+
+/* Finds the legal move written in coordinate notation, returns false if
+   there is none */
+bool string_to_move(Board* board_ptr, char* string, Move* move_ptr) {
+	MoveList* move_list_ptr = push_move_list();
+	generate_pseudo_moves(move_list_ptr, board_ptr);
+	find_legal_moves(move_list_ptr, board_ptr);
+
+	bool found = false;
+	char move_string[6];
+	for (int i = 0; i < move_list_ptr->move_count; i++) {
+		move_to_string(&move_list_ptr->moves[i], move_string);
+		if (strcmp(move_string, string) == 0) {
+			*move_ptr = move_list_ptr->moves[i];
+			found = true;
+			break;
+		}
+	}
+
+	pop_move_list();
+	return found;
+}
+
+
+PieceType promotion_piece(MoveType type) {
+	switch (type) {
+		case PROMOTION_KNIGHT: case CAPTURE_PROMOTION_KNIGHT: return KNIGHT;
+		case PROMOTION_BISHOP: case CAPTURE_PROMOTION_BISHOP: return BISHOP;
+		case PROMOTION_ROOK: case CAPTURE_PROMOTION_ROOK: return ROOK;
+		case PROMOTION_QUEEN: case CAPTURE_PROMOTION_QUEEN: return QUEEN;
+		default: return PAWN;  // Not a promotion
+	}
+}
+
+
+/* Writes the move in Standard Algebraic Notation (e.g. "Nbd7", "exd8=Q+",
+   "O-O"), buffer must hold at least SAN_LENGTH characters. The move must be
+   legal in the position */
+void move_to_san(Board* board_ptr, Move* move_ptr, char* buffer) {
+	int length = 0;
+	Piece* piece_ptr = board_ptr->squares[move_ptr->from];
+
+	if (move_ptr->type == CASTLE_KINGSIDE || move_ptr->type == CASTLE_QUEENSIDE) {
+		strcpy(buffer, move_ptr->type == CASTLE_KINGSIDE ? "O-O" : "O-O-O");
+		length = strlen(buffer);
+	}
+	else {
+		bool capture = board_ptr->squares[move_ptr->to] || move_ptr->type == EN_PASSANT;
+		if (piece_ptr->type == PAWN) {
+			if (capture) {
+				buffer[length++] = 'a' + index_to_file(move_ptr->from);
+			}
+		}
+		else {
+			buffer[length++] = piece_symbol_table[WHITE][piece_ptr->type];
+
+			// Name the file, else the rank, else both, of the moving piece
+			// when another piece of its type can reach the same square
+			MoveList* move_list_ptr = push_move_list();
+			generate_pseudo_moves(move_list_ptr, board_ptr);
+			bool ambiguous = false, same_file = false, same_rank = false;
+			for (int i = 0; i < move_list_ptr->move_count; i++) {
+				Move* other_ptr = &move_list_ptr->moves[i];
+				if (
+					other_ptr->to != move_ptr->to || other_ptr->from == move_ptr->from ||
+					board_ptr->squares[other_ptr->from]->type != piece_ptr->type ||
+					!is_legal_move(other_ptr, board_ptr)
+				) {
+					continue;
+				}
+				ambiguous = true;
+				same_file |= index_to_file(other_ptr->from) == index_to_file(move_ptr->from);
+				same_rank |= index_to_rank(other_ptr->from) == index_to_rank(move_ptr->from);
+			}
+			pop_move_list();
+
+			if (ambiguous && (!same_file || same_rank)) {
+				buffer[length++] = 'a' + index_to_file(move_ptr->from);
+			}
+			if (ambiguous && same_file) {
+				buffer[length++] = '1' + index_to_rank(move_ptr->from);
+			}
+		}
+		if (capture) {
+			buffer[length++] = 'x';
+		}
+		buffer[length++] = 'a' + index_to_file(move_ptr->to);
+		buffer[length++] = '1' + index_to_rank(move_ptr->to);
+
+		PieceType promotion = promotion_piece(move_ptr->type);
+		if (promotion != PAWN) {
+			buffer[length++] = '=';
+			buffer[length++] = piece_symbol_table[WHITE][promotion];
+		}
+	}
+
+	// Check and mate suffixes
+	MoveUndo undo;
+	play_move(move_ptr, board_ptr, &undo);
+	if (king_in_check(board_ptr, board_ptr->current_turn)) {
+		MoveList* move_list_ptr = push_move_list();
+		generate_moves(move_list_ptr, board_ptr, GEN_EVASIONS);
+		find_legal_moves(move_list_ptr, board_ptr);
+		buffer[length++] = move_list_ptr->move_count ? '+' : '#';
+		pop_move_list();
+	}
+	unplay_move(move_ptr, board_ptr, &undo);
+	buffer[length] = 0;
+}
+
+
+/* Finds the legal move a SAN string describes. Accepts the usual sloppy
+   forms: missing or extra check marks, annotations such as "!?", "0-0" for
+   castling and promotions without the "=". Returns false if no legal move
+   or more than one matches */
+bool san_to_move(Board* board_ptr, char* san, Move* move_ptr) {
+	int length = strlen(san);
+	while (length > 0 && strchr("+#!?", san[length - 1])) {
+		length--;
+	}
+
+	bool kingside = (length == 3 && (strncmp(san, "O-O", 3) == 0 || strncmp(san, "0-0", 3) == 0));
+	bool queenside = (length == 5 && (strncmp(san, "O-O-O", 5) == 0 || strncmp(san, "0-0-0", 5) == 0));
+
+	PieceType piece = PAWN;
+	PieceType promotion = PAWN;
+	int from_file = -1, from_rank = -1;
+	Square to = NONE;
+	if (!kingside && !queenside) {
+		int start = 0;
+		char* piece_position = length > 0 ? strchr("NBRQK", san[0]) : 0;
+		if (piece_position && san[0]) {
+			piece = KNIGHT + (piece_position - "NBRQK");
+			start = 1;
+		}
+		// Promotion piece, with or without the "="
+		char* promotion_position = length > 0 ? strchr("NBRQ", san[length - 1]) : 0;
+		if (piece == PAWN && promotion_position && san[length - 1]) {
+			promotion = KNIGHT + (promotion_position - "NBRQ");
+			length -= san[length - 2] == '=' ? 2 : 1;
+		}
+		if (length - start < 2) {
+			return false;
+		}
+		char file = san[length - 2], rank = san[length - 1];
+		if (file < 'a' || file > 'h' || rank < '1' || rank > '8') {
+			return false;
+		}
+		to = coordinate_to_index(file - 'a', rank - '1');
+
+		// Whatever sits between the piece letter and the destination
+		// narrows down where the piece comes from
+		for (int i = start; i < length - 2; i++) {
+			if (san[i] >= 'a' && san[i] <= 'h') { from_file = san[i] - 'a'; }
+			else if (san[i] >= '1' && san[i] <= '8') { from_rank = san[i] - '1'; }
+			else if (san[i] != 'x' && san[i] != '-') { return false; }
+		}
+	}
+
+	MoveList* move_list_ptr = push_move_list();
+	generate_pseudo_moves(move_list_ptr, board_ptr);
+	int matches = 0;
+	for (int i = 0; i < move_list_ptr->move_count; i++) {
+		Move* candidate_ptr = &move_list_ptr->moves[i];
+		if (kingside || queenside) {
+			if (candidate_ptr->type != (kingside ? CASTLE_KINGSIDE : CASTLE_QUEENSIDE)) { continue; }
+		}
+		else if (
+			candidate_ptr->to != to || board_ptr->squares[candidate_ptr->from]->type != piece ||
+			promotion_piece(candidate_ptr->type) != promotion ||
+			(from_file >= 0 && index_to_file(candidate_ptr->from) != from_file) ||
+			(from_rank >= 0 && index_to_rank(candidate_ptr->from) != from_rank)
+		) {
+			continue;
+		}
+		// Legality is only checked for the few moves that fit the text
+		if (is_legal_move(candidate_ptr, board_ptr)) {
+			*move_ptr = *candidate_ptr;
+			matches++;
+		}
+	}
+	pop_move_list();
+	return matches == 1;
+}
+
+
 char piece_symbol(Piece* piece_ptr) {
 	return piece_symbol_table[piece_ptr->colour][piece_ptr->type];
 }
@@ -5,7 +5,15 @@
 #include "chess.h"
 
 
+#define SAN_LENGTH 8  // Longest SAN move, e.g. "exd8=Q#", plus the terminator
+
+
 /* FUNCTION DEFINITIONS */
+void move_to_string(Move* move_ptr, char* buffer);
+bool string_to_move(Board* board_ptr, char* string, Move* move_ptr);
+PieceType promotion_piece(MoveType type);
+void move_to_san(Board* board_ptr, Move* move_ptr, char* buffer);
+bool san_to_move(Board* board_ptr, char* san, Move* move_ptr);
 void print_board(Board* board_ptr);
 void print_board_details(Board* board_ptr);
 void print_move_list(MoveList* move_list_ptr);
@@ -1,10 +1,67 @@
-// gcc -o out main.c board.c chess.c interface.c move_generation.c perft.c
+// gcc -O2 -o out main.c attacks.c batch.c bitboard_batch.c bench.c board.c chess.c evaluate.c interface.c match.c mate.c material.c mcts.c move_generation.c perft.c pgn.c play.c position_index.c search.c split_perft.c timeman.c trace.c tt.c tune.c uci.c zobrist.c -lm -lpthread
+#include <string.h>  // for strcmp
 #include "chess.h"
+#include "batch.h"
+#include "bench.h"
+#include "match.h"
+#include "mate.h"
+#include "mcts.h"
 #include "perft.h"
+#include "pgn.h"
+#include "play.h"
+#include "position_index.h"
+#include "split_perft.h"
+#include "trace.h"
+#include "tt.h"
+#include "tune.h"
+#include "uci.h"
 
 
-int main(void) {
-	// play_game();
-	run_perft_suite();
+int main(int argc, char** argv) {
+	if (argc > 1 && strcmp(argv[1], "play") == 0) {
+		play_game(argc - 2, argv + 2);
+	}
+	else if (argc > 1 && strcmp(argv[1], "uci") == 0) {
+		uci_loop();
+	}
+	else if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		run_bench(argc - 2, argv + 2);
+	}
+	else if (argc > 1 && strcmp(argv[1], "batch") == 0) {
+		run_batch(argc - 2, argv + 2);
+	}
+	else if (argc > 1 && strcmp(argv[1], "match") == 0) {
+		run_match(argc - 2, argv + 2);
+	}
+	else if (argc > 1 && strcmp(argv[1], "mate") == 0) {
+		run_mate(argc - 2, argv + 2);
+	}
+	else if (argc > 1 && strcmp(argv[1], "mcts") == 0) {
+		run_mcts(argc - 2, argv + 2);
+	}
+	else if (argc > 1 && strcmp(argv[1], "pgn") == 0) {
+		run_pgn(argc - 2, argv + 2);
+	}
+	else if (argc > 1 && strcmp(argv[1], "index") == 0) {
+		run_index(argc - 2, argv + 2);
+	}
+	else if (argc > 1 && strcmp(argv[1], "tune") == 0) {
+		run_tune(argc - 2, argv + 2);
+	}
+	else if (argc > 1 && strcmp(argv[1], "trace") == 0) {
+		run_trace_report(argc - 2, argv + 2);
+	}
+	else if (argc > 1 && strcmp(argv[1], "ttfile") == 0) {
+		run_tt_file(argc - 2, argv + 2);
+	}
+	else if (argc > 1 && strcmp(argv[1], "perftstats") == 0) {
+		run_perft_stats_suite();
+	}
+	else if (argc > 1 && strcmp(argv[1], "splitperft") == 0) {
+		run_split_perft(argc - 2, argv + 2);
+	}
+	else {
+		run_perft_suite();
+	}
 	return 0;
 }
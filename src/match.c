@@ -0,0 +1,320 @@
+#include <math.h>  // for log, log10, pow and sqrt
+#include <pthread.h>  // for pthread_create, pthread_join and pthread_mutex_t
+#include <stdbool.h>  // for bool
+#include <stdio.h>  // for fopen, fgets and printf
+#include <stdlib.h>  // for atoi, atof, malloc and free
+#include <string.h>  // for strcmp, strncmp and strlen
+#include <unistd.h>  // for sysconf
+#include "chess.h"
+#include "board.h"
+#include "move_generation.h"
+#include "search.h"
+#include "tt.h"
+
+
+#define MAX_OPENINGS 4096
+#define MAX_FEN_LENGTH 128
+#define MAX_GAME_LENGTH 600  // Plies before a game is adjudicated a draw
+#define DEFAULT_MATCH_NODES 20000
+#define DEFAULT_MATCH_GAMES 1000
+#define MATCH_HASH_MB 16  // Per engine, and each worker runs two
+
+
+typedef enum {
+	ENGINE_A_WINS,
+	DRAW,
+	ENGINE_B_WINS,
+} GameResult;
+
+
+typedef struct {
+	// Settings, fixed before the worker threads start
+	char (*openings)[MAX_FEN_LENGTH];
+	int opening_count;
+	int max_games;
+	SearchLimits limits;
+	SearchOptions engine_options[2];  // Engine A, engine B
+	double elo0, elo1;
+	double llr_lower, llr_upper;
+
+	// Shared progress, guarded by lock
+	pthread_mutex_t lock;
+	int next_game;
+	int results[3];  // Indexed by [GameResult]
+	bool finished;
+} Match;
+
+
+/* Copies the four board fields of an EPD line into a FEN string, dropping
+   any operations. Returns false for blank lines and comments */
+bool epd_to_fen(char* epd, char* fen) {
+	int fields = 0;
+	int length = 0;
+	for (int i = 0; epd[i] && epd[i] != '\n' && epd[i] != '\r'; i++) {
+		if (epd[i] == ' ') {
+			fields++;
+			if (fields == 4) {
+				break;
+			}
+		}
+		if (length < MAX_FEN_LENGTH - 8) {
+			fen[length++] = epd[i];
+		}
+	}
+	fen[length] = 0;
+	if (length == 0 || fen[0] == '#') {
+		return false;
+	}
+	strcat(fen, " 0 1");
+	return true;
+}
+
+
+int load_openings(char* path, char (*openings)[MAX_FEN_LENGTH]) {
+	FILE* file = fopen(path, "r");
+	if (!file) {
+		return 0;
+	}
+	char line[512];
+	int count = 0;
+	int rejected = 0;
+	while (count < MAX_OPENINGS && fgets(line, sizeof(line), file)) {
+		if (!epd_to_fen(line, openings[count])) {
+			continue;
+		}
+		// A bad position would only fail later, inside a worker's setup_board
+		if (validate_fen(openings[count])) {
+			count++;
+		}
+		else {
+			rejected++;
+		}
+	}
+	fclose(file);
+	if (rejected > 0) {
+		printf("Skipped %d invalid openings in %s\n", rejected, path);
+	}
+	return count;
+}
+
+
+/* Plays one game from the opening. Engine A plays WHITE when a_is_white */
+GameResult play_match_game(Match* match_ptr, char* fen, bool a_is_white, SearchInfo* engines[2]) {
+	Board board = {};
+	setup_board(&board, fen);
+	clear_search_tables(engines[0]);
+	clear_search_tables(engines[1]);
+	tt_clear(engines[0]->tt_ptr, 1);
+	tt_clear(engines[1]->tt_ptr, 1);
+
+	for (int ply = 0; ply < MAX_GAME_LENGTH; ply++) {
+		bool a_to_move = (board.current_turn == WHITE) == a_is_white;
+		if (!has_legal_move(&board)) {
+			if (!king_in_check(&board, board.current_turn)) {
+				return DRAW;
+			}
+			return a_to_move ? ENGINE_B_WINS : ENGINE_A_WINS;
+		}
+		if (count_repetitions(&board) >= 2 || is_fifty_move_draw(&board) || is_insufficient_material(&board)) {
+			return DRAW;
+		}
+
+		SearchInfo* engine_ptr = engines[a_to_move ? 0 : 1];
+		engine_ptr->limits = match_ptr->limits;
+		search(&board, engine_ptr);
+
+		MoveUndo undo;
+		play_move(&engine_ptr->best_move, &board, &undo);
+	}
+	return DRAW;
+}
+
+
+double expected_score(double elo) {
+	return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+
+double score_to_elo(double score) {
+	if (score <= 0.0 || score >= 1.0) {
+		return score <= 0.0 ? -INFINITY : INFINITY;
+	}
+	return -400.0 * log10(1.0 / score - 1.0);
+}
+
+
+/* Log-likelihood ratio of elo1 against elo0 for the trinomial game results,
+   using the normal approximation of the generalised SPRT */
+double sprt_llr(int results[3], double elo0, double elo1) {
+	int wins = results[ENGINE_A_WINS];
+	int draws = results[DRAW];
+	int losses = results[ENGINE_B_WINS];
+
+	double games = wins + draws + losses;
+	double score = (wins + draws / 2.0) / games;
+	double second_moment = (wins + draws / 4.0) / games;
+	double variance = second_moment - score * score;
+	if (variance <= 0.0) {
+		return 0.0;
+	}
+
+	double score0 = expected_score(elo0);
+	double score1 = expected_score(elo1);
+	return (score1 - score0) * (2.0 * score - score0 - score1) / (2.0 * variance / games);
+}
+
+
+/* A perfect or zero score has no finite Elo, so scores are kept half a
+   game away from either end */
+double clamp_score(double score, int games) {
+	double limit = 0.5 / games;
+	return score < limit ? limit : (score > 1.0 - limit ? 1.0 - limit : score);
+}
+
+
+void print_match_status(Match* match_ptr) {
+	int* results = match_ptr->results;
+	int games = results[ENGINE_A_WINS] + results[DRAW] + results[ENGINE_B_WINS];
+	double score = (results[ENGINE_A_WINS] + results[DRAW] / 2.0) / games;
+	double second_moment = (results[ENGINE_A_WINS] + results[DRAW] / 4.0) / games;
+	double margin = 1.96 * sqrt((second_moment - score * score) / games);
+
+	double elo = score_to_elo(clamp_score(score, games));
+	double elo_error = (score_to_elo(clamp_score(score + margin, games)) - score_to_elo(clamp_score(score - margin, games))) / 2.0;
+	double llr = sprt_llr(results, match_ptr->elo0, match_ptr->elo1);
+
+	printf(
+		"Games: %d W: %d D: %d L: %d Elo: %.1f +/- %.1f LLR: %.2f [%.2f, %.2f]\n",
+		games, results[ENGINE_A_WINS], results[DRAW], results[ENGINE_B_WINS],
+		elo, elo_error, llr, match_ptr->llr_lower, match_ptr->llr_upper
+	);
+	fflush(stdout);
+}
+
+
+/* Each worker owns a pair of engine instances and plays one game at a time
+   until the game budget runs out or the SPRT reaches a decision */
+void* match_worker(void* arg) {
+	Match* match_ptr = arg;
+	SearchInfo* engines[2] = {malloc(sizeof(SearchInfo)), malloc(sizeof(SearchInfo))};
+	engines[0]->options = match_ptr->engine_options[0];
+	engines[1]->options = match_ptr->engine_options[1];
+	engines[0]->verbose = false;
+	engines[1]->verbose = false;
+	TranspositionTable tables[2];
+	tt_init(&tables[0], MATCH_HASH_MB, 1, false);
+	tt_init(&tables[1], MATCH_HASH_MB, 1, false);
+	engines[0]->tt_ptr = &tables[0];
+	engines[1]->tt_ptr = &tables[1];
+	engines[0]->trace_ptr = 0;
+	engines[1]->trace_ptr = 0;
+	engines[0]->control_ptr = 0;
+	engines[1]->control_ptr = 0;
+
+	while (1) {
+		pthread_mutex_lock(&match_ptr->lock);
+		int game = match_ptr->next_game++;
+		bool finished = match_ptr->finished || game >= match_ptr->max_games;
+		pthread_mutex_unlock(&match_ptr->lock);
+		if (finished) {
+			break;
+		}
+
+		// Games are played in pairs from each opening with colours reversed
+		char* fen = match_ptr->openings[(game / 2) % match_ptr->opening_count];
+		GameResult result = play_match_game(match_ptr, fen, game % 2 == 0, engines);
+
+		pthread_mutex_lock(&match_ptr->lock);
+		if (!match_ptr->finished) {
+			match_ptr->results[result]++;
+			print_match_status(match_ptr);
+
+			double llr = sprt_llr(match_ptr->results, match_ptr->elo0, match_ptr->elo1);
+			if (llr >= match_ptr->llr_upper || llr <= match_ptr->llr_lower) {
+				printf(llr >= match_ptr->llr_upper ? "H1 accepted\n" : "H0 accepted\n");
+				match_ptr->finished = true;
+			}
+		}
+		pthread_mutex_unlock(&match_ptr->lock);
+	}
+
+	tt_free(&tables[0]);
+	tt_free(&tables[1]);
+	free(engines[0]);
+	free(engines[1]);
+	return 0;
+}
+
+
+/* Self-play match between two configurations of the engine, one game per
+   core. Usage:
+     match <openings.epd> [games N] [threads N] [nodes N] [depth N]
+           [elo0 X] [elo1 X] [alpha X] [beta X] [a:no-lmr] [b:no-null] ...
+   Engine flags prefixed with a: or b: switch off techniques in that engine */
+void run_match(int argc, char** argv) {
+	if (argc < 1) {
+		printf("Usage: match <openings.epd> [options]\n");
+		return;
+	}
+
+	static Match match;
+	match.openings = malloc(sizeof(*match.openings) * MAX_OPENINGS);
+	match.opening_count = load_openings(argv[0], match.openings);
+	if (match.opening_count == 0) {
+		printf("No openings loaded from %s\n", argv[0]);
+		free(match.openings);
+		return;
+	}
+
+	match.max_games = DEFAULT_MATCH_GAMES;
+	match.limits = (SearchLimits){.nodes = DEFAULT_MATCH_NODES};
+	match.engine_options[0] = default_search_options;
+	match.engine_options[1] = default_search_options;
+	match.elo0 = 0.0;
+	match.elo1 = 5.0;
+	double alpha = 0.05;
+	double beta = 0.05;
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	for (int i = 1; i < argc; i++) {
+		char* value = i + 1 < argc ? argv[i + 1] : "0";
+		if (strcmp(argv[i], "games") == 0) { match.max_games = atoi(value); i++; }
+		else if (strcmp(argv[i], "threads") == 0) { threads = atoi(value); i++; }
+		else if (strcmp(argv[i], "nodes") == 0) { match.limits.nodes = atoll(value); i++; }
+		else if (strcmp(argv[i], "depth") == 0) { match.limits.depth = atoi(value); i++; }
+		else if (strcmp(argv[i], "elo0") == 0) { match.elo0 = atof(value); i++; }
+		else if (strcmp(argv[i], "elo1") == 0) { match.elo1 = atof(value); i++; }
+		else if (strcmp(argv[i], "alpha") == 0) { alpha = atof(value); i++; }
+		else if (strcmp(argv[i], "beta") == 0) { beta = atof(value); i++; }
+		else if (strncmp(argv[i], "a:", 2) == 0 && parse_search_option(argv[i] + 2, &match.engine_options[0])) {}
+		else if (strncmp(argv[i], "b:", 2) == 0 && parse_search_option(argv[i] + 2, &match.engine_options[1])) {}
+		else {
+			printf("Unknown match argument: %s\n", argv[i]);
+			free(match.openings);
+			return;
+		}
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+
+	match.llr_lower = log(beta / (1.0 - alpha));
+	match.llr_upper = log((1.0 - beta) / alpha);
+	pthread_mutex_init(&match.lock, 0);
+
+	printf(
+		"%d openings, %d games, %d threads, SPRT elo0: %.1f elo1: %.1f\n",
+		match.opening_count, match.max_games, threads, match.elo0, match.elo1
+	);
+
+	pthread_t workers[threads];
+	for (int i = 0; i < threads; i++) {
+		pthread_create(&workers[i], 0, match_worker, &match);
+	}
+	for (int i = 0; i < threads; i++) {
+		pthread_join(workers[i], 0);
+	}
+
+	pthread_mutex_destroy(&match.lock);
+	free(match.openings);
+}
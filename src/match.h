@@ -0,0 +1,9 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+
+/* FUNCTION DEFINITIONS */
+void run_match(int argc, char** argv);
+
+
+#endif  /* MATCH_H */
@@ -0,0 +1,467 @@
+#include <stdbool.h>  // for bool
+#include <stdio.h>  // for fopen, fgets and printf
+#include <stdlib.h>  // for atoi, atoll, calloc and free
+#include <string.h>  // for memset, strcmp, strcspn and strstr
+#include "chess.h"
+#include "board.h"
+#include "interface.h"
+#include "mate.h"
+#include "move_generation.h"
+#include "timeman.h"
+
+
+/*
+ * Depth-first proof-number search for forced mates. The attacker only ever
+ * plays checks and the defender every legal reply, so the tree is far
+ * narrower than a full width search and grows towards the lines where the
+ * defence has the fewest options. Proof and disproof numbers live in a fixed
+ * size table, so memory is bounded however long the search runs: a position
+ * that has been evicted is simply searched again.
+ *
+ * Repetitions count as a defence. That is path dependent, so a proof is
+ * always sound but a disproof can occasionally be too pessimistic.
+ */
+
+
+#define DEFAULT_MATE_HASH_MB 64
+#define MAX_MATE_MOVES ((MAX_PLY - 1) / 2)
+#define MAX_EPD_LINE 256
+
+
+bool mate_solver_init(MateSolver* solver_ptr, size_t megabytes) {
+	size_t buckets = 1;
+	while (buckets * 2 * DFPN_BUCKET_SIZE * sizeof(DfpnEntry) <= megabytes * 1024 * 1024) {
+		buckets *= 2;
+	}
+	solver_ptr->entries = calloc(buckets * DFPN_BUCKET_SIZE, sizeof(DfpnEntry));
+	solver_ptr->bucket_mask = buckets - 1;
+	solver_ptr->nodes = 0;
+	solver_ptr->node_limit = 0;
+	solver_ptr->move_limit = false;
+	solver_ptr->checks_only = true;
+	solver_ptr->stopped = false;
+	return solver_ptr->entries != 0;
+}
+
+
+void mate_solver_free(MateSolver* solver_ptr) {
+	free(solver_ptr->entries);
+	solver_ptr->entries = 0;
+}
+
+
+void mate_solver_clear(MateSolver* solver_ptr) {
+	memset(solver_ptr->entries, 0, (solver_ptr->bucket_mask + 1) * DFPN_BUCKET_SIZE * sizeof(DfpnEntry));
+}
+
+
+uint64_t node_key(MateSolver* solver_ptr, Board* board_ptr, int remaining) {
+	if (!solver_ptr->move_limit) {
+		return board_ptr->hash;
+	}
+	return board_ptr->hash ^ (remaining * 0x9E3779B97F4A7C15ULL);
+}
+
+
+/* Unknown positions start at 1 and 1 */
+DfpnEntry* dfpn_lookup(MateSolver* solver_ptr, uint64_t key) {
+	DfpnEntry* bucket = &solver_ptr->entries[(key & solver_ptr->bucket_mask) * DFPN_BUCKET_SIZE];
+	for (int i = 0; i < DFPN_BUCKET_SIZE; i++) {
+		if (bucket[i].key == key && (bucket[i].phi || bucket[i].delta)) {
+			return &bucket[i];
+		}
+	}
+	return 0;
+}
+
+
+void dfpn_store(MateSolver* solver_ptr, uint64_t key, uint32_t phi, uint32_t delta, int distance, long long work) {
+	DfpnEntry* bucket = &solver_ptr->entries[(key & solver_ptr->bucket_mask) * DFPN_BUCKET_SIZE];
+	DfpnEntry* replace_ptr = &bucket[0];
+	for (int i = 0; i < DFPN_BUCKET_SIZE; i++) {
+		if (bucket[i].key == key) {
+			replace_ptr = &bucket[i];
+			break;
+		}
+		if (bucket[i].work < replace_ptr->work) {
+			replace_ptr = &bucket[i];
+		}
+	}
+	replace_ptr->key = key;
+	replace_ptr->phi = phi;
+	replace_ptr->delta = delta;
+	replace_ptr->distance = distance;
+	replace_ptr->work = work > UINT32_MAX ? UINT32_MAX : work;
+}
+
+
+/* Whether the move could check the king on king_square, directly or by
+   uncovering a line. Cheap enough to rule out most moves before playing them */
+bool could_give_check(Move* move_ptr, PieceType type, Square king_square) {
+	if (move_ptr->type == CASTLE_KINGSIDE || move_ptr->type == CASTLE_QUEENSIDE || move_ptr->type == EN_PASSANT) {
+		return true;
+	}
+	if (promotion_piece(move_ptr->type) != PAWN) {
+		return true;
+	}
+
+	int king_file = index_to_file(king_square), king_rank = index_to_rank(king_square);
+	int from_file = index_to_file(move_ptr->from) - king_file, from_rank = index_to_rank(move_ptr->from) - king_rank;
+	if (from_file == 0 || from_rank == 0 || from_file == from_rank || from_file == -from_rank) {
+		return true;
+	}
+
+	int file = index_to_file(move_ptr->to) - king_file, rank = index_to_rank(move_ptr->to) - king_rank;
+	bool straight = file == 0 || rank == 0;
+	bool diagonal = file == rank || file == -rank;
+	switch (type) {
+		case PAWN: return (file == 1 || file == -1) && (rank == 1 || rank == -1);
+		case KNIGHT: return file * file + rank * rank == 5;
+		case BISHOP: return diagonal;
+		case ROOK: return straight;
+		case QUEEN: return straight || diagonal;
+		default: return false;
+	}
+}
+
+
+/* Legal moves that give check, for the attacker */
+void generate_checks(MoveList* move_list_ptr, Board* board_ptr) {
+	Colour them = get_opponent_colour(board_ptr->current_turn);
+	Square king_square = board_ptr->player_pieces[them][0].square;
+	generate_moves(move_list_ptr, board_ptr, GEN_ALL);
+
+	int checks = 0;
+	for (int i = 0; i < move_list_ptr->move_count; i++) {
+		Move* move_ptr = &move_list_ptr->moves[i];
+		if (!could_give_check(move_ptr, board_ptr->squares[move_ptr->from]->type, king_square)) {
+			continue;
+		}
+		MoveUndo undo;
+		play_move(move_ptr, board_ptr, &undo);
+		bool check = king_in_check(board_ptr, them);
+		unplay_move(move_ptr, board_ptr, &undo);
+		if (check && is_legal_move(move_ptr, board_ptr)) {
+			move_list_ptr->moves[checks++] = *move_ptr;
+		}
+	}
+	move_list_ptr->move_count = checks;
+}
+
+
+/* Legal replies to a check, for the defender */
+void generate_defences(MoveList* move_list_ptr, Board* board_ptr) {
+	generate_moves(move_list_ptr, board_ptr, GEN_EVASIONS);
+	find_legal_moves(move_list_ptr, board_ptr);
+}
+
+
+void generate_solver_moves(MateSolver* solver_ptr, MoveList* move_list_ptr, Board* board_ptr, bool attacker, int remaining) {
+	if (attacker && remaining <= 0) {
+		move_list_ptr->move_count = 0;
+	}
+	else if (attacker && solver_ptr->checks_only) {
+		generate_checks(move_list_ptr, board_ptr);
+	}
+	else {
+		// Also every legal move when the defender is not in check
+		generate_defences(move_list_ptr, board_ptr);
+	}
+}
+
+
+/* Proof numbers of a child. A repetition is a win for the defender */
+void child_numbers(MateSolver* solver_ptr, uint64_t key, bool repeated, bool child_attacker, uint32_t* phi_ptr, uint32_t* delta_ptr, int* distance_ptr) {
+	*distance_ptr = 0;
+	if (repeated) {
+		*phi_ptr = child_attacker ? DFPN_INFINITY : 0;
+		*delta_ptr = child_attacker ? 0 : DFPN_INFINITY;
+		return;
+	}
+	DfpnEntry* entry_ptr = dfpn_lookup(solver_ptr, key);
+	*phi_ptr = entry_ptr ? entry_ptr->phi : 1;
+	*delta_ptr = entry_ptr ? entry_ptr->delta : 1;
+	*distance_ptr = entry_ptr ? entry_ptr->distance : 0;
+}
+
+
+/* Searches until the node's phi reaches phi_threshold or its delta reaches
+   delta_threshold, then stores its numbers */
+void dfpn(MateSolver* solver_ptr, Board* board_ptr, uint32_t phi_threshold, uint32_t delta_threshold, int remaining, bool attacker, int ply) {
+	long long start_nodes = solver_ptr->nodes++;
+	if (solver_ptr->node_limit && solver_ptr->nodes >= solver_ptr->node_limit) {
+		solver_ptr->stopped = true;
+	}
+	uint64_t key = node_key(solver_ptr, board_ptr, remaining);
+
+	MoveList* move_list_ptr = push_move_list();
+	if (ply < MAX_PLY - 1) {
+		generate_solver_moves(solver_ptr, move_list_ptr, board_ptr, attacker, remaining);
+	}
+	else {
+		move_list_ptr->move_count = 0;
+	}
+
+	// Without moves the side to move has lost, unless it is a stalemated
+	// defender or the line ran out of plies
+	if (move_list_ptr->move_count == 0) {
+		bool defender_holds = !attacker && !king_in_check(board_ptr, board_ptr->current_turn);
+		dfpn_store(
+			solver_ptr, key, defender_holds ? 0 : DFPN_INFINITY, defender_holds ? DFPN_INFINITY : 0,
+			0, solver_ptr->nodes - start_nodes
+		);
+		pop_move_list();
+		return;
+	}
+
+	int child_remaining = attacker ? remaining - 1 : remaining;
+	uint64_t child_keys[MAX_MOVES];
+	bool repeated[MAX_MOVES];
+	for (int i = 0; i < move_list_ptr->move_count; i++) {
+		MoveUndo undo;
+		play_move(&move_list_ptr->moves[i], board_ptr, &undo);
+		child_keys[i] = node_key(solver_ptr, board_ptr, child_remaining);
+		repeated[i] = is_repetition(board_ptr);
+		unplay_move(&move_list_ptr->moves[i], board_ptr, &undo);
+	}
+
+	while (true) {
+		// phi is the smallest child delta and delta the sum of the child phis
+		uint32_t phi = DFPN_INFINITY, delta = 0, second_delta = DFPN_INFINITY, best_phi = 0;
+		int best = 0, win_distance = MAX_PLY, loss_distance = 0;
+		for (int i = 0; i < move_list_ptr->move_count; i++) {
+			uint32_t child_phi, child_delta;
+			int child_distance;
+			child_numbers(solver_ptr, child_keys[i], repeated[i], !attacker, &child_phi, &child_delta, &child_distance);
+			if (child_delta < phi) {
+				second_delta = phi;
+				phi = child_delta;
+				best = i;
+				best_phi = child_phi;
+			}
+			else if (child_delta < second_delta) {
+				second_delta = child_delta;
+			}
+			if (child_phi >= DFPN_INFINITY || delta >= DFPN_INFINITY) {
+				delta = DFPN_INFINITY;
+			}
+			else {
+				delta = delta + child_phi >= DFPN_INFINITY ? DFPN_INFINITY - 1 : delta + child_phi;
+			}
+			if (child_delta == 0 && child_distance + 1 < win_distance) {
+				win_distance = child_distance + 1;
+			}
+			if (child_phi == 0 && child_distance + 1 > loss_distance) {
+				loss_distance = child_distance + 1;
+			}
+		}
+
+		if (phi >= phi_threshold || delta >= delta_threshold || solver_ptr->stopped) {
+			int distance = phi == 0 ? win_distance : (delta == 0 ? loss_distance : 0);
+			dfpn_store(solver_ptr, key, phi, delta, distance, solver_ptr->nodes - start_nodes);
+			break;
+		}
+
+		uint32_t child_phi_threshold = delta_threshold >= DFPN_INFINITY ? DFPN_INFINITY : delta_threshold + best_phi - delta;
+		uint32_t child_delta_threshold = phi_threshold < second_delta + 1 ? phi_threshold : second_delta + 1;
+		MoveUndo undo;
+		play_move(&move_list_ptr->moves[best], board_ptr, &undo);
+		dfpn(solver_ptr, board_ptr, child_phi_threshold, child_delta_threshold, child_remaining, !attacker, ply + 1);
+		unplay_move(&move_list_ptr->moves[best], board_ptr, &undo);
+	}
+	pop_move_list();
+}
+
+
+/* Walks the proof from the root: the attacker takes its quickest proven
+   mate and the defender the longest. A node whose children were evicted
+   from the table is proven again */
+void extract_mate_line(MateSolver* solver_ptr, Board* board_ptr, int remaining, MateResult* result_ptr) {
+	MoveUndo undos[MAX_PLY];
+	bool attacker = true;
+	result_ptr->line_length = 0;
+
+	while (result_ptr->line_length < MAX_PLY - 1) {
+		MoveList* move_list_ptr = push_move_list();
+		generate_solver_moves(solver_ptr, move_list_ptr, board_ptr, attacker, remaining);
+		int child_remaining = attacker ? remaining - 1 : remaining;
+
+		int chosen = -1, chosen_distance = 0;
+		for (int attempt = 0; attempt < 2 && chosen < 0 && move_list_ptr->move_count > 0; attempt++) {
+			if (attempt == 1) {
+				dfpn(solver_ptr, board_ptr, DFPN_INFINITY, DFPN_INFINITY, remaining, attacker, result_ptr->line_length);
+			}
+			for (int i = 0; i < move_list_ptr->move_count; i++) {
+				MoveUndo undo;
+				play_move(&move_list_ptr->moves[i], board_ptr, &undo);
+				DfpnEntry* entry_ptr = is_repetition(board_ptr) ? 0 : dfpn_lookup(solver_ptr, node_key(solver_ptr, board_ptr, child_remaining));
+				unplay_move(&move_list_ptr->moves[i], board_ptr, &undo);
+				// The attacker wants a child where the defender has lost,
+				// the defender has to pick from children the attacker wins
+				bool decided = entry_ptr && (attacker ? entry_ptr->delta == 0 : entry_ptr->phi == 0);
+				if (decided && (chosen < 0 || (attacker ? entry_ptr->distance < chosen_distance : entry_ptr->distance > chosen_distance))) {
+					chosen = i;
+					chosen_distance = entry_ptr->distance;
+				}
+			}
+		}
+		if (chosen < 0) {
+			pop_move_list();
+			break;
+		}
+		Move move = move_list_ptr->moves[chosen];
+		pop_move_list();
+		result_ptr->line[result_ptr->line_length] = move;
+		play_move(&move, board_ptr, &undos[result_ptr->line_length]);
+		result_ptr->line_length++;
+		remaining = child_remaining;
+		attacker = !attacker;
+	}
+
+	for (int i = result_ptr->line_length - 1; i >= 0; i--) {
+		unplay_move(&result_ptr->line[i], board_ptr, &undos[i]);
+	}
+}
+
+
+/* Looks for a mate by the side to move in at most max_moves moves, or in
+   any number when it is 0 */
+void solve_mate(MateSolver* solver_ptr, Board* board_ptr, int max_moves, MateResult* result_ptr) {
+	if (max_moves <= 0 || max_moves > MAX_MATE_MOVES) {
+		max_moves = MAX_MATE_MOVES;
+		solver_ptr->move_limit = false;
+	}
+	else {
+		solver_ptr->move_limit = true;
+	}
+	int remaining = max_moves;  // Attacker moves left, counted down at attacker nodes
+	solver_ptr->nodes = 0;
+	solver_ptr->stopped = false;
+
+	dfpn(solver_ptr, board_ptr, DFPN_INFINITY, DFPN_INFINITY, remaining, true, 0);
+	DfpnEntry* root_ptr = dfpn_lookup(solver_ptr, node_key(solver_ptr, board_ptr, remaining));
+
+	result_ptr->status = MATE_UNKNOWN;
+	result_ptr->moves = 0;
+	result_ptr->line_length = 0;
+	if (root_ptr && root_ptr->phi == 0) {
+		result_ptr->status = MATE_FOUND;
+		result_ptr->moves = (root_ptr->distance + 1) / 2;
+		// Following the proof can need positions to be proven again, which
+		// must not be cut short by the node limit
+		long long node_limit = solver_ptr->node_limit;
+		solver_ptr->node_limit = 0;
+		solver_ptr->stopped = false;
+		extract_mate_line(solver_ptr, board_ptr, remaining, result_ptr);
+		solver_ptr->node_limit = node_limit;
+	}
+	else if (root_ptr && root_ptr->delta == 0 && !solver_ptr->stopped) {
+		result_ptr->status = NO_MATE;
+	}
+	result_ptr->nodes = solver_ptr->nodes;
+}
+
+
+/* Prints "<status> <nodes> <line in SAN>" for one position */
+void print_mate_result(Board* board_ptr, MateResult* result_ptr, long long time_elapsed) {
+	if (result_ptr->status == MATE_FOUND) {
+		printf("mate in %d", result_ptr->moves);
+	}
+	else {
+		printf(result_ptr->status == NO_MATE ? "no mate" : "unknown");
+	}
+	printf(" nodes: %lld time: %.3fs", result_ptr->nodes, time_elapsed / 1000.0);
+
+	if (result_ptr->line_length > 0) {
+		MoveUndo undos[MAX_PLY];
+		printf(" line:");
+		for (int i = 0; i < result_ptr->line_length; i++) {
+			char san[SAN_LENGTH];
+			move_to_san(board_ptr, &result_ptr->line[i], san);
+			printf(" %s", san);
+			play_move(&result_ptr->line[i], board_ptr, &undos[i]);
+		}
+		for (int i = result_ptr->line_length - 1; i >= 0; i--) {
+			unplay_move(&result_ptr->line[i], board_ptr, &undos[i]);
+		}
+	}
+	printf("\n");
+}
+
+
+/* Usage: mate <fen | epd file> [moves N] [hash MB] [nodes N] [quiet]
+   Lines of an EPD file may carry "dm N;", which then limits the search to
+   mates in N and counts as solved only if one is found. With quiet the
+   attacker may play any move rather than only checks */
+void run_mate(int argc, char** argv) {
+	if (argc < 1) {
+		printf("Usage: mate <fen | epd file> [moves N] [hash MB] [nodes N] [quiet]\n");
+		return;
+	}
+	int max_moves = 0;
+	long long hash_mb = DEFAULT_MATE_HASH_MB;
+	long long node_limit = 0;
+	bool checks_only = true;
+	for (int i = 1; i < argc; i++) {
+		char* value = i + 1 < argc ? argv[i + 1] : "0";
+		if (strcmp(argv[i], "moves") == 0) { max_moves = atoi(value); i++; }
+		else if (strcmp(argv[i], "hash") == 0) { hash_mb = atoll(value); i++; }
+		else if (strcmp(argv[i], "nodes") == 0) { node_limit = atoll(value); i++; }
+		else if (strcmp(argv[i], "quiet") == 0) { checks_only = false; }
+		else { printf("Unknown mate argument: %s\n", argv[i]); return; }
+	}
+
+	static MateSolver solver;
+	if (!mate_solver_init(&solver, hash_mb > 0 ? hash_mb : 1)) {
+		printf("Could not allocate %lld MB\n", hash_mb);
+		return;
+	}
+	solver.node_limit = node_limit;
+	solver.checks_only = checks_only;
+	static Board board;
+	MateResult result;
+
+	if (validate_fen(argv[0])) {
+		setup_board(&board, argv[0]);
+		long long start_time = current_time_ms();
+		solve_mate(&solver, &board, max_moves, &result);
+		print_mate_result(&board, &result, current_time_ms() - start_time);
+		mate_solver_free(&solver);
+		return;
+	}
+
+	FILE* file = fopen(argv[0], "r");
+	if (!file) {
+		printf("Not a FEN or readable file: %s\n", argv[0]);
+		mate_solver_free(&solver);
+		return;
+	}
+	char line[MAX_EPD_LINE];
+	int positions = 0, solved = 0;
+	long long total_nodes = 0;
+	long long start_time = current_time_ms();
+	while (fgets(line, sizeof(line), file)) {
+		line[strcspn(line, "\r\n")] = 0;
+		if (!validate_fen(line)) {
+			continue;
+		}
+		char* dm = strstr(line, " dm ");
+		int line_moves = dm ? atoi(dm + 4) : max_moves;
+
+		setup_board(&board, line);
+		mate_solver_clear(&solver);
+		long long position_start = current_time_ms();
+		solve_mate(&solver, &board, line_moves, &result);
+		positions++;
+		solved += result.status == MATE_FOUND && (!dm || result.moves <= line_moves);
+		total_nodes += result.nodes;
+		printf("%d: ", positions);
+		print_mate_result(&board, &result, current_time_ms() - position_start);
+	}
+	fclose(file);
+	printf(
+		"solved: %d/%d nodes: %lld time: %.3fs\n",
+		solved, positions, total_nodes, (current_time_ms() - start_time) / 1000.0
+	);
+	mate_solver_free(&solver);
+}
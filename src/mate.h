@@ -0,0 +1,62 @@
+#ifndef MATE_H
+#define MATE_H
+
+
+#include <stdbool.h>  // for bool
+#include <stddef.h>  // for size_t
+#include <stdint.h>  // for uint16_t, uint32_t and uint64_t
+#include "chess.h"
+
+
+#define DFPN_INFINITY 100000000  // Proof or disproof number of a decided node
+#define DFPN_BUCKET_SIZE 4
+
+
+/* Proof and disproof numbers from the point of view of the side to move:
+   phi is 0 once it is proven to win, delta is 0 once it is proven to lose */
+typedef struct {
+	uint64_t key;
+	uint32_t phi;
+	uint32_t delta;
+	uint32_t work;  // Nodes spent below the entry, cheaper entries are replaced first
+	uint16_t distance;  // Plies to the end of the game once decided
+	uint16_t unused;
+} DfpnEntry;
+
+
+typedef struct {
+	DfpnEntry* entries;
+	size_t bucket_mask;
+	long long nodes;
+	long long node_limit;  // 0 for no limit
+	bool move_limit;  // Keys include the plies left, as results then depend on them
+	bool checks_only;  // Otherwise the attacker may also play quiet moves
+	bool stopped;
+} MateSolver;
+
+
+typedef enum {
+	MATE_FOUND,
+	NO_MATE,  // Disproved within the move limit
+	MATE_UNKNOWN,  // Node limit reached first
+} MateStatus;
+
+
+typedef struct {
+	MateStatus status;
+	int moves;  // Length of the line in attacker moves
+	Move line[MAX_PLY];
+	int line_length;
+	long long nodes;
+} MateResult;
+
+
+/* FUNCTION DEFINITIONS */
+bool mate_solver_init(MateSolver* solver_ptr, size_t megabytes);
+void mate_solver_free(MateSolver* solver_ptr);
+void mate_solver_clear(MateSolver* solver_ptr);
+void solve_mate(MateSolver* solver_ptr, Board* board_ptr, int max_moves, MateResult* result_ptr);
+void run_mate(int argc, char** argv);
+
+
+#endif  /* MATE_H */
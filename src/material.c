@@ -0,0 +1,195 @@
+#include <stdbool.h>  // for bool
+#include <stdint.h>  // for uint8_t
+#include <stdlib.h>  // for abs
+#include "chess.h"
+#include "board.h"
+#include "evaluate.h"
+#include "material.h"
+
+
+/*
+ * Material signature table. Piece values, the bishop pair and the game
+ * phase only depend on how many pieces of each kind are on the board, as
+ * does whether a specialised evaluator applies, so they are worked out once
+ * per signature and cached per thread under Board.material_key.
+ */
+
+
+// Indexed by [GamePhase]
+const int bishop_pair_bonus[2] = {30, 50};
+
+static _Thread_local MaterialEntry material_table[MATERIAL_TABLE_SIZE];
+
+
+bool lone_king(uint8_t* counts) {
+	return !counts[PAWN] && !counts[KNIGHT] && !counts[BISHOP] && !counts[ROOK] && !counts[QUEEN];
+}
+
+
+bool has_exactly(uint8_t* counts, int pawns, int knights, int bishops, int rooks, int queens) {
+	return (
+		counts[PAWN] == pawns && counts[KNIGHT] == knights && counts[BISHOP] == bishops &&
+		counts[ROOK] == rooks && counts[QUEEN] == queens
+	);
+}
+
+
+/* Picks a specialised evaluator for the side with more material, if any */
+void classify_endgame(uint8_t counts[2][6], MaterialEntry* entry_ptr) {
+	entry_ptr->endgame = ENDGAME_GENERAL;
+	entry_ptr->strong_colour = WHITE;
+	for (Colour strong = WHITE; strong <= BLACK; strong++) {
+		uint8_t* strong_counts = counts[strong];
+		uint8_t* weak_counts = counts[get_opponent_colour(strong)];
+		if (lone_king(weak_counts)) {
+			int minors = strong_counts[KNIGHT] + strong_counts[BISHOP];
+			bool no_majors = !strong_counts[PAWN] && !strong_counts[ROOK] && !strong_counts[QUEEN];
+			if (no_majors && (minors <= 1 || has_exactly(strong_counts, 0, 2, 0, 0, 0))) {
+				entry_ptr->endgame = ENDGAME_DRAW;
+				return;
+			}
+			if (has_exactly(strong_counts, 0, 1, 1, 0, 0)) {
+				entry_ptr->endgame = ENDGAME_KBNK;
+				entry_ptr->strong_colour = strong;
+				return;
+			}
+		}
+		if (has_exactly(strong_counts, 0, 0, 0, 1, 0) && has_exactly(weak_counts, 1, 0, 0, 0, 0)) {
+			entry_ptr->endgame = ENDGAME_KRKP;
+			entry_ptr->strong_colour = strong;
+			return;
+		}
+	}
+}
+
+
+void fill_material_entry(uint8_t counts[2][6], MaterialEntry* entry_ptr) {
+	int material[2] = {0};
+	int phase = 0;
+	for (Colour colour = WHITE; colour <= BLACK; colour++) {
+		int sign = colour == WHITE ? 1 : -1;
+		for (PieceType type = PAWN; type < KING; type++) {
+			material[MIDGAME] += sign * counts[colour][type] * piece_value[MIDGAME][type];
+			material[ENDGAME] += sign * counts[colour][type] * piece_value[ENDGAME][type];
+			phase += counts[colour][type] * phase_weight[type];
+		}
+		if (counts[colour][BISHOP] >= 2) {
+			material[MIDGAME] += sign * bishop_pair_bonus[MIDGAME];
+			material[ENDGAME] += sign * bishop_pair_bonus[ENDGAME];
+		}
+	}
+
+	entry_ptr->material[MIDGAME] = material[MIDGAME];
+	entry_ptr->material[ENDGAME] = material[ENDGAME];
+	// Promotions can push the phase past its starting value
+	entry_ptr->phase = phase > MAX_PHASE ? MAX_PHASE : phase;
+	entry_ptr->opposite_bishops = has_exactly(counts[WHITE], counts[WHITE][PAWN], 0, 1, 0, 0) && has_exactly(counts[BLACK], counts[BLACK][PAWN], 0, 1, 0, 0);
+	classify_endgame(counts, entry_ptr);
+}
+
+
+MaterialEntry* probe_material(Board* board_ptr) {
+	MaterialEntry* entry_ptr = &material_table[board_ptr->material_key & (MATERIAL_TABLE_SIZE - 1)];
+	if (entry_ptr->key != board_ptr->material_key) {
+		fill_material_entry(board_ptr->piece_counts, entry_ptr);
+		entry_ptr->key = board_ptr->material_key;
+	}
+	return entry_ptr;
+}
+
+
+/* Square of the first alive piece of the type, for pieces known to exist */
+Square find_piece(Board* board_ptr, Colour colour, PieceType type) {
+	for (int i = 0; i < 16; i++) {
+		Piece* piece_ptr = &board_ptr->player_pieces[colour][i];
+		if (piece_ptr->alive && piece_ptr->type == type) {
+			return piece_ptr->square;
+		}
+	}
+	return NONE;
+}
+
+
+bool dark_square(Square square) {
+	return (index_to_file(square) + index_to_rank(square)) % 2 == 0;
+}
+
+
+/* King moves between two squares on an empty board */
+int square_distance(Square a, Square b) {
+	int files = abs(index_to_file(a) - index_to_file(b));
+	int ranks = abs(index_to_rank(a) - index_to_rank(b));
+	return files > ranks ? files : ranks;
+}
+
+
+int manhattan_distance(Square a, Square b) {
+	return abs(index_to_file(a) - index_to_file(b)) + abs(index_to_rank(a) - index_to_rank(b));
+}
+
+
+bool opposite_coloured_bishops(Board* board_ptr) {
+	return dark_square(find_piece(board_ptr, WHITE, BISHOP)) != dark_square(find_piece(board_ptr, BLACK, BISHOP));
+}
+
+
+/* Mate can only be forced in a corner the bishop covers, so the weak king is
+   driven towards the nearer of those two and the strong king follows it */
+int evaluate_kbnk(Board* board_ptr, Colour strong) {
+	Square strong_king = find_piece(board_ptr, strong, KING);
+	Square weak_king = find_piece(board_ptr, get_opponent_colour(strong), KING);
+	bool dark = dark_square(find_piece(board_ptr, strong, BISHOP));
+
+	int first_corner = manhattan_distance(weak_king, dark ? A1 : A8);
+	int second_corner = manhattan_distance(weak_king, dark ? H8 : H1);
+	int corner_distance = first_corner < second_corner ? first_corner : second_corner;
+	return KNOWN_WIN + 20 * (14 - corner_distance) + 10 * (7 - square_distance(strong_king, weak_king));
+}
+
+
+/* Rook against pawn is won when the strong king stops the pawn or the weak
+   king is too far away to help it, and drawn when the pawn is far advanced
+   with its king beside it. Squares are mirrored so the rook side plays up
+   the board and the pawn runs towards the first rank */
+int evaluate_krkp(Board* board_ptr, Colour strong) {
+	Colour weak = get_opponent_colour(strong);
+	int mirror = strong == WHITE ? 0 : 56;
+	Square strong_king = find_piece(board_ptr, strong, KING) ^ mirror;
+	Square weak_king = find_piece(board_ptr, weak, KING) ^ mirror;
+	Square rook = find_piece(board_ptr, strong, ROOK) ^ mirror;
+	Square pawn = find_piece(board_ptr, weak, PAWN) ^ mirror;
+	Square queening = index_to_file(pawn);
+	int rook_value = piece_value[ENDGAME][ROOK];
+
+	bool strong_in_front = index_to_file(strong_king) == index_to_file(pawn) && strong_king < pawn;
+	int weak_tempo = board_ptr->current_turn == weak ? 1 : 0;
+	if (strong_in_front) {
+		return rook_value - square_distance(strong_king, pawn);
+	}
+	if (square_distance(weak_king, pawn) >= 3 + weak_tempo && square_distance(weak_king, rook) >= 3) {
+		return rook_value - square_distance(strong_king, pawn);
+	}
+	if (
+		index_to_rank(weak_king) <= 2 && square_distance(weak_king, pawn) == 1 &&
+		index_to_rank(strong_king) >= 3 && square_distance(strong_king, pawn) > 3 - weak_tempo
+	) {
+		return 80 - 8 * square_distance(strong_king, pawn);
+	}
+	Square stop = pawn - 8;
+	return 200 - 8 * (square_distance(strong_king, stop) - square_distance(weak_king, stop) - square_distance(pawn, queening));
+}
+
+
+/* Score of a position with a specialised evaluator, from the point of view
+   of the side to move */
+int evaluate_endgame(Board* board_ptr, MaterialEntry* material_ptr) {
+	Colour strong = material_ptr->strong_colour;
+	int score = 0;
+	if (material_ptr->endgame == ENDGAME_KBNK) {
+		score = evaluate_kbnk(board_ptr, strong);
+	}
+	else if (material_ptr->endgame == ENDGAME_KRKP) {
+		score = evaluate_krkp(board_ptr, strong);
+	}
+	return board_ptr->current_turn == strong ? score : -score;
+}
@@ -0,0 +1,44 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+
+#include <stdbool.h>  // for bool
+#include <stdint.h>  // for int16_t, uint8_t and uint64_t
+#include "chess.h"
+
+
+#define MATERIAL_TABLE_SIZE 8192  // Entries per thread, a power of two
+#define SCALE_NORMAL 64  // Endgame scores are scaled by scale / SCALE_NORMAL
+#define OPPOSITE_BISHOPS_SCALE 32
+#define KNOWN_WIN 2000  // Above any ordinary evaluation, well below mate scores
+
+
+/* Endgames with an evaluator of their own, chosen by the material signature */
+typedef enum {
+	ENDGAME_GENERAL,  // Ordinary evaluation
+	ENDGAME_DRAW,  // Lone king against at most a minor piece or two knights
+	ENDGAME_KBNK,
+	ENDGAME_KRKP,
+} EndgameType;
+
+
+/* Everything that depends only on which pieces are on the board. Entries are
+   keyed on Board.material_key, so one entry serves every position with the
+   same signature */
+typedef struct {
+	uint64_t key;
+	int16_t material[2];  // Piece values and imbalance by [GamePhase], from WHITE's point of view
+	uint8_t phase;
+	uint8_t endgame;  // EndgameType
+	uint8_t strong_colour;  // Side with the extra material in a specialised endgame
+	bool opposite_bishops;  // One bishop each and only pawns besides, scaled if they differ in colour
+} MaterialEntry;
+
+
+/* FUNCTION DEFINITIONS */
+MaterialEntry* probe_material(Board* board_ptr);
+bool opposite_coloured_bishops(Board* board_ptr);
+int evaluate_endgame(Board* board_ptr, MaterialEntry* material_ptr);
+
+
+#endif  /* MATERIAL_H */
@@ -0,0 +1,543 @@
+#include <math.h>  // for exp, log10, pow and sqrt
+#include <pthread.h>  // for pthread_create and pthread_join
+#include <stdbool.h>  // for bool
+#include <stdio.h>  // for printf and fflush
+#include <stdlib.h>  // for atoi, atoll, calloc, malloc and free
+#include <string.h>  // for strcmp
+#include <sys/mman.h>  // for munmap
+#include "chess.h"
+#include "board.h"
+#include "evaluate.h"
+#include "interface.h"
+#include "mcts.h"
+#include "move_generation.h"
+#include "search.h"
+#include "timeman.h"
+#include "tt.h"
+
+
+/*
+ * Monte-Carlo tree search with PUCT selection. Threads share one tree and
+ * run playouts from the root at the same time. A thread going down a node
+ * counts its visit straight away, before its result is known, so until the
+ * result is backed up the node looks like a loss (a virtual loss) and other
+ * threads are steered towards other lines.
+ *
+ * Nodes come from one arena that is only ever bumped, by an atomic add per
+ * expansion, and is reset rather than freed. When the next search starts
+ * from a position one or two plies below the last root, the tree under it
+ * is kept, and the arena is only emptied once it runs out of room.
+ */
+
+
+#define VALUE_SCALE 65536.0  // Fixed point scale of MctsNode.value_sum
+#define DEFAULT_EXPLORATION 1.5
+#define FIRST_PLAY_REDUCTION 0.2  // Unvisited children are assumed this much worse than their parent
+#define PRIOR_TEMPERATURE 100.0  // Centipawns, for the softmax over move scores
+#define PLAYOUT_PLIES 60
+#define TIME_CHECK_PLAYOUTS 64
+#define DEFAULT_MCTS_MB 256
+#define DEFAULT_MCTS_PLAYOUTS 100000
+#define REUSE_FILL_LIMIT 0.75  // Start from an empty arena above this fill
+
+
+bool mcts_init(Mcts* mcts_ptr, size_t megabytes, int threads) {
+	bool huge_pages;
+	size_t capacity = megabytes * 1024 * 1024 / sizeof(MctsNode);
+	if (capacity > UINT32_MAX) {
+		capacity = UINT32_MAX;
+	}
+	mcts_ptr->bytes = capacity * sizeof(MctsNode);
+	// Untouched pages of the mapping cost nothing until the tree grows into them
+	mcts_ptr->nodes = allocate_tt_memory(mcts_ptr->bytes, &huge_pages);
+	mcts_ptr->capacity = capacity;
+	mcts_ptr->threads = threads < 1 ? 1 : (threads > MAX_MCTS_THREADS ? MAX_MCTS_THREADS : threads);
+	mcts_ptr->leaf_value = LEAF_EVALUATION;
+	mcts_ptr->exploration = DEFAULT_EXPLORATION;
+	mcts_ptr->verbose = false;
+	mcts_clear(mcts_ptr);
+	return mcts_ptr->nodes != 0;
+}
+
+
+void mcts_free(Mcts* mcts_ptr) {
+	if (mcts_ptr->nodes) {
+		munmap(mcts_ptr->nodes, mcts_ptr->bytes);
+	}
+	mcts_ptr->nodes = 0;
+}
+
+
+/* Forgets the tree, the next search starts from an empty arena */
+void mcts_clear(Mcts* mcts_ptr) {
+	mcts_ptr->has_tree = false;
+	mcts_ptr->next = 1;
+	mcts_ptr->root = 0;
+}
+
+
+/* Expected score for the side that played into the node */
+double node_value(MctsNode* node_ptr, double unvisited) {
+	int visits = __atomic_load_n(&node_ptr->visits, __ATOMIC_RELAXED);
+	if (visits == 0) {
+		return unvisited;
+	}
+	return __atomic_load_n(&node_ptr->value_sum, __ATOMIC_RELAXED) / VALUE_SCALE / visits;
+}
+
+
+/* PUCT: value plus an exploration bonus that shrinks as the child is
+   visited, scaled by the prior of the move */
+uint32_t select_child(Mcts* mcts_ptr, MctsNode* node_ptr) {
+	int parent_visits = __atomic_load_n(&node_ptr->visits, __ATOMIC_RELAXED);
+	double first_play = 1.0 - node_value(node_ptr, 0.5) - FIRST_PLAY_REDUCTION;
+	double exploration = mcts_ptr->exploration * sqrt(parent_visits > 1 ? parent_visits : 1);
+
+	uint32_t best = node_ptr->first_child;
+	double best_score = -1e9;
+	for (uint32_t i = node_ptr->first_child; i < node_ptr->first_child + node_ptr->child_count; i++) {
+		MctsNode* child_ptr = &mcts_ptr->nodes[i];
+		int visits = __atomic_load_n(&child_ptr->visits, __ATOMIC_RELAXED);
+		double score = node_value(child_ptr, first_play) + exploration * child_ptr->prior / (1 + visits);
+		if (score > best_score) {
+			best_score = score;
+			best = i;
+		}
+	}
+	return best;
+}
+
+
+/* Cheap move score for the priors: material won plus piece-square gain */
+double move_prior_score(Board* board_ptr, Move* move_ptr) {
+	Piece* piece_ptr = board_ptr->squares[move_ptr->from];
+	int flip = piece_ptr->colour == WHITE ? 56 : 0;
+	const int* table = piece_square_table[MIDGAME][piece_ptr->type];
+	double score = table[move_ptr->to ^ flip] - table[move_ptr->from ^ flip];
+
+	Piece* captured_ptr = board_ptr->squares[move_ptr->to];
+	if (captured_ptr) {
+		score += piece_value[MIDGAME][captured_ptr->type] - piece_value[MIDGAME][piece_ptr->type] / 10;
+	}
+	else if (move_ptr->type == EN_PASSANT) {
+		score += piece_value[MIDGAME][PAWN];
+	}
+	PieceType promotion = promotion_piece(move_ptr->type);
+	if (promotion != PAWN) {
+		score += piece_value[MIDGAME][promotion] - piece_value[MIDGAME][PAWN];
+	}
+	return score;
+}
+
+
+/* Adds a child per legal move, with softmax priors. Returns false if the
+   arena has no room left for them */
+bool expand_node(Mcts* mcts_ptr, MctsNode* node_ptr, Board* board_ptr) {
+	MoveList* move_list_ptr = push_move_list();
+	generate_moves(move_list_ptr, board_ptr, GEN_ALL);
+	find_legal_moves(move_list_ptr, board_ptr);
+	int count = move_list_ptr->move_count;
+
+	uint32_t first = 0;
+	if (count > 0) {
+		first = __atomic_fetch_add(&mcts_ptr->next, count, __ATOMIC_RELAXED);
+		if ((size_t)first + count > mcts_ptr->capacity) {
+			__atomic_store_n(&mcts_ptr->arena_full, true, __ATOMIC_RELAXED);
+			pop_move_list();
+			return false;
+		}
+
+		double scores[MAX_MOVES];
+		double best_score = -1e9, total = 0;
+		for (int i = 0; i < count; i++) {
+			scores[i] = move_prior_score(board_ptr, &move_list_ptr->moves[i]);
+			best_score = scores[i] > best_score ? scores[i] : best_score;
+		}
+		for (int i = 0; i < count; i++) {
+			scores[i] = exp((scores[i] - best_score) / PRIOR_TEMPERATURE);
+			total += scores[i];
+		}
+		for (int i = 0; i < count; i++) {
+			mcts_ptr->nodes[first + i] = (MctsNode){
+				0, 0, 0, scores[i] / total, 0, pack_move(&move_list_ptr->moves[i]), NODE_UNEXPANDED
+			};
+		}
+	}
+	pop_move_list();
+
+	node_ptr->first_child = first;
+	node_ptr->child_count = count;
+	// Publishes the children to threads that read the state with acquire
+	__atomic_store_n(&node_ptr->state, NODE_EXPANDED, __ATOMIC_RELEASE);
+	return true;
+}
+
+
+typedef struct {
+	Mcts* mcts_ptr;
+	int id;
+	Board* board_ptr;
+	SearchInfo* info_ptr;  // For quiescence
+	uint64_t random_state;
+} MctsThread;
+
+
+uint64_t next_random(MctsThread* thread_ptr) {
+	// xorshift64
+	thread_ptr->random_state ^= thread_ptr->random_state << 13;
+	thread_ptr->random_state ^= thread_ptr->random_state >> 7;
+	thread_ptr->random_state ^= thread_ptr->random_state << 17;
+	return thread_ptr->random_state;
+}
+
+
+double score_to_value(int score) {
+	return 1.0 / (1.0 + pow(10.0, -score / 400.0));
+}
+
+
+bool is_rule_draw(Board* board_ptr) {
+	return is_repetition(board_ptr) || is_fifty_move_draw(board_ptr) || is_insufficient_material(board_ptr);
+}
+
+
+/* Random legal moves until the game ends or PLAYOUT_PLIES have been played,
+   then a static evaluation. Returns the value for the side to move at the start */
+double random_playout(MctsThread* thread_ptr, Board* board_ptr) {
+	Move moves[PLAYOUT_PLIES];
+	MoveUndo undos[PLAYOUT_PLIES];
+	int plies = 0;
+	double value = -1;  // For the side to move at the end, -1 until known
+
+	while (value < 0) {
+		if (is_rule_draw(board_ptr)) {
+			value = 0.5;
+			break;
+		}
+		if (plies == PLAYOUT_PLIES) {
+			value = score_to_value(evaluate(board_ptr));
+			break;
+		}
+		MoveList* move_list_ptr = push_move_list();
+		generate_moves(move_list_ptr, board_ptr, GEN_ALL);
+		find_legal_moves(move_list_ptr, board_ptr);
+		if (move_list_ptr->move_count == 0) {
+			value = king_in_check(board_ptr, board_ptr->current_turn) ? 0.0 : 0.5;
+		}
+		else {
+			moves[plies] = move_list_ptr->moves[next_random(thread_ptr) % move_list_ptr->move_count];
+			play_move(&moves[plies], board_ptr, &undos[plies]);
+			plies++;
+		}
+		pop_move_list();
+	}
+
+	for (int i = plies - 1; i >= 0; i--) {
+		unplay_move(&moves[i], board_ptr, &undos[i]);
+	}
+	return plies % 2 == 0 ? value : 1.0 - value;
+}
+
+
+/* Value of a leaf for its side to move, 0 to 1 */
+double leaf_value(MctsThread* thread_ptr, Board* board_ptr) {
+	if (thread_ptr->mcts_ptr->leaf_value == LEAF_PLAYOUT) {
+		return random_playout(thread_ptr, board_ptr);
+	}
+	thread_ptr->info_ptr->nodes = 0;
+	return score_to_value(quiescence(board_ptr, thread_ptr->info_ptr, -INFINITE_SCORE, INFINITE_SCORE, 0));
+}
+
+
+/* One playout: select down to a leaf, expand it, value it and back the
+   value up the path */
+void run_playout(MctsThread* thread_ptr) {
+	Mcts* mcts_ptr = thread_ptr->mcts_ptr;
+	Board* board_ptr = thread_ptr->board_ptr;
+	uint32_t path[MAX_PLY];
+	Move moves[MAX_PLY];
+	MoveUndo undos[MAX_PLY];
+	int depth = 0;
+	double value;  // For the side to move at path[depth]
+
+	path[0] = mcts_ptr->root;
+	__atomic_fetch_add(&mcts_ptr->nodes[path[0]].visits, 1, __ATOMIC_RELAXED);
+	while (true) {
+		MctsNode* node_ptr = &mcts_ptr->nodes[path[depth]];
+		uint8_t state = __atomic_load_n(&node_ptr->state, __ATOMIC_ACQUIRE);
+		if (depth > 0 && is_rule_draw(board_ptr)) {
+			value = 0.5;
+			break;
+		}
+
+		if (state == NODE_UNEXPANDED) {
+			uint8_t expected = NODE_UNEXPANDED;
+			if (__atomic_compare_exchange_n(&node_ptr->state, &expected, NODE_EXPANDING, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+				if (expand_node(mcts_ptr, node_ptr, board_ptr)) {
+					state = NODE_EXPANDED;
+				}
+				else {
+					__atomic_store_n(&node_ptr->state, NODE_UNEXPANDED, __ATOMIC_RELEASE);
+				}
+			}
+			// Children are looked at on the next visit, this one values the leaf
+			if (state != NODE_EXPANDED || node_ptr->child_count > 0) {
+				value = leaf_value(thread_ptr, board_ptr);
+				break;
+			}
+		}
+		if (state != NODE_EXPANDED) {
+			// Another thread is expanding it
+			value = leaf_value(thread_ptr, board_ptr);
+			break;
+		}
+		if (node_ptr->child_count == 0) {
+			value = king_in_check(board_ptr, board_ptr->current_turn) ? 0.0 : 0.5;
+			break;
+		}
+		if (depth == MAX_PLY - 1) {
+			value = leaf_value(thread_ptr, board_ptr);
+			break;
+		}
+
+		// The visit is counted before the result is known: the virtual loss
+		uint32_t child = select_child(mcts_ptr, node_ptr);
+		__atomic_fetch_add(&mcts_ptr->nodes[child].visits, 1, __ATOMIC_RELAXED);
+		moves[depth] = unpack_move(mcts_ptr->nodes[child].move);
+		play_move(&moves[depth], board_ptr, &undos[depth]);
+		path[++depth] = child;
+	}
+
+	// Each node holds values for the side that played into it
+	for (int i = depth; i >= 0; i--) {
+		value = 1.0 - value;
+		__atomic_fetch_add(&mcts_ptr->nodes[path[i]].value_sum, (int64_t)(value * VALUE_SCALE), __ATOMIC_RELAXED);
+	}
+	for (int i = depth - 1; i >= 0; i--) {
+		unplay_move(&moves[i], board_ptr, &undos[i]);
+	}
+}
+
+
+void* mcts_worker(void* arg) {
+	MctsThread* thread_ptr = arg;
+	Mcts* mcts_ptr = thread_ptr->mcts_ptr;
+	long long own_playouts = 0;
+	while (!__atomic_load_n(&mcts_ptr->stop, __ATOMIC_RELAXED)) {
+		run_playout(thread_ptr);
+		own_playouts++;
+		long long playouts = __atomic_add_fetch(&mcts_ptr->playouts, 1, __ATOMIC_RELAXED);
+
+		bool stop = __atomic_load_n(&mcts_ptr->arena_full, __ATOMIC_RELAXED);
+		if (mcts_ptr->limits.nodes && playouts >= mcts_ptr->limits.nodes) {
+			stop = true;
+		}
+		// One thread watches the clock. Without iterations to end, the soft
+		// limit is the budget
+		TimeManager* manager_ptr = &mcts_ptr->time_manager;
+		if (thread_ptr->id == 0 && own_playouts % TIME_CHECK_PLAYOUTS == 0 && manager_ptr->active) {
+			stop |= elapsed_time_ms(manager_ptr) >= manager_ptr->soft_limit;
+		}
+		if (stop) {
+			__atomic_store_n(&mcts_ptr->stop, true, __ATOMIC_RELAXED);
+		}
+	}
+	return 0;
+}
+
+
+/* Looks for the position among the root's children and grandchildren */
+uint32_t find_reusable_root(Mcts* mcts_ptr, Board* board_ptr) {
+	Board* old_ptr = &mcts_ptr->root_board;
+	MctsNode* root_ptr = &mcts_ptr->nodes[mcts_ptr->root];
+	if (old_ptr->hash == board_ptr->hash) {
+		return mcts_ptr->root;
+	}
+	if (root_ptr->state != NODE_EXPANDED) {
+		return 0;
+	}
+	uint32_t found = 0;
+	for (uint32_t i = root_ptr->first_child; i < root_ptr->first_child + root_ptr->child_count && !found; i++) {
+		MoveUndo undo;
+		Move move = unpack_move(mcts_ptr->nodes[i].move);
+		play_move(&move, old_ptr, &undo);
+		if (old_ptr->hash == board_ptr->hash) {
+			found = i;
+		}
+		MctsNode* child_ptr = &mcts_ptr->nodes[i];
+		for (uint32_t j = child_ptr->first_child; j < child_ptr->first_child + child_ptr->child_count && !found; j++) {
+			MoveUndo reply_undo;
+			Move reply = unpack_move(mcts_ptr->nodes[j].move);
+			play_move(&reply, old_ptr, &reply_undo);
+			if (old_ptr->hash == board_ptr->hash) {
+				found = j;
+			}
+			unplay_move(&reply, old_ptr, &reply_undo);
+		}
+		unplay_move(&move, old_ptr, &undo);
+	}
+	return found;
+}
+
+
+/* Most visited child of a node, 0 if it has none */
+uint32_t most_visited_child(Mcts* mcts_ptr, MctsNode* node_ptr) {
+	uint32_t best = 0;
+	if (node_ptr->state != NODE_EXPANDED) {
+		return 0;
+	}
+	for (uint32_t i = node_ptr->first_child; i < node_ptr->first_child + node_ptr->child_count; i++) {
+		if (!best || mcts_ptr->nodes[i].visits > mcts_ptr->nodes[best].visits) {
+			best = i;
+		}
+	}
+	return best;
+}
+
+
+void print_mcts_info(Mcts* mcts_ptr, MctsResult* result_ptr, long long time_elapsed) {
+	double value = result_ptr->value;
+	value = value < 0.001 ? 0.001 : (value > 0.999 ? 0.999 : value);
+	int score = (int)(400 * log10(value / (1 - value)));
+	printf(
+		"info nodes %lld nps %lld time %lld score cp %d string tree %d reused %d pv",
+		result_ptr->playouts, time_elapsed > 0 ? result_ptr->playouts * 1000 / time_elapsed : 0,
+		time_elapsed, score, result_ptr->tree_nodes, result_ptr->reused_visits
+	);
+	uint32_t node = most_visited_child(mcts_ptr, &mcts_ptr->nodes[mcts_ptr->root]);
+	for (int i = 0; node && i < MAX_PLY; i++) {
+		char move_string[6];
+		Move move = unpack_move(mcts_ptr->nodes[node].move);
+		move_to_string(&move, move_string);
+		printf(" %s", move_string);
+		node = most_visited_child(mcts_ptr, &mcts_ptr->nodes[node]);
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+
+void mcts_search(Mcts* mcts_ptr, Board* board_ptr, SearchLimits* limits_ptr, MctsResult* result_ptr) {
+	long long start_time = current_time_ms();
+	Colour us = board_ptr->current_turn;
+	mcts_ptr->limits = *limits_ptr;
+	if (!limits_ptr->nodes && !limits_ptr->move_time && !limits_ptr->time[us]) {
+		mcts_ptr->limits.nodes = DEFAULT_MCTS_PLAYOUTS;
+	}
+	init_time_manager(
+		&mcts_ptr->time_manager, limits_ptr->time[us], limits_ptr->increment[us],
+		limits_ptr->moves_to_go, limits_ptr->move_time
+	);
+
+	// Keep the subtree of the new position if there is one and room to grow it
+	uint32_t root = 0;
+	if (mcts_ptr->has_tree && mcts_ptr->next < mcts_ptr->capacity * REUSE_FILL_LIMIT) {
+		root = find_reusable_root(mcts_ptr, board_ptr);
+	}
+	result_ptr->reused = root != 0;
+	result_ptr->reused_visits = root ? mcts_ptr->nodes[root].visits : 0;
+	if (!root) {
+		mcts_ptr->next = 1;
+		root = mcts_ptr->next++;
+		mcts_ptr->nodes[root] = (MctsNode){0, 0, 0, 1.0f, 0, 0, NODE_UNEXPANDED};
+	}
+	mcts_ptr->root = root;
+	copy_board(&mcts_ptr->root_board, board_ptr);
+	mcts_ptr->has_tree = true;
+	mcts_ptr->playouts = 0;
+	mcts_ptr->stop = false;
+	mcts_ptr->arena_full = false;
+
+	MctsThread threads[MAX_MCTS_THREADS];
+	pthread_t handles[MAX_MCTS_THREADS];
+	int started = 0;
+	for (int i = 0; i < mcts_ptr->threads; i++) {
+		threads[i] = (MctsThread){mcts_ptr, i, malloc(sizeof(Board)), calloc(1, sizeof(SearchInfo)), 0x9E3779B97F4A7C15ULL * (i + 1)};
+		if (!threads[i].board_ptr || !threads[i].info_ptr) {
+			free(threads[i].board_ptr);
+			free(threads[i].info_ptr);
+			break;
+		}
+		copy_board(threads[i].board_ptr, board_ptr);
+		threads[i].info_ptr->options = default_search_options;
+		pthread_create(&handles[i], 0, mcts_worker, &threads[i]);
+		started++;
+	}
+	for (int i = 0; i < started; i++) {
+		pthread_join(handles[i], 0);
+		free(threads[i].board_ptr);
+		free(threads[i].info_ptr);
+	}
+
+	MctsNode* root_ptr = &mcts_ptr->nodes[root];
+	uint32_t best = most_visited_child(mcts_ptr, root_ptr);
+	result_ptr->best_move = best ? unpack_move(mcts_ptr->nodes[best].move) : (Move){NONE, NONE, QUIET_MOVE};
+	result_ptr->value = best ? node_value(&mcts_ptr->nodes[best], 0.5) : 0.5;
+	result_ptr->playouts = mcts_ptr->playouts;
+	result_ptr->tree_nodes = (mcts_ptr->next < mcts_ptr->capacity ? mcts_ptr->next : mcts_ptr->capacity) - 1;
+	if (mcts_ptr->verbose) {
+		print_mcts_info(mcts_ptr, result_ptr, current_time_ms() - start_time);
+	}
+}
+
+
+/* Usage: mcts [<fen> | startpos] [playouts N] [movetime ms] [threads N]
+   [hash MB] [playout] [moves N]. With moves the engine plays that many
+   moves against itself, and each search goes on from the tree left by the
+   one before */
+void run_mcts(int argc, char** argv) {
+	char* fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+	int first_option = 0;
+	if (argc > 0 && strcmp(argv[0], "startpos") == 0) {
+		first_option = 1;
+	}
+	else if (argc > 0 && validate_fen(argv[0])) {
+		fen = argv[0];
+		first_option = 1;
+	}
+
+	SearchLimits limits = {};
+	int threads = 1;
+	long long hash_mb = DEFAULT_MCTS_MB;
+	LeafValue leaf = LEAF_EVALUATION;
+	int moves = 1;
+	for (int i = first_option; i < argc; i++) {
+		char* value = i + 1 < argc ? argv[i + 1] : "0";
+		if (strcmp(argv[i], "playouts") == 0) { limits.nodes = atoll(value); i++; }
+		else if (strcmp(argv[i], "movetime") == 0) { limits.move_time = atoi(value); i++; }
+		else if (strcmp(argv[i], "threads") == 0) { threads = atoi(value); i++; }
+		else if (strcmp(argv[i], "hash") == 0) { hash_mb = atoll(value); i++; }
+		else if (strcmp(argv[i], "playout") == 0) { leaf = LEAF_PLAYOUT; }
+		else if (strcmp(argv[i], "moves") == 0) { moves = atoi(value); i++; }
+		else { printf("Unknown mcts argument: %s\n", argv[i]); return; }
+	}
+
+	static Mcts mcts;
+	if (!mcts_init(&mcts, hash_mb > 0 ? hash_mb : 1, threads)) {
+		printf("Could not allocate %lld MB\n", hash_mb);
+		return;
+	}
+	mcts.leaf_value = leaf;
+	mcts.verbose = true;
+	static Board board;
+	setup_board(&board, fen);
+
+	for (int i = 0; i < moves; i++) {
+		MctsResult result;
+		mcts_search(&mcts, &board, &limits, &result);
+		if (result.best_move.from == NONE) {
+			printf("bestmove none\n");
+			break;
+		}
+		char move_string[6];
+		move_to_string(&result.best_move, move_string);
+		printf("bestmove %s\n", move_string);
+
+		MoveUndo undo;
+		play_move(&result.best_move, &board, &undo);
+		if (is_rule_draw(&board)) {
+			break;
+		}
+	}
+	mcts_free(&mcts);
+}
@@ -0,0 +1,83 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+
+#include <stdbool.h>  // for bool
+#include <stddef.h>  // for size_t
+#include <stdint.h>  // for int32_t, int64_t, uint16_t and uint32_t
+#include "chess.h"
+#include "search.h"
+#include "timeman.h"
+
+
+#define MAX_MCTS_THREADS 256
+
+
+typedef enum {
+	NODE_UNEXPANDED,
+	NODE_EXPANDING,  // One thread is adding the children
+	NODE_EXPANDED,  // Children are in place, none means the game is over
+} NodeState;
+
+
+typedef enum {
+	LEAF_EVALUATION,  // Quiescence search score
+	LEAF_PLAYOUT,  // Result of random moves, scored when the game or playout ends
+} LeafValue;
+
+
+/* Statistics are updated with atomic builtins by every thread at once. The
+   children of a node are consecutive in the arena */
+typedef struct {
+	int64_t value_sum;  // Fixed point, for the side that played move
+	int32_t visits;  // Includes playouts still under way
+	uint32_t first_child;
+	float prior;
+	uint16_t child_count;
+	uint16_t move;  // from | to << 6 | type << 12
+	uint8_t state;  // NodeState
+} MctsNode;
+
+
+typedef struct {
+	MctsNode* nodes;  // Arena, index 0 is unused so it can mean "none"
+	size_t bytes;
+	uint32_t capacity;
+	uint32_t next;  // First free node
+	uint32_t root;
+	Board root_board;  // Position the tree was last searched from
+	bool has_tree;
+
+	int threads;
+	LeafValue leaf_value;
+	double exploration;  // c_puct
+	bool verbose;
+
+	// State of the current search
+	SearchLimits limits;
+	TimeManager time_manager;
+	long long playouts;
+	bool stop;
+	bool arena_full;
+} Mcts;
+
+
+typedef struct {
+	Move best_move;
+	double value;  // Expected score for the side to move, 0 to 1
+	long long playouts;
+	int tree_nodes;  // Arena nodes in use, including any left from earlier searches
+	bool reused;  // Searched on from the tree of an earlier search
+	int reused_visits;  // Visits the root already had when the search started
+} MctsResult;
+
+
+/* FUNCTION DEFINITIONS */
+bool mcts_init(Mcts* mcts_ptr, size_t megabytes, int threads);
+void mcts_free(Mcts* mcts_ptr);
+void mcts_clear(Mcts* mcts_ptr);
+void mcts_search(Mcts* mcts_ptr, Board* board_ptr, SearchLimits* limits_ptr, MctsResult* result_ptr);
+void run_mcts(int argc, char** argv);
+
+
+#endif  /* MCTS_H */
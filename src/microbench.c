@@ -0,0 +1,301 @@
+// gcc -O2 -o microbench microbench.c attacks.c bitboard_batch.c board.c chess.c interface.c move_generation.c zobrist.c -lm
+#include <math.h>  // for sqrt and HUGE_VAL
+#include <stdio.h>  // for printf
+#include <stdlib.h>  // for atoi
+#include <string.h>  // for strcmp and strstr
+#include <time.h>  // for clock_gettime
+#include "chess.h"
+#include "attacks.h"
+#include "bitboard_batch.h"
+#include "board.h"
+#include "move_generation.h"
+#include "zobrist.h"
+
+
+/*
+ * Standalone microbenchmarks for the individual kernels the perft suite and
+ * bench only measure together. Each kernel runs over the same fixed corpus:
+ * first warmed up and calibrated so a sample takes about SAMPLE_NS, then
+ * timed for a number of samples. Usage:
+ *   microbench [name filter] [samples N]
+ */
+
+
+#define DEFAULT_SAMPLES 10
+#define SAMPLE_NS 20000000LL  // 20ms per sample
+#define MAX_SAMPLES 1000
+
+
+char* microbench_positions[] = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+	"r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 8",
+	"2r3k1/pp3ppp/4p3/3p4/3P4/P3P3/1P3PPP/2R3K1 w - - 0 25",
+	"8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 50",
+	"6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 30",
+	"r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/3P1N2/PPP2PPP/RNBQK2R b KQkq - 0 5",
+	"3r2k1/1p3ppp/p1n1b3/4P3/2p5/2N1B3/PP3PPP/3R2K1 b - - 0 22",
+};
+
+#define POSITION_COUNT (int)(sizeof(microbench_positions) / sizeof(microbench_positions[0]))
+
+
+// Corpus prepared once, so each kernel measures only itself
+Board boards[POSITION_COUNT];
+Board* board_ptrs[POSITION_COUNT];
+Move legal_moves[POSITION_COUNT][MAX_MOVES];
+int legal_move_counts[POSITION_COUNT];
+
+// Results are folded in here so the compiler cannot drop the work
+volatile uint64_t sink;
+
+
+/* One pass over the corpus. Returns the number of operations performed */
+typedef long long (*Kernel)();
+
+
+typedef struct {
+	char* name;
+	Kernel kernel;
+} Microbenchmark;
+
+
+long long bench_setup_board() {
+	static Board board;
+	for (int i = 0; i < POSITION_COUNT; i++) {
+		setup_board(&board, microbench_positions[i]);
+		sink += board.hash;
+	}
+	return POSITION_COUNT;
+}
+
+
+long long bench_generate_pseudo_moves() {
+	for (int i = 0; i < POSITION_COUNT; i++) {
+		MoveList* move_list_ptr = push_move_list();
+		generate_pseudo_moves(move_list_ptr, &boards[i]);
+		sink += move_list_ptr->move_count;
+		pop_move_list();
+	}
+	return POSITION_COUNT;
+}
+
+
+/* Generation plus the legality filter, since the filter consumes the list */
+long long bench_find_legal_moves() {
+	for (int i = 0; i < POSITION_COUNT; i++) {
+		MoveList* move_list_ptr = push_move_list();
+		generate_pseudo_moves(move_list_ptr, &boards[i]);
+		find_legal_moves(move_list_ptr, &boards[i]);
+		sink += move_list_ptr->move_count;
+		pop_move_list();
+	}
+	return POSITION_COUNT;
+}
+
+
+/* The same counts as find_legal_moves, a block of positions at a time */
+long long bench_batch_legal_move_counts() {
+	int move_counts[POSITION_COUNT];
+	batch_legal_move_counts(board_ptrs, POSITION_COUNT, move_counts);
+	for (int i = 0; i < POSITION_COUNT; i++) {
+		sink += move_counts[i];
+	}
+	return POSITION_COUNT;
+}
+
+
+/* undo_move leaves the hash and half move clock to unplay_move, so they are
+   restored by hand once per position */
+long long bench_make_undo_move() {
+	long long operations = 0;
+	for (int i = 0; i < POSITION_COUNT; i++) {
+		uint64_t hash = boards[i].hash;
+		int half_moves = boards[i].half_moves;
+		for (int j = 0; j < legal_move_counts[i]; j++) {
+			Piece* captured_piece_ptr = make_move(&legal_moves[i][j], &boards[i]);
+			undo_move(&legal_moves[i][j], &boards[i], captured_piece_ptr);
+		}
+		boards[i].hash = hash;
+		boards[i].half_moves = half_moves;
+		operations += legal_move_counts[i];
+	}
+	return operations;
+}
+
+
+/* make_move plus hashing, castling rights, en passant and history */
+long long bench_play_unplay_move() {
+	long long operations = 0;
+	for (int i = 0; i < POSITION_COUNT; i++) {
+		for (int j = 0; j < legal_move_counts[i]; j++) {
+			MoveUndo undo;
+			play_move(&legal_moves[i][j], &boards[i], &undo);
+			sink += boards[i].hash;
+			unplay_move(&legal_moves[i][j], &boards[i], &undo);
+		}
+		operations += legal_move_counts[i];
+	}
+	return operations;
+}
+
+
+long long bench_attack_map() {
+	for (int i = 0; i < POSITION_COUNT; i++) {
+		AttackMap attacks;
+		compute_attack_map(&boards[i], boards[i].current_turn, &attacks);
+		sink += attacks.all;
+	}
+	return POSITION_COUNT;
+}
+
+
+long long bench_king_in_check() {
+	for (int i = 0; i < POSITION_COUNT; i++) {
+		sink += king_in_check(&boards[i], boards[i].current_turn);
+	}
+	return POSITION_COUNT;
+}
+
+
+long long bench_is_legal_move() {
+	long long operations = 0;
+	for (int i = 0; i < POSITION_COUNT; i++) {
+		for (int j = 0; j < legal_move_counts[i]; j++) {
+			sink += is_legal_move(&legal_moves[i][j], &boards[i]);
+		}
+		operations += legal_move_counts[i];
+	}
+	return operations;
+}
+
+
+long long bench_compute_hash() {
+	for (int i = 0; i < POSITION_COUNT; i++) {
+		sink += compute_hash(&boards[i]);
+	}
+	return POSITION_COUNT;
+}
+
+
+Microbenchmark microbenchmarks[] = {
+	{"setup_board", bench_setup_board},
+	{"generate_pseudo_moves", bench_generate_pseudo_moves},
+	{"find_legal_moves", bench_find_legal_moves},
+	{"batch_legal_move_counts", bench_batch_legal_move_counts},
+	{"make_move+undo_move", bench_make_undo_move},
+	{"play_move+unplay_move", bench_play_unplay_move},
+	{"is_legal_move", bench_is_legal_move},
+	{"compute_attack_map", bench_attack_map},
+	{"king_in_check", bench_king_in_check},
+	{"compute_hash", bench_compute_hash},
+};
+
+
+long long current_time_ns() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+
+void prepare_corpus() {
+	for (int i = 0; i < POSITION_COUNT; i++) {
+		setup_board(&boards[i], microbench_positions[i]);
+		board_ptrs[i] = &boards[i];
+		MoveList* move_list_ptr = push_move_list();
+		generate_pseudo_moves(move_list_ptr, &boards[i]);
+		find_legal_moves(move_list_ptr, &boards[i]);
+		legal_move_counts[i] = move_list_ptr->move_count;
+		for (int j = 0; j < move_list_ptr->move_count; j++) {
+			legal_moves[i][j] = move_list_ptr->moves[j];
+		}
+		pop_move_list();
+	}
+}
+
+
+/* Doubles the passes per sample until one sample takes SAMPLE_NS. This also
+   serves as the warm-up, bringing caches and branch predictors to steady state */
+long long calibrate(Kernel kernel) {
+	long long passes = 1;
+	while (1) {
+		long long start = current_time_ns();
+		for (long long i = 0; i < passes; i++) {
+			kernel();
+		}
+		if (current_time_ns() - start >= SAMPLE_NS) {
+			return passes;
+		}
+		passes *= 2;
+	}
+}
+
+
+void run_microbenchmark(Microbenchmark* microbenchmark_ptr, int samples) {
+	long long passes = calibrate(microbenchmark_ptr->kernel);
+
+	double ns_per_op[MAX_SAMPLES];
+	long long operations = 0;
+	for (int i = 0; i < samples; i++) {
+		operations = 0;
+		long long start = current_time_ns();
+		for (long long j = 0; j < passes; j++) {
+			operations += microbenchmark_ptr->kernel();
+		}
+		ns_per_op[i] = (double)(current_time_ns() - start) / operations;
+	}
+
+	double mean = 0.0;
+	double best = HUGE_VAL;
+	for (int i = 0; i < samples; i++) {
+		mean += ns_per_op[i];
+		best = ns_per_op[i] < best ? ns_per_op[i] : best;
+	}
+	mean /= samples;
+	double variance = 0.0;
+	for (int i = 0; i < samples; i++) {
+		variance += (ns_per_op[i] - mean) * (ns_per_op[i] - mean);
+	}
+	double deviation = samples > 1 ? sqrt(variance / (samples - 1)) : 0.0;
+
+	printf(
+		"%-24s %10.2f %9.2f %6.1f%% %10.2f %12lld\n",
+		microbenchmark_ptr->name, mean, deviation, 100.0 * deviation / mean, best, operations
+	);
+	fflush(stdout);
+}
+
+
+int main(int argc, char** argv) {
+	char* filter = 0;
+	int samples = DEFAULT_SAMPLES;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "samples") == 0 && i + 1 < argc) {
+			samples = atoi(argv[++i]);
+		}
+		else {
+			filter = argv[i];
+		}
+	}
+	if (samples < 1 || samples > MAX_SAMPLES) {
+		printf("samples must be between 1 and %d\n", MAX_SAMPLES);
+		return 1;
+	}
+
+	prepare_corpus();
+	printf("%d positions, %d samples of ~%lldms\n\n", POSITION_COUNT, samples, SAMPLE_NS / 1000000);
+	printf("%-24s %10s %9s %7s %10s %12s\n", "kernel", "ns/op", "stddev", "", "min", "ops/sample");
+
+	int count = sizeof(microbenchmarks) / sizeof(microbenchmarks[0]);
+	for (int i = 0; i < count; i++) {
+		if (!filter || strstr(microbenchmarks[i].name, filter)) {
+			run_microbenchmark(&microbenchmarks[i], samples);
+		}
+	}
+	return 0;
+}
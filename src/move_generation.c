@@ -1,24 +1,84 @@
 #include <stdbool.h>  // for bool
+#include <stdint.h>  // for uint64_t
+#include <stdlib.h>  // for abs
 #include "chess.h"
 #include "board.h"
+#include "attacks.h"
 
 
 // Pawn's needs custom logic for each move
-int knight_moves[8][2] = {{1, 2}, {1, -2}, {-1, 2}, {-1, -2}, {2, 1}, {2, -1}, {-2, -1}, {-2, 1}};
-int king_moves[8][2] = {{0, 1}, {0, -1}, {-1, 0}, {1, 0}, {1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
-int bishop_directions[4][2] = {{1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
-int rook_directions[4][2] = {{0, 1}, {0, -1}, {-1, 0}, {1, 0}};
+const int knight_moves[8][2] = {{1, 2}, {1, -2}, {-1, 2}, {-1, -2}, {2, 1}, {2, -1}, {-2, -1}, {-2, 1}};
+const int king_moves[8][2] = {{0, 1}, {0, -1}, {-1, 0}, {1, 0}, {1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
+const int bishop_directions[4][2] = {{1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
+const int rook_directions[4][2] = {{0, 1}, {0, -1}, {-1, 0}, {1, 0}};
 // Queen's directions are just rook_directions + bishop_directions
 
 
-void set_move(Move* move_ptr, Square from, Square to, MoveType type) {
+/*
+ * Every MoveList is a slice of one contiguous, preallocated stack of moves
+ * per thread. The list for ply N starts right after the moves of ply N-1,
+ * so the working set stays dense in cache and nothing is zero-initialised.
+ * Lists must be popped in the reverse order they were pushed.
+ */
+#define MOVE_STACK_FRAMES (MAX_PLY + 8)  // Headroom for nested legality checks
+
+typedef struct {
+	Move moves[MOVE_STACK_FRAMES * MAX_MOVES];
+	MoveList lists[MOVE_STACK_FRAMES];
+	int list_count;
+} MoveStack;
+
+static _Thread_local MoveStack move_stack;
+
+
+MoveList* push_move_list() {
+	MoveList* move_list_ptr = &move_stack.lists[move_stack.list_count];
+	if (move_stack.list_count == 0) {
+		move_list_ptr->moves = move_stack.moves;
+	}
+	else {
+		// Start where the list below ends, even if it shrank after filtering
+		MoveList* below_ptr = move_list_ptr - 1;
+		move_list_ptr->moves = below_ptr->moves + below_ptr->move_count;
+	}
+	move_list_ptr->move_count = 0;
+	move_stack.list_count++;
+	return move_list_ptr;
+}
+
+
+void pop_move_list() {
+	move_stack.list_count--;
+}
+
+
+/*
+ * The generator and legality filter are written once as ALWAYS_INLINE
+ * templates that take the side to move and the GenType as arguments. Each
+ * (colour, gen_type) pair is instantiated below as its own function with
+ * those arguments as constants, so the colour and move type branches are
+ * resolved at compile time and only one dispatch happens per call.
+ */
+
+
+ALWAYS_INLINE void add_move(MoveList* move_list_ptr, Square from, Square to, MoveType type) {
+	Move* move_ptr = &move_list_ptr->moves[move_list_ptr->move_count++];
 	move_ptr->from = from;
 	move_ptr->to = to;
 	move_ptr->type = type;
 }
 
 
-void get_set_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr, int moves[][2], int moves_len) {
+ALWAYS_INLINE bool on_target(uint64_t targets, Square square, const GenType gen_type) {
+	// Only evasions restrict where non-king pieces may move
+	return gen_type != GEN_EVASIONS || (targets >> square) & 1;
+}
+
+
+ALWAYS_INLINE void get_set_moves(
+	MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr, const int moves[][2], int moves_len,
+	uint64_t targets, const Colour us, const GenType gen_type
+) {
 	int file = index_to_file(piece_ptr->square);
 	int rank = index_to_rank(piece_ptr->square);
 
@@ -32,23 +92,27 @@ void get_set_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr,
 		if (!inside_board(new_file, new_rank)) { continue; }
 
 		target_square = coordinate_to_index(new_file, new_rank);
+		if (!on_target(targets, target_square, gen_type)) { continue; }
 		target_piece_ptr = board_ptr->squares[target_square];
 
 		if (!target_piece_ptr) {
-			Move move = {};
-			set_move(&move, piece_ptr->square, target_square, QUIET_MOVE);
-			move_list_ptr->moves[move_list_ptr->move_count++] = move;
+			if (gen_type != GEN_CAPTURES) {
+				add_move(move_list_ptr, piece_ptr->square, target_square, QUIET_MOVE);
+			}
 		}
-		else if (piece_ptr->colour != target_piece_ptr->colour) {
-			Move move = {};
-			set_move(&move, piece_ptr->square, target_square, CAPTURE);
-			move_list_ptr->moves[move_list_ptr->move_count++] = move;
+		else if (target_piece_ptr->colour != us) {
+			if (gen_type != GEN_QUIETS) {
+				add_move(move_list_ptr, piece_ptr->square, target_square, CAPTURE);
+			}
 		}
 	}
 }
 
 
-void get_sliding_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr, int directions[][2], int directions_len) {
+ALWAYS_INLINE void get_sliding_moves(
+	MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr, const int directions[][2], int directions_len,
+	uint64_t targets, const Colour us, const GenType gen_type
+) {
 	int file = index_to_file(piece_ptr->square);
 	int rank = index_to_rank(piece_ptr->square);
 
@@ -65,9 +129,9 @@ void get_sliding_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_p
 			target_piece_ptr = board_ptr->squares[target_square];
 
 			if (!target_piece_ptr) {
-				Move move = {};
-				set_move(&move, piece_ptr->square, target_square, QUIET_MOVE);
-				move_list_ptr->moves[move_list_ptr->move_count++] = move;
+				if (gen_type != GEN_CAPTURES && on_target(targets, target_square, gen_type)) {
+					add_move(move_list_ptr, piece_ptr->square, target_square, QUIET_MOVE);
+				}
 			}
 			else {
 				break;
@@ -76,53 +140,75 @@ void get_sliding_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_p
 			new_rank += directions[i][1];
 		}
 
+		if (gen_type == GEN_QUIETS) { continue; }
 		if (!inside_board(new_file, new_rank)) { continue; }
 		target_square = coordinate_to_index(new_file, new_rank);
 		target_piece_ptr = board_ptr->squares[target_square];
-		if (target_piece_ptr && piece_ptr->colour != target_piece_ptr->colour) {
-			Move move = {};
-			set_move(&move, piece_ptr->square, target_square, CAPTURE);
-			move_list_ptr->moves[move_list_ptr->move_count++] = move;
+		if (target_piece_ptr && target_piece_ptr->colour != us && on_target(targets, target_square, gen_type)) {
+			add_move(move_list_ptr, piece_ptr->square, target_square, CAPTURE);
 		}
 	}
 }
 
 
-void add_pawn_promotions(MoveList* move_list_ptr, Board* board_ptr, Square from, Square to) {
-	Move move = {};
-	set_move(&move, from, to, PROMOTION_QUEEN);
-	move_list_ptr->moves[move_list_ptr->move_count++] = move;
-	set_move(&move, from, to, PROMOTION_ROOK);
-	move_list_ptr->moves[move_list_ptr->move_count++] = move;
-	set_move(&move, from, to, PROMOTION_BISHOP);
-	move_list_ptr->moves[move_list_ptr->move_count++] = move;
-	set_move(&move, from, to, PROMOTION_KNIGHT);
-	move_list_ptr->moves[move_list_ptr->move_count++] = move;
+ALWAYS_INLINE void add_pawn_promotions(MoveList* move_list_ptr, Square from, Square to) {
+	add_move(move_list_ptr, from, to, PROMOTION_QUEEN);
+	add_move(move_list_ptr, from, to, PROMOTION_ROOK);
+	add_move(move_list_ptr, from, to, PROMOTION_BISHOP);
+	add_move(move_list_ptr, from, to, PROMOTION_KNIGHT);
 }
 
 
-void add_pawn_capture_promotions(MoveList* move_list_ptr, Board* board_ptr, Square from, Square to) {
-	Move move = {};
-	set_move(&move, from, to, CAPTURE_PROMOTION_QUEEN);
-	move_list_ptr->moves[move_list_ptr->move_count++] = move;
-	set_move(&move, from, to, CAPTURE_PROMOTION_ROOK);
-	move_list_ptr->moves[move_list_ptr->move_count++] = move;
-	set_move(&move, from, to, CAPTURE_PROMOTION_BISHOP);
-	move_list_ptr->moves[move_list_ptr->move_count++] = move;
-	set_move(&move, from, to, CAPTURE_PROMOTION_KNIGHT);
-	move_list_ptr->moves[move_list_ptr->move_count++] = move;
+ALWAYS_INLINE void add_pawn_capture_promotions(MoveList* move_list_ptr, Square from, Square to) {
+	add_move(move_list_ptr, from, to, CAPTURE_PROMOTION_QUEEN);
+	add_move(move_list_ptr, from, to, CAPTURE_PROMOTION_ROOK);
+	add_move(move_list_ptr, from, to, CAPTURE_PROMOTION_BISHOP);
+	add_move(move_list_ptr, from, to, CAPTURE_PROMOTION_KNIGHT);
+}
+
+
+ALWAYS_INLINE void get_pawn_capture(
+	MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr, int new_file, int new_rank,
+	uint64_t targets, const Colour us, const GenType gen_type
+) {
+	const int promotion_rank = us == WHITE ? 7 : 0;
+
+	if (!inside_board(new_file, new_rank)) { return; }
+
+	Square target_square = coordinate_to_index(new_file, new_rank);
+	Piece* target_piece_ptr = board_ptr->squares[target_square];
+	if (target_piece_ptr && target_piece_ptr->colour != us) {
+		if (!on_target(targets, target_square, gen_type)) { return; }
+		// Check for pawn capture promotion
+		if (new_rank == promotion_rank) {
+			add_pawn_capture_promotions(move_list_ptr, piece_ptr->square, target_square);
+		}
+		else {
+			add_move(move_list_ptr, piece_ptr->square, target_square, CAPTURE);
+		}
+	}
+	// Check for en passant capture. Always allowed as an evasion since the
+	// captured pawn is not on the target square
+	else if (target_square == board_ptr->en_passant_target) {
+		add_move(move_list_ptr, piece_ptr->square, board_ptr->en_passant_target, EN_PASSANT);
+	}
 }
 
 
-void get_pawn_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr) {
-	int forward = piece_ptr->colour == WHITE ? 1 : -1;
+ALWAYS_INLINE void get_pawn_moves(
+	MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr,
+	uint64_t targets, const Colour us, const GenType gen_type
+) {
+	const int forward = us == WHITE ? 1 : -1;
+	const int starting_rank = us == WHITE ? 1 : 6;
+	const int promotion_rank = us == WHITE ? 7 : 0;
 
 	int file = index_to_file(piece_ptr->square);
 	int rank = index_to_rank(piece_ptr->square);
 
 	int new_file, new_rank;
 
-	// Don't need to check if inside board for pawn moves, only captures. 
+	// Don't need to check if inside board for pawn moves, only captures.
 
 	// Move forward one
 	new_file = file;
@@ -131,328 +217,348 @@ void get_pawn_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr)
 	int target_square = coordinate_to_index(new_file, new_rank);
 	Piece* target_piece_ptr = board_ptr->squares[target_square];
 	if (!target_piece_ptr) {
-		// Check for pawn promotion
-		if (piece_ptr->colour == WHITE && new_rank == 7 || piece_ptr->colour == BLACK && new_rank == 0){
-			add_pawn_promotions(move_list_ptr, board_ptr, piece_ptr->square, target_square);
+		// Check for pawn promotion, which are generated with the captures
+		if (new_rank == promotion_rank) {
+			if (gen_type != GEN_QUIETS && on_target(targets, target_square, gen_type)) {
+				add_pawn_promotions(move_list_ptr, piece_ptr->square, target_square);
+			}
 		}
-		else {
-			Move move = {};
-			set_move(&move, piece_ptr->square, target_square, QUIET_MOVE);
-			move_list_ptr->moves[move_list_ptr->move_count++] = move;
-			
-			// Check for double pawn push
-			bool on_starting_square = false;
-			if (piece_ptr->colour == WHITE && rank == 1 || piece_ptr->colour == BLACK && rank == 6) {
-				on_starting_square = true;
+		else if (gen_type != GEN_CAPTURES) {
+			if (on_target(targets, target_square, gen_type)) {
+				add_move(move_list_ptr, piece_ptr->square, target_square, QUIET_MOVE);
 			}
-			if (on_starting_square) {
+
+			// Check for double pawn push
+			if (rank == starting_rank) {
 				new_rank += forward;
 				target_square = coordinate_to_index(new_file, new_rank);
 				target_piece_ptr = board_ptr->squares[target_square];
-				if (!target_piece_ptr) {
-					Move move = {};
-					set_move(&move, piece_ptr->square, target_square, DOUBLE_PAWN_PUSH);
-					move_list_ptr->moves[move_list_ptr->move_count++] = move;
+				if (!target_piece_ptr && on_target(targets, target_square, gen_type)) {
+					add_move(move_list_ptr, piece_ptr->square, target_square, DOUBLE_PAWN_PUSH);
 				}
 			}
 		}
 	}
 
 	// Captures
+	if (gen_type == GEN_QUIETS) { return; }
 	new_rank = rank + forward;
-
-	new_file = file + 1;
-	if (inside_board(new_file, new_rank)) {
-		target_square = coordinate_to_index(new_file, new_rank);
-		target_piece_ptr = board_ptr->squares[target_square];
-		if (target_piece_ptr && piece_ptr->colour != target_piece_ptr->colour) {
-			// Check for pawn capture promotion
-			if (piece_ptr->colour == WHITE && new_rank == 7 || piece_ptr->colour == BLACK && new_rank == 0){
-				add_pawn_capture_promotions(move_list_ptr, board_ptr, piece_ptr->square, target_square);
-			}
-			else {
-				Move move = {};
-				set_move(&move, piece_ptr->square, target_square, CAPTURE);
-				move_list_ptr->moves[move_list_ptr->move_count++] = move;
-			}
-		}
-		// Check for en passant capture
-		else if (target_square == board_ptr->en_passant_target) {
-			Move move = {};
-			set_move(&move, piece_ptr->square, board_ptr->en_passant_target, EN_PASSANT);
-			move_list_ptr->moves[move_list_ptr->move_count++] = move;
-		}
-	}  
-
-	new_file = file - 1;
-	if (inside_board(new_file, new_rank)) {
-		target_square = coordinate_to_index(new_file, new_rank);
-		target_piece_ptr = board_ptr->squares[target_square];
-		if (target_piece_ptr && piece_ptr->colour != target_piece_ptr->colour) {
-			// Check for pawn capture promotion
-			if (piece_ptr->colour == WHITE && new_rank == 7 || piece_ptr->colour == BLACK && new_rank == 0){
-				add_pawn_capture_promotions(move_list_ptr, board_ptr, piece_ptr->square, target_square);
-			}
-			else {
-				Move move = {};
-				set_move(&move, piece_ptr->square, target_square, CAPTURE);
-				move_list_ptr->moves[move_list_ptr->move_count++] = move;
-			}
-		}
-		// Check for en passant capture
-		else if (target_square == board_ptr->en_passant_target) {
-			Move move = {};
-			set_move(&move, piece_ptr->square, board_ptr->en_passant_target, EN_PASSANT);
-			move_list_ptr->moves[move_list_ptr->move_count++] = move;
-		}
-	}
-}
-
-
-void get_knight_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr) {
-	get_set_moves(move_list_ptr, board_ptr, piece_ptr, knight_moves, 8);
-}
-
-
-void get_bishop_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr) {
-	get_sliding_moves(move_list_ptr, board_ptr, piece_ptr, bishop_directions, 4);
+	get_pawn_capture(move_list_ptr, board_ptr, piece_ptr, file + 1, new_rank, targets, us, gen_type);
+	get_pawn_capture(move_list_ptr, board_ptr, piece_ptr, file - 1, new_rank, targets, us, gen_type);
 }
 
 
-void get_rook_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr) {
-	get_sliding_moves(move_list_ptr, board_ptr, piece_ptr, rook_directions, 4);
-}
-
-
-void get_queen_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr) {
-	get_sliding_moves(move_list_ptr, board_ptr, piece_ptr, bishop_directions, 4);
-	get_sliding_moves(move_list_ptr, board_ptr, piece_ptr, rook_directions, 4);
-}
-
-
-void add_castling_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr) {
-	if (piece_ptr->colour == WHITE) {
-		if (board_ptr->castling_rights[WHITE][KINGSIDE]) {
-			if (!board_ptr->squares[F1] && !board_ptr->squares[G1]) {
-				Move move = {};
-				set_move(&move, piece_ptr->square, G1, CASTLE_KINGSIDE);
-				move_list_ptr->moves[move_list_ptr->move_count++] = move;
-			}
-		}
-		if (board_ptr->castling_rights[WHITE][QUEENSIDE]) {
-			if (!board_ptr->squares[D1] && !board_ptr->squares[C1] && !board_ptr->squares[B1]) {
-				Move move = {};
-				set_move(&move, piece_ptr->square, C1, CASTLE_QUEENSIDE);
-				move_list_ptr->moves[move_list_ptr->move_count++] = move;
-			}
+ALWAYS_INLINE void add_castling_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr, const Colour us) {
+	if (board_ptr->castling_rights[us][KINGSIDE]) {
+		const Square* empty = castle_empty_squares[us][KINGSIDE];
+		if (!board_ptr->squares[empty[0]] && !board_ptr->squares[empty[1]]) {
+			add_move(move_list_ptr, piece_ptr->square, castle_king_to[us][KINGSIDE], CASTLE_KINGSIDE);
 		}
 	}
-	else {
-		if (board_ptr->castling_rights[BLACK][KINGSIDE]) {
-			if (!board_ptr->squares[F8] && !board_ptr->squares[G8]) {
-				Move move = {};
-				set_move(&move, piece_ptr->square, G8, CASTLE_KINGSIDE);
-				move_list_ptr->moves[move_list_ptr->move_count++] = move;
-			}
-		}
-		if (board_ptr->castling_rights[BLACK][QUEENSIDE]) {
-			if (!board_ptr->squares[D8] && !board_ptr->squares[C8] && !board_ptr->squares[B8]) {
-				Move move = {};
-				set_move(&move, piece_ptr->square, C8, CASTLE_QUEENSIDE);
-				move_list_ptr->moves[move_list_ptr->move_count++] = move;
-			}
+	if (board_ptr->castling_rights[us][QUEENSIDE]) {
+		const Square* empty = castle_empty_squares[us][QUEENSIDE];
+		if (!board_ptr->squares[empty[0]] && !board_ptr->squares[empty[1]] && !board_ptr->squares[empty[2]]) {
+			add_move(move_list_ptr, piece_ptr->square, castle_king_to[us][QUEENSIDE], CASTLE_QUEENSIDE);
 		}
 	}
 }
 
 
-void get_king_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr) {
-	get_set_moves(move_list_ptr, board_ptr, piece_ptr, king_moves, 8);
-	add_castling_moves(move_list_ptr, board_ptr, piece_ptr);
+ALWAYS_INLINE void get_king_moves(
+	MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr, const Colour us, const GenType gen_type
+) {
+	// The king may always step out of check, so it ignores the evasion targets
+	const GenType king_gen_type = gen_type == GEN_EVASIONS ? GEN_ALL : gen_type;
+	get_set_moves(move_list_ptr, board_ptr, piece_ptr, king_moves, 8, ~0ULL, us, king_gen_type);
+
+	// Cannot castle out of check
+	if (gen_type == GEN_ALL || gen_type == GEN_QUIETS) {
+		add_castling_moves(move_list_ptr, board_ptr, piece_ptr, us);
+	}
 }
 
 
-void generate_piece_moves(MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr) {
+ALWAYS_INLINE void generate_piece_moves(
+	MoveList* move_list_ptr, Board* board_ptr, Piece* piece_ptr,
+	uint64_t targets, const Colour us, const GenType gen_type
+) {
 	switch (piece_ptr->type) {
-		case PAWN: 
-			get_pawn_moves(move_list_ptr, board_ptr, piece_ptr);
+		case PAWN:
+			get_pawn_moves(move_list_ptr, board_ptr, piece_ptr, targets, us, gen_type);
 			break;
 		case KNIGHT:
-			get_knight_moves(move_list_ptr, board_ptr, piece_ptr);
+			get_set_moves(move_list_ptr, board_ptr, piece_ptr, knight_moves, 8, targets, us, gen_type);
 			break;
 		case BISHOP:
-			get_bishop_moves(move_list_ptr, board_ptr, piece_ptr);
+			get_sliding_moves(move_list_ptr, board_ptr, piece_ptr, bishop_directions, 4, targets, us, gen_type);
 			break;
 		case ROOK:
-			get_rook_moves(move_list_ptr, board_ptr, piece_ptr);
+			get_sliding_moves(move_list_ptr, board_ptr, piece_ptr, rook_directions, 4, targets, us, gen_type);
 			break;
 		case QUEEN:
-			get_queen_moves(move_list_ptr, board_ptr, piece_ptr);
+			get_sliding_moves(move_list_ptr, board_ptr, piece_ptr, bishop_directions, 4, targets, us, gen_type);
+			get_sliding_moves(move_list_ptr, board_ptr, piece_ptr, rook_directions, 4, targets, us, gen_type);
 			break;
 		case KING:
-			get_king_moves(move_list_ptr, board_ptr, piece_ptr);
+			get_king_moves(move_list_ptr, board_ptr, piece_ptr, us, gen_type);
 			break;
 	}
 }
 
 
-void generate_pseudo_moves(MoveList* move_list_ptr, Board* board_ptr) {
+ALWAYS_INLINE void generate_moves_template(
+	MoveList* move_list_ptr, Board* board_ptr, uint64_t targets, const Colour us, const GenType gen_type
+) {
 	Piece* piece_ptr;
 	for (int i = 0; i < 16; i++) {
-		piece_ptr = &board_ptr->player_pieces[board_ptr->current_turn][i];
-		if (!piece_ptr) {
-			break;
-		}
+		piece_ptr = &board_ptr->player_pieces[us][i];
 		if (!piece_ptr->alive) {
 			continue;
 		}
-		generate_piece_moves(move_list_ptr, board_ptr, piece_ptr);
+		// In double check only the king (always at index 0) can move
+		if (gen_type == GEN_EVASIONS && !targets && piece_ptr->type != KING) {
+			break;
+		}
+		generate_piece_moves(move_list_ptr, board_ptr, piece_ptr, targets, us, gen_type);
 	}
 }
 
 
-bool in_check(Move* move_ptr, Board* board_ptr, MoveList* opponent_move_list_ptr, Colour king_colour) {
-	// Cannot castle into or through check
-	if (move_ptr->type == CASTLE_KINGSIDE && king_colour == WHITE) {
-		for (int i = 0; i < opponent_move_list_ptr->move_count; i++) {
-			Move* opponent_move = &opponent_move_list_ptr->moves[i];
-			if (opponent_move->to == F1 || opponent_move->to == G1) {
-				return false;
-			}
-		}
+#define DEFINE_GENERATOR(name, colour, gen_type) \
+	static void name(MoveList* move_list_ptr, Board* board_ptr, uint64_t targets) { \
+		generate_moves_template(move_list_ptr, board_ptr, targets, colour, gen_type); \
 	}
-	else if (move_ptr->type == CASTLE_QUEENSIDE && king_colour == WHITE) {
-		for (int i = 0; i < opponent_move_list_ptr->move_count; i++) {
-			Move* opponent_move = &opponent_move_list_ptr->moves[i];
-			if (opponent_move->to == D1 || opponent_move->to == C1) {
-				return false;
-			}
+
+DEFINE_GENERATOR(generate_white_all, WHITE, GEN_ALL)
+DEFINE_GENERATOR(generate_white_captures, WHITE, GEN_CAPTURES)
+DEFINE_GENERATOR(generate_white_quiets, WHITE, GEN_QUIETS)
+DEFINE_GENERATOR(generate_white_evasions, WHITE, GEN_EVASIONS)
+DEFINE_GENERATOR(generate_black_all, BLACK, GEN_ALL)
+DEFINE_GENERATOR(generate_black_captures, BLACK, GEN_CAPTURES)
+DEFINE_GENERATOR(generate_black_quiets, BLACK, GEN_QUIETS)
+DEFINE_GENERATOR(generate_black_evasions, BLACK, GEN_EVASIONS)
+
+static void (*const generators[2][4])(MoveList*, Board*, uint64_t) = {
+	{generate_white_all, generate_white_captures, generate_white_quiets, generate_white_evasions},
+	{generate_black_all, generate_black_captures, generate_black_quiets, generate_black_evasions},
+};
+
+
+/* Returns the number of pieces checking king_colour's king. For a single
+   check, check_mask_ptr receives the checker's square and the squares
+   between it and the king: the only targets for non-king evasions. */
+int get_check_mask(Board* board_ptr, Colour king_colour, uint64_t* check_mask_ptr) {
+	Square king_square = board_ptr->player_pieces[king_colour][0].square;
+	int file = index_to_file(king_square);
+	int rank = index_to_rank(king_square);
+	int pawn_forward = king_colour == WHITE ? 1 : -1;
+
+	int checkers = 0;
+	uint64_t check_mask = 0;
+	int new_file, new_rank;
+	Square target_square;
+	Piece* target_piece_ptr;
+
+	for (int i = 0; i < 8; i++) {
+		new_file = file + knight_moves[i][0];
+		new_rank = rank + knight_moves[i][1];
+		if (!inside_board(new_file, new_rank)) { continue; }
+		target_square = coordinate_to_index(new_file, new_rank);
+		target_piece_ptr = board_ptr->squares[target_square];
+		if (target_piece_ptr && target_piece_ptr->colour != king_colour && target_piece_ptr->type == KNIGHT) {
+			checkers++;
+			check_mask |= 1ULL << target_square;
 		}
 	}
-	else if (move_ptr->type == CASTLE_KINGSIDE && king_colour == BLACK) {
-		for (int i = 0; i < opponent_move_list_ptr->move_count; i++) {
-			Move* opponent_move = &opponent_move_list_ptr->moves[i];
-			if (opponent_move->to == F8 || opponent_move->to == G8) {
-				return false;
-			}
+
+	for (int i = -1; i <= 1; i += 2) {
+		new_file = file + i;
+		new_rank = rank + pawn_forward;
+		if (!inside_board(new_file, new_rank)) { continue; }
+		target_square = coordinate_to_index(new_file, new_rank);
+		target_piece_ptr = board_ptr->squares[target_square];
+		if (target_piece_ptr && target_piece_ptr->colour != king_colour && target_piece_ptr->type == PAWN) {
+			checkers++;
+			check_mask |= 1ULL << target_square;
 		}
 	}
-	else if (move_ptr->type == CASTLE_QUEENSIDE && king_colour == BLACK) {
-		for (int i = 0; i < opponent_move_list_ptr->move_count; i++) {
-			Move* opponent_move = &opponent_move_list_ptr->moves[i];
-			if (opponent_move->to == D8 || opponent_move->to == C8) {
-				return false;
+
+	// king_moves doubles as the eight ray directions, orthogonal ones first
+	for (int i = 0; i < 8; i++) {
+		PieceType slider = i < 4 ? ROOK : BISHOP;
+		uint64_t ray = 0;
+		new_file = file + king_moves[i][0];
+		new_rank = rank + king_moves[i][1];
+		while (inside_board(new_file, new_rank)) {
+			target_square = coordinate_to_index(new_file, new_rank);
+			ray |= 1ULL << target_square;
+			target_piece_ptr = board_ptr->squares[target_square];
+			if (target_piece_ptr) {
+				if (
+					target_piece_ptr->colour != king_colour &&
+					(target_piece_ptr->type == slider || target_piece_ptr->type == QUEEN)
+				) {
+					checkers++;
+					check_mask |= ray;
+				}
+				break;
 			}
+			new_file += king_moves[i][0];
+			new_rank += king_moves[i][1];
 		}
 	}
-	else {
-		// Check if king is under attack after move played
-		for (int i = 0; i < opponent_move_list_ptr->move_count; i++) {
-			Square king_square = board_ptr->player_pieces[king_colour][0].square;
-			if (opponent_move_list_ptr->moves[i].to == king_square) {
-				return false;
-			}
+
+	*check_mask_ptr = checkers == 1 ? check_mask : 0;
+	return checkers;
+}
+
+
+bool king_in_check(Board* board_ptr, Colour king_colour) {
+	uint64_t check_mask;
+	return get_check_mask(board_ptr, king_colour, &check_mask) > 0;
+}
+
+
+ALWAYS_INLINE int step_towards(int from, int to) {
+	return (to > from) - (to < from);
+}
+
+
+/* First occupied square walking from the king towards target, as the board
+   will be once the move has emptied from and filled to. NONE if target is
+   not on one of the king's lines */
+ALWAYS_INLINE Square first_on_line(Board* board_ptr, Square king_square, Square target, Square from, Square to) {
+	int file = index_to_file(king_square);
+	int rank = index_to_rank(king_square);
+	int file_distance = index_to_file(target) - file;
+	int rank_distance = index_to_rank(target) - rank;
+	if (file_distance && rank_distance && abs(file_distance) != abs(rank_distance)) {
+		return NONE;
+	}
+
+	int file_step = step_towards(0, file_distance);
+	int rank_step = step_towards(0, rank_distance);
+	for (file += file_step, rank += rank_step; inside_board(file, rank); file += file_step, rank += rank_step) {
+		Square square = coordinate_to_index(file, rank);
+		if (square == to || (square != from && board_ptr->squares[square])) {
+			return square;
 		}
 	}
-	return true;
+	return NONE;
 }
 
 
-bool can_castle(Move* move_ptr, MoveList* opponent_move_list_ptr, Colour king_colour) {
-	// Cannot castle in check
-	if (move_ptr->type == CASTLE_KINGSIDE && king_colour == WHITE) {
-		for (int i = 0; i < opponent_move_list_ptr->move_count; i++) {
-			Move* opponent_move = &opponent_move_list_ptr->moves[i];
-			if (opponent_move->to == E1 || opponent_move->to == F1 || opponent_move->to == G1) {
-				return false;
-			}
+ALWAYS_INLINE bool slides_along(PieceType type, bool orthogonal) {
+	return type == QUEEN || type == (orthogonal ? ROOK : BISHOP);
+}
+
+
+/* Whether a legal move checks the opponent, decided from the two lines
+   through the king that the move can open or close rather than by playing
+   it. Castling and en passant move a second piece and are played out */
+bool gives_check(Move* move_ptr, Board* board_ptr) {
+	const Colour us = board_ptr->current_turn;
+	const Colour them = get_opponent_colour(us);
+	if (move_ptr->type == CASTLE_KINGSIDE || move_ptr->type == CASTLE_QUEENSIDE || move_ptr->type == EN_PASSANT) {
+		MoveUndo undo;
+		play_move(move_ptr, board_ptr, &undo);
+		bool check = king_in_check(board_ptr, them);
+		unplay_move(move_ptr, board_ptr, &undo);
+		return check;
+	}
+
+	Square king_square = board_ptr->player_pieces[them][0].square;
+	Square from = move_ptr->from;
+	Square to = move_ptr->to;
+	PieceType type = board_ptr->squares[from]->type;
+	switch (move_ptr->type) {
+		case PROMOTION_KNIGHT: case CAPTURE_PROMOTION_KNIGHT: type = KNIGHT; break;
+		case PROMOTION_BISHOP: case CAPTURE_PROMOTION_BISHOP: type = BISHOP; break;
+		case PROMOTION_ROOK: case CAPTURE_PROMOTION_ROOK: type = ROOK; break;
+		case PROMOTION_QUEEN: case CAPTURE_PROMOTION_QUEEN: type = QUEEN; break;
+		default: break;
+	}
+
+	int file_distance = index_to_file(king_square) - index_to_file(to);
+	int rank_distance = index_to_rank(king_square) - index_to_rank(to);
+	if (type == PAWN) {
+		if (abs(file_distance) == 1 && rank_distance == (us == WHITE ? 1 : -1)) {
+			return true;
 		}
 	}
-	else if (move_ptr->type == CASTLE_QUEENSIDE && king_colour == WHITE) {
-		for (int i = 0; i < opponent_move_list_ptr->move_count; i++) {
-			Move* opponent_move = &opponent_move_list_ptr->moves[i];
-			if (opponent_move->to == E1 || opponent_move->to == D1 || opponent_move->to == C1) {
-				return false;
-			}
+	else if (type == KNIGHT) {
+		if (abs(file_distance * rank_distance) == 2) {
+			return true;
 		}
 	}
-	else if (move_ptr->type == CASTLE_KINGSIDE && king_colour == BLACK) {
-		for (int i = 0; i < opponent_move_list_ptr->move_count; i++) {
-			Move* opponent_move = &opponent_move_list_ptr->moves[i];
-			if (opponent_move->to == E8 || opponent_move->to == F8 || opponent_move->to == G8) {
-				return false;
-			}
+	else if (type != KING && first_on_line(board_ptr, king_square, to, from, to) == to) {
+		if (slides_along(type, !file_distance || !rank_distance)) {
+			return true;
 		}
 	}
-	else if (move_ptr->type == CASTLE_QUEENSIDE && king_colour == BLACK) {
-		for (int i = 0; i < opponent_move_list_ptr->move_count; i++) {
-			Move* opponent_move = &opponent_move_list_ptr->moves[i];
-			if (opponent_move->to == E8 || opponent_move->to == D8 || opponent_move->to == C8) {
-				return false;
-			}
+
+	// Discovered check by a slider the moving piece was blocking
+	Square behind = first_on_line(board_ptr, king_square, from, from, to);
+	if (behind == NONE || behind == to) {
+		return false;
+	}
+	Piece* piece_ptr = board_ptr->squares[behind];
+	bool orthogonal = index_to_file(king_square) == index_to_file(from) || index_to_rank(king_square) == index_to_rank(from);
+	return piece_ptr->colour == us && slides_along(piece_ptr->type, orthogonal);
+}
+
+
+void generate_moves(MoveList* move_list_ptr, Board* board_ptr, GenType gen_type) {
+	uint64_t targets = ~0ULL;
+	if (gen_type == GEN_EVASIONS) {
+		if (!get_check_mask(board_ptr, board_ptr->current_turn, &targets)) {
+			// Not in check, every move is a candidate
+			gen_type = GEN_ALL;
+			targets = ~0ULL;
 		}
 	}
-	return true;
+	generators[board_ptr->current_turn][gen_type](move_list_ptr, board_ptr, targets);
+}
+
+
+void generate_pseudo_moves(MoveList* move_list_ptr, Board* board_ptr) {
+	generate_moves(move_list_ptr, board_ptr, GEN_ALL);
 }
 
 
-bool is_legal(Move* move_ptr, Board* board_ptr) {
-	bool legal = true;
-	Colour king_colour = board_ptr->current_turn;
+/* Legality is decided from the opponent's attack map rather than from its
+   move list, which misses pawn attacks on empty squares and is far slower */
+ALWAYS_INLINE bool is_legal(Move* move_ptr, Board* board_ptr, const Colour us) {
+	const Colour them = us == WHITE ? BLACK : WHITE;
+	AttackMap attacks;
 
-	// Special pre-check for castling
+	// Cannot castle out of, through or into check. The king has not moved
+	// yet, but any ray it blocks would already be giving check
 	if (move_ptr->type == CASTLE_KINGSIDE || move_ptr->type == CASTLE_QUEENSIDE) {
-		switch_current_turn(board_ptr);
-		MoveList opponent_move_list = {};
-		generate_pseudo_moves(&opponent_move_list, board_ptr);
-		
-		legal = can_castle(move_ptr, &opponent_move_list, king_colour);
-		switch_current_turn(board_ptr);
-		if (!legal) {
-			return false;
-		}
+		CastleSide side = move_ptr->type == CASTLE_KINGSIDE ? KINGSIDE : QUEENSIDE;
+		compute_attack_map(board_ptr, them, &attacks);
+		return (
+			!square_attacked(&attacks, king_start_square[us]) &&
+			!square_attacked(&attacks, castle_king_path[us][side][0]) &&
+			!square_attacked(&attacks, castle_king_path[us][side][1])
+		);
 	}
 
-	// Play move on board
-	Piece* captured_piece_ptr = make_move(move_ptr, board_ptr);
-
-	// Save irreversible board data
-	Square saved_en_passant_target = board_ptr->en_passant_target;
-	bool saved_castling_rights[2][2] = {};
-	saved_castling_rights[WHITE][KINGSIDE] = board_ptr->castling_rights[WHITE][KINGSIDE];
-	saved_castling_rights[WHITE][QUEENSIDE] = board_ptr->castling_rights[WHITE][QUEENSIDE];
-	saved_castling_rights[BLACK][KINGSIDE] = board_ptr->castling_rights[BLACK][KINGSIDE];
-	saved_castling_rights[BLACK][QUEENSIDE] = board_ptr->castling_rights[BLACK][QUEENSIDE];
-
-	update_en_passant_target(move_ptr, board_ptr);
-	update_castling_rights(move_ptr, board_ptr);
-	
-	// Generate pseudo-legal moves for opponent
-	switch_current_turn(board_ptr);
-	MoveList opponent_move_list = {};
-	generate_pseudo_moves(&opponent_move_list, board_ptr);
-
-	legal = in_check(move_ptr, board_ptr, &opponent_move_list, king_colour);
-
-	// Undo move on board
-	switch_current_turn(board_ptr);
-	undo_move(move_ptr, board_ptr, captured_piece_ptr);
-
-	// Overwrite irreversible board data with saved data
-	board_ptr->en_passant_target = saved_en_passant_target;
-	board_ptr->castling_rights[WHITE][KINGSIDE] = saved_castling_rights[WHITE][KINGSIDE];
-	board_ptr->castling_rights[WHITE][QUEENSIDE] = saved_castling_rights[WHITE][QUEENSIDE];
-	board_ptr->castling_rights[BLACK][KINGSIDE] = saved_castling_rights[BLACK][KINGSIDE];
-	board_ptr->castling_rights[BLACK][QUEENSIDE] = saved_castling_rights[BLACK][QUEENSIDE];
+	// Check if king is under attack after move played
+	MoveUndo undo;
+	play_move(move_ptr, board_ptr, &undo);
+	compute_attack_map(board_ptr, them, &attacks);
+	bool legal = !square_attacked(&attacks, board_ptr->player_pieces[us][0].square);
+	unplay_move(move_ptr, board_ptr, &undo);
 
 	return legal;
 }
 
 
-void find_legal_moves(MoveList* move_list_ptr, Board* board_ptr) {
+ALWAYS_INLINE void find_legal_moves_template(MoveList* move_list_ptr, Board* board_ptr, const Colour us) {
 	int legal_moves = 0;
 	for (int i = 0; i < move_list_ptr->move_count; i++) {
-		if (is_legal(&move_list_ptr->moves[i], board_ptr)) {
+		if (is_legal(&move_list_ptr->moves[i], board_ptr, us)) {
 			// Only re-assign move index if there was an illegal move before it
 			if (i != legal_moves) {
 				move_list_ptr->moves[legal_moves] = move_list_ptr->moves[i];
@@ -462,3 +568,48 @@ void find_legal_moves(MoveList* move_list_ptr, Board* board_ptr) {
 	}
 	move_list_ptr->move_count = legal_moves;
 }
+
+
+static void find_legal_moves_white(MoveList* move_list_ptr, Board* board_ptr) {
+	find_legal_moves_template(move_list_ptr, board_ptr, WHITE);
+}
+
+
+static void find_legal_moves_black(MoveList* move_list_ptr, Board* board_ptr) {
+	find_legal_moves_template(move_list_ptr, board_ptr, BLACK);
+}
+
+
+/* Legality test for a single pseudo-legal move, so search can skip moves it
+   never reaches instead of filtering the whole list up front */
+bool is_legal_move(Move* move_ptr, Board* board_ptr) {
+	if (board_ptr->current_turn == WHITE) {
+		return is_legal(move_ptr, board_ptr, WHITE);
+	}
+	return is_legal(move_ptr, board_ptr, BLACK);
+}
+
+
+/* Terminal test that stops at the first legal move instead of filtering the
+   whole list. Evasions are generated in check, so any candidate is likely
+   to be legal */
+bool has_legal_move(Board* board_ptr) {
+	MoveList* move_list_ptr = push_move_list();
+	generate_moves(move_list_ptr, board_ptr, GEN_EVASIONS);
+	bool found = false;
+	for (int i = 0; i < move_list_ptr->move_count && !found; i++) {
+		found = is_legal_move(&move_list_ptr->moves[i], board_ptr);
+	}
+	pop_move_list();
+	return found;
+}
+
+
+void find_legal_moves(MoveList* move_list_ptr, Board* board_ptr) {
+	if (board_ptr->current_turn == WHITE) {
+		find_legal_moves_white(move_list_ptr, board_ptr);
+	}
+	else {
+		find_legal_moves_black(move_list_ptr, board_ptr);
+	}
+}
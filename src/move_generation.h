@@ -2,11 +2,20 @@
 #define MOVE_GENERATION_H
 
 
+#include <stdint.h>  // for uint64_t
 #include "chess.h"
 
 
 /* FUNCTION DEFINITIONS */
+MoveList* push_move_list();
+void pop_move_list();
+int get_check_mask(Board* board_ptr, Colour king_colour, uint64_t* check_mask_ptr);
+bool king_in_check(Board* board_ptr, Colour king_colour);
+bool gives_check(Move* move_ptr, Board* board_ptr);
+void generate_moves(MoveList* move_list_ptr, Board* board_ptr, GenType gen_type);
 void generate_pseudo_moves(MoveList* move_list_ptr, Board* board_ptr);
+bool is_legal_move(Move* move_ptr, Board* board_ptr);
+bool has_legal_move(Board* board_ptr);
 void find_legal_moves(MoveList* move_list_ptr, Board* board_ptr);
 
 
@@ -1,59 +1,86 @@
+#include <stdbool.h>  // for bool
 #include <stdio.h>
+#include <string.h>  // for memcmp
 #include <time.h>
+#include "bitboard_batch.h"
 #include "board.h"
 #include "move_generation.h"
+#include "perft.h"
 
 
 long long perft(Board* board_ptr, int depth) {
-	MoveList move_list = {};
-	generate_pseudo_moves(&move_list, board_ptr);
-	find_legal_moves(&move_list, board_ptr);
-
-	if (move_list.move_count == 0) {
-		return 0;
+	// The last ply is counted from attack and pin masks without listing moves
+	if (depth == 0) {
+		return has_legal_move(board_ptr);
 	}
-
-	if (depth == 0)
-	{
-		return 1;
+	if (depth == 1) {
+		return count_legal_moves(board_ptr);
 	}
 
-	if (depth == 1) 
-	{
-		return move_list.move_count;
-	}
+	MoveList* move_list_ptr = push_move_list();
+	// Evasions fall back to all moves when not in check
+	generate_moves(move_list_ptr, board_ptr, GEN_EVASIONS);
+	find_legal_moves(move_list_ptr, board_ptr);
 
 	long long nodes = 0;
-	for (int i = 0; i < move_list.move_count; i++) {
-		Move* selected_move_ptr = &move_list.moves[i];
-		Piece* captured_piece_ptr = make_move(selected_move_ptr, board_ptr);
+	for (int i = 0; i < move_list_ptr->move_count; i++) {
+		Move* selected_move_ptr = &move_list_ptr->moves[i];
+		MoveUndo undo;
+		play_move(selected_move_ptr, board_ptr, &undo);
 
-		// Save irreversible board data
-		Square saved_en_passant_target = board_ptr->en_passant_target;
-		bool saved_castling_rights[2][2] = {};
-		saved_castling_rights[WHITE][KINGSIDE] = board_ptr->castling_rights[WHITE][KINGSIDE];
-		saved_castling_rights[WHITE][QUEENSIDE] = board_ptr->castling_rights[WHITE][QUEENSIDE];
-		saved_castling_rights[BLACK][KINGSIDE] = board_ptr->castling_rights[BLACK][KINGSIDE];
-		saved_castling_rights[BLACK][QUEENSIDE] = board_ptr->castling_rights[BLACK][QUEENSIDE];
+		nodes += perft(board_ptr, depth - 1);
 
-		update_en_passant_target(selected_move_ptr, board_ptr);
-		update_castling_rights(selected_move_ptr, board_ptr);
+		unplay_move(selected_move_ptr, board_ptr, &undo);
+	}
 
-		switch_current_turn(board_ptr);
+	pop_move_list();
+	return nodes;
+}
 
-		nodes += perft(board_ptr, depth - 1);
 
-		switch_current_turn(board_ptr);
-		undo_move(&move_list.moves[i], board_ptr, captured_piece_ptr);
+/* Tallies one leaf move into the Perft Results categories. Only checking
+   moves are played, to see whether the reply list is empty */
+void count_leaf_move(Move* move_ptr, Board* board_ptr, PerftStats* stats_ptr) {
+	MoveType type = move_ptr->type;
+	stats_ptr->nodes++;
+	stats_ptr->captures += type == CAPTURE || type == EN_PASSANT || type >= CAPTURE_PROMOTION_KNIGHT;
+	stats_ptr->en_passants += type == EN_PASSANT;
+	stats_ptr->castles += type == CASTLE_KINGSIDE || type == CASTLE_QUEENSIDE;
+	stats_ptr->promotions += type >= PROMOTION_KNIGHT;
 
-		// Overwrite irreversible board data with saved data
-		board_ptr->en_passant_target = saved_en_passant_target;
-		board_ptr->castling_rights[WHITE][KINGSIDE] = saved_castling_rights[WHITE][KINGSIDE];
-		board_ptr->castling_rights[WHITE][QUEENSIDE] = saved_castling_rights[WHITE][QUEENSIDE];
-		board_ptr->castling_rights[BLACK][KINGSIDE] = saved_castling_rights[BLACK][KINGSIDE];
-		board_ptr->castling_rights[BLACK][QUEENSIDE] = saved_castling_rights[BLACK][QUEENSIDE];
+	if (!gives_check(move_ptr, board_ptr)) {
+		return;
 	}
-	return nodes;
+	stats_ptr->checks++;
+	MoveUndo undo;
+	play_move(move_ptr, board_ptr, &undo);
+	stats_ptr->checkmates += !has_legal_move(board_ptr);
+	unplay_move(move_ptr, board_ptr, &undo);
+}
+
+
+/* Same traversal as perft, but every leaf move is classified instead of
+   being bulk counted. Depth must be at least 1 */
+void perft_stats(Board* board_ptr, int depth, PerftStats* stats_ptr) {
+	MoveList* move_list_ptr = push_move_list();
+	generate_moves(move_list_ptr, board_ptr, GEN_EVASIONS);
+	find_legal_moves(move_list_ptr, board_ptr);
+
+	for (int i = 0; i < move_list_ptr->move_count; i++) {
+		Move* selected_move_ptr = &move_list_ptr->moves[i];
+		if (depth == 1) {
+			count_leaf_move(selected_move_ptr, board_ptr, stats_ptr);
+			continue;
+		}
+		MoveUndo undo;
+		play_move(selected_move_ptr, board_ptr, &undo);
+
+		perft_stats(board_ptr, depth - 1, stats_ptr);
+
+		unplay_move(selected_move_ptr, board_ptr, &undo);
+	}
+
+	pop_move_list();
 }
 
 
@@ -121,3 +148,98 @@ void run_perft_suite() {
 		4
 	);
 }
+
+
+void print_mismatch(char* name, long long found, long long expected) {
+	if (found != expected) {
+		printf("\t%s found: %lld expected: %lld\n", name, found, expected);
+	}
+}
+
+
+void run_perft_stats_test(char* fen_string, PerftStats* expected_results, int max_depth) {
+	Board board = {};
+	setup_board(&board, fen_string);
+
+	printf("%s\n", fen_string);
+	for (int i = 0; i < max_depth; i++) {
+		float start_time = (float)clock()/CLOCKS_PER_SEC;
+
+		PerftStats found = {};
+		perft_stats(&board, i + 1, &found);
+
+		float end_time = (float)clock()/CLOCKS_PER_SEC;
+		float time_elapsed = end_time - start_time;
+
+		PerftStats* expected_ptr = &expected_results[i];
+		bool passed = memcmp(&found, expected_ptr, sizeof(PerftStats)) == 0;
+		printf(passed ? "\033[0;32mPASSED!\033[0m": "\033[31mFAILED!\033[0m");
+		printf(" took: %.6fs\t", time_elapsed);
+		printf("[depth:%d] ", i + 1);
+		printf(
+			"nodes: %lld captures: %lld e.p.: %lld castles: %lld promotions: %lld checks: %lld checkmates: %lld\n",
+			found.nodes, found.captures, found.en_passants, found.castles, found.promotions, found.checks, found.checkmates
+		);
+
+		// Every counter that is off is named, to point at the generator branch that broke
+		print_mismatch("nodes", found.nodes, expected_ptr->nodes);
+		print_mismatch("captures", found.captures, expected_ptr->captures);
+		print_mismatch("e.p.", found.en_passants, expected_ptr->en_passants);
+		print_mismatch("castles", found.castles, expected_ptr->castles);
+		print_mismatch("promotions", found.promotions, expected_ptr->promotions);
+		print_mismatch("checks", found.checks, expected_ptr->checks);
+		print_mismatch("checkmates", found.checkmates, expected_ptr->checkmates);
+	}
+	printf("\n");
+}
+
+
+// Positions with a per-category breakdown on the Perft Results page, in the
+// order nodes, captures, e.p., castles, promotions, checks, checkmates
+void run_perft_stats_suite() {
+	run_perft_stats_test(
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+		(PerftStats [5]) {
+			{20, 0, 0, 0, 0, 0, 0},
+			{400, 0, 0, 0, 0, 0, 0},
+			{8902, 34, 0, 0, 0, 12, 0},
+			{197281, 1576, 0, 0, 0, 469, 8},
+			{4865609, 82719, 258, 0, 0, 27351, 347},
+		},
+		4
+	);
+
+	run_perft_stats_test(
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+		(PerftStats [4]) {
+			{48, 8, 0, 2, 0, 0, 0},
+			{2039, 351, 1, 91, 0, 3, 0},
+			{97862, 17102, 45, 3162, 0, 993, 1},
+			{4085603, 757163, 1929, 128013, 15172, 25523, 43},
+		},
+		4
+	);
+
+	run_perft_stats_test(
+		"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+		(PerftStats [5]) {
+			{14, 1, 0, 0, 0, 2, 0},
+			{191, 14, 0, 0, 0, 10, 0},
+			{2812, 209, 2, 0, 0, 267, 0},
+			{43238, 3348, 123, 0, 0, 1680, 17},
+			{674624, 52051, 1165, 0, 0, 52950, 0},
+		},
+		4
+	);
+
+	run_perft_stats_test(
+		"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+		(PerftStats [4]) {
+			{6, 0, 0, 0, 0, 0, 0},
+			{264, 87, 0, 6, 48, 10, 0},
+			{9467, 1021, 4, 0, 120, 38, 22},
+			{422333, 131393, 0, 7795, 60032, 15492, 5},
+		},
+		4
+	);
+}
@@ -2,8 +2,27 @@
 #define PERFT_H
 
 
+#include "chess.h"
+
+
+/* Leaf move counts by category, as tabulated on the Perft Results page.
+   Captures include en passant and capturing promotions */
+typedef struct {
+	long long nodes;
+	long long captures;
+	long long en_passants;
+	long long castles;
+	long long promotions;
+	long long checks;
+	long long checkmates;
+} PerftStats;
+
+
 /* FUNCTION DEFINITIONS */
+long long perft(Board* board_ptr, int depth);
+void perft_stats(Board* board_ptr, int depth, PerftStats* stats_ptr);
 void run_perft_suite();
+void run_perft_stats_suite();
 
 
 #endif  /* PERFT_H */
@@ -0,0 +1,402 @@
+#define _GNU_SOURCE  // for memmem
+#include <fcntl.h>  // for open
+#include <pthread.h>  // for pthread_create and pthread_join
+#include <stdbool.h>  // for bool
+#include <stdio.h>  // for printf
+#include <stdlib.h>  // for atoi, malloc and free
+#include <string.h>  // for memchr, memcmp, memcpy, memmem, strcmp, strcpy and strlen
+#include <sys/mman.h>  // for mmap, madvise and munmap
+#include <sys/stat.h>  // for fstat
+#include <unistd.h>  // for close and sysconf
+#include "chess.h"
+#include "board.h"
+#include "interface.h"
+#include "pgn.h"
+#include "timeman.h"
+
+
+#define MAX_SAN_TOKEN 16
+#define MAX_PGN_THREADS 256
+
+
+char* pgn_start_position = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+
+/* Maps the whole file read only. Returns false if it cannot be opened */
+bool pgn_open(PgnReader* reader_ptr, char* path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0) {
+		close(fd);
+		return false;
+	}
+
+	reader_ptr->size = file_stat.st_size;
+	reader_ptr->data = 0;
+	if (reader_ptr->size > 0) {
+		reader_ptr->data = mmap(0, reader_ptr->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (reader_ptr->data == MAP_FAILED) {
+		return false;
+	}
+	if (reader_ptr->data) {
+		madvise(reader_ptr->data, reader_ptr->size, MADV_SEQUENTIAL);
+	}
+	reader_ptr->position = reader_ptr->data;
+	reader_ptr->end = reader_ptr->data + reader_ptr->size;
+	return true;
+}
+
+
+void pgn_close(PgnReader* reader_ptr) {
+	if (reader_ptr->data) {
+		munmap(reader_ptr->data, reader_ptr->size);
+	}
+	reader_ptr->data = 0;
+}
+
+
+/* A game starts with a tag after a blank line */
+char* find_game_start(char* position, char* end) {
+	char* found = memmem(position, end - position, "\n\n[", 3);
+	char* found_crlf = memmem(position, end - position, "\n\r\n[", 4);
+	if (!found && !found_crlf) {
+		return end;
+	}
+	if (!found || (found_crlf && found_crlf < found)) {
+		return found_crlf + 3;
+	}
+	return found + 2;
+}
+
+
+/* Divides the remaining games between up to parts readers that share the
+   mapping, cutting only at game starts. Returns the number of readers */
+int pgn_split(PgnReader* reader_ptr, int parts, PgnReader* part_readers) {
+	size_t size = reader_ptr->end - reader_ptr->position;
+	char* start = reader_ptr->position;
+	int count = 0;
+	for (int i = 0; i < parts && start < reader_ptr->end; i++) {
+		char* boundary = reader_ptr->end;
+		if (i < parts - 1) {
+			char* nominal = reader_ptr->position + size * (i + 1) / parts;
+			boundary = find_game_start(nominal > start ? nominal : start, reader_ptr->end);
+		}
+		if (boundary > start) {
+			part_readers[count] = *reader_ptr;
+			part_readers[count].position = start;
+			part_readers[count].end = boundary;
+			count++;
+		}
+		start = boundary;
+	}
+	return count;
+}
+
+
+bool is_space(char c) {
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+
+/* Characters that end a move token even without a space before them */
+bool is_delimiter(char c) {
+	return c == '{' || c == '}' || c == '(' || c == ')' || c == ';';
+}
+
+
+bool at_line_start(PgnReader* reader_ptr) {
+	return reader_ptr->position == reader_ptr->data || reader_ptr->position[-1] == '\n';
+}
+
+
+void skip_line(PgnReader* reader_ptr) {
+	while (reader_ptr->position < reader_ptr->end && *reader_ptr->position != '\n') {
+		reader_ptr->position++;
+	}
+}
+
+
+/* [Name "value"], with \" and \\ escapes in the value */
+void parse_tag(PgnReader* reader_ptr, PgnGame* game_ptr) {
+	char* position = reader_ptr->position + 1;
+	char* end = reader_ptr->end;
+	PgnTag tag;  // Copied into the game only if there is room for it
+	PgnTag* tag_ptr = &tag;
+
+	int length = 0;
+	while (position < end && is_space(*position) && *position != '\n') { position++; }
+	while (position < end && !is_space(*position) && *position != '"' && *position != ']') {
+		if (length < PGN_TAG_NAME_LENGTH - 1) { tag_ptr->name[length++] = *position; }
+		position++;
+	}
+	tag_ptr->name[length] = 0;
+
+	length = 0;
+	while (position < end && *position != '"' && *position != '\n') { position++; }
+	if (position < end && *position == '"') {
+		for (position++; position < end && *position != '"' && *position != '\n'; position++) {
+			if (*position == '\\' && position + 1 < end) { position++; }
+			if (length < PGN_TAG_VALUE_LENGTH - 1) { tag_ptr->value[length++] = *position; }
+		}
+	}
+	tag_ptr->value[length] = 0;
+
+	if (tag_ptr->name[0] && game_ptr->tag_count < MAX_PGN_TAGS) {
+		game_ptr->tags[game_ptr->tag_count++] = tag;
+	}
+	reader_ptr->position = position;
+	skip_line(reader_ptr);
+}
+
+
+char* pgn_tag(PgnGame* game_ptr, char* name) {
+	for (int i = 0; i < game_ptr->tag_count; i++) {
+		if (strcmp(game_ptr->tags[i].name, name) == 0) {
+			return game_ptr->tags[i].value;
+		}
+	}
+	return 0;
+}
+
+
+bool parse_result(char* token, int length, PgnResult* result_ptr) {
+	if (length == 3 && memcmp(token, "1-0", 3) == 0) { *result_ptr = PGN_WHITE_WINS; }
+	else if (length == 3 && memcmp(token, "0-1", 3) == 0) { *result_ptr = PGN_BLACK_WINS; }
+	else if (length == 7 && memcmp(token, "1/2-1/2", 7) == 0) { *result_ptr = PGN_DRAW; }
+	else if (length == 1 && token[0] == '*') { *result_ptr = PGN_UNKNOWN; }
+	else { return false; }
+	return true;
+}
+
+
+void play_san(PgnGame* game_ptr, char* token, int length) {
+	char san[MAX_SAN_TOKEN];
+	Move move;
+	if (length >= MAX_SAN_TOKEN || game_ptr->move_count >= MAX_GAME_PLY - 1) {
+		game_ptr->error = true;
+		return;
+	}
+	memcpy(san, token, length);
+	san[length] = 0;
+	if (!san_to_move(&game_ptr->board, san, &move)) {
+		game_ptr->error = true;
+		return;
+	}
+	MoveUndo undo;
+	game_ptr->moves[game_ptr->move_count++] = move;
+	play_move(&move, &game_ptr->board, &undo);
+}
+
+
+/* Movetext runs until a result, the tags of the next game or the end of the
+   range. Comments, variations, NAGs and move numbers are skipped */
+void parse_movetext(PgnReader* reader_ptr, PgnGame* game_ptr) {
+	char* end = reader_ptr->end;
+	int variation_depth = 0;
+	bool has_result = false;
+
+	while (reader_ptr->position < end) {
+		char c = *reader_ptr->position;
+		if (is_space(c)) {
+			reader_ptr->position++;
+		}
+		else if (c == '[' && variation_depth == 0 && at_line_start(reader_ptr)) {
+			break;
+		}
+		else if (c == '{') {
+			char* close = memchr(reader_ptr->position, '}', end - reader_ptr->position);
+			reader_ptr->position = close ? close + 1 : end;
+		}
+		else if (c == ';' || (c == '%' && at_line_start(reader_ptr))) {
+			skip_line(reader_ptr);
+		}
+		else if (c == '(' || c == ')') {
+			variation_depth += c == '(' ? 1 : (variation_depth > 0 ? -1 : 0);
+			reader_ptr->position++;
+		}
+		else {
+			char* token = reader_ptr->position;
+			while (reader_ptr->position < end && !is_space(*reader_ptr->position) && !is_delimiter(*reader_ptr->position)) {
+				reader_ptr->position++;
+			}
+			int length = reader_ptr->position - token;
+			if (variation_depth > 0 || token[0] == '$') {
+				continue;
+			}
+			if (parse_result(token, length, &game_ptr->result)) {
+				has_result = true;
+				break;
+			}
+
+			// Move numbers, possibly glued to the move as in "12.e4"
+			int digits = 0;
+			while (digits < length && token[digits] >= '0' && token[digits] <= '9') { digits++; }
+			if (digits > 0 && digits < length && token[digits] == '.') {
+				while (digits < length && token[digits] == '.') { digits++; }
+				token += digits;
+				length -= digits;
+			}
+			else if (digits == length) {
+				continue;
+			}
+
+			if (length > 0 && !game_ptr->error) {
+				play_san(game_ptr, token, length);
+			}
+		}
+	}
+
+	if (!has_result) {
+		char* result_tag = pgn_tag(game_ptr, "Result");
+		if (result_tag) {
+			parse_result(result_tag, strlen(result_tag), &game_ptr->result);
+		}
+	}
+}
+
+
+/* Reads the next game of the range into game_ptr, replaying its moves on
+   game_ptr->board. Returns false when the range holds no more games */
+bool pgn_next_game(PgnReader* reader_ptr, PgnGame* game_ptr) {
+	while (reader_ptr->position < reader_ptr->end && is_space(*reader_ptr->position)) {
+		reader_ptr->position++;
+	}
+	if (reader_ptr->position >= reader_ptr->end) {
+		return false;
+	}
+
+	game_ptr->tag_count = 0;
+	game_ptr->result = PGN_UNKNOWN;
+	game_ptr->move_count = 0;
+	game_ptr->error = false;
+
+	while (reader_ptr->position < reader_ptr->end && *reader_ptr->position == '[') {
+		parse_tag(reader_ptr, game_ptr);
+		while (reader_ptr->position < reader_ptr->end && is_space(*reader_ptr->position)) {
+			reader_ptr->position++;
+		}
+	}
+
+	strcpy(game_ptr->start_fen, pgn_start_position);
+	char* fen = pgn_tag(game_ptr, "FEN");
+	if (fen && validate_fen(fen)) {
+		strcpy(game_ptr->start_fen, fen);
+	}
+	else if (fen) {
+		game_ptr->error = true;
+	}
+	setup_board(&game_ptr->board, game_ptr->start_fen);
+
+	parse_movetext(reader_ptr, game_ptr);
+	return true;
+}
+
+
+/* Prints "<result> <move> <move> ..." in SAN or UCI, replaying from the
+   start so each move is written against its own position */
+void print_pgn_game(PgnGame* game_ptr, bool uci) {
+	static char* result_names[] = {"1-0", "1/2-1/2", "0-1", "*"};
+	static Board board;
+	setup_board(&board, game_ptr->start_fen);
+
+	printf("%s", result_names[game_ptr->result]);
+	for (int i = 0; i < game_ptr->move_count; i++) {
+		char move_string[SAN_LENGTH];
+		if (uci) {
+			move_to_string(&game_ptr->moves[i], move_string);
+		}
+		else {
+			move_to_san(&board, &game_ptr->moves[i], move_string);
+		}
+		printf(" %s", move_string);
+		MoveUndo undo;
+		play_move(&game_ptr->moves[i], &board, &undo);
+	}
+	printf(game_ptr->error ? " (error)\n" : "\n");
+}
+
+
+typedef struct {
+	PgnReader reader;
+	long long games;
+	long long moves;
+	long long errors;
+} PgnWorker;
+
+
+void* pgn_worker(void* arg) {
+	PgnWorker* worker_ptr = arg;
+	PgnGame* game_ptr = malloc(sizeof(PgnGame));
+	while (pgn_next_game(&worker_ptr->reader, game_ptr)) {
+		worker_ptr->games++;
+		worker_ptr->moves += game_ptr->move_count;
+		worker_ptr->errors += game_ptr->error;
+	}
+	free(game_ptr);
+	return 0;
+}
+
+
+/* Usage: pgn <file> [threads N] [print san | print uci]
+   Without print, replays every game on all cores and reports throughput */
+void run_pgn(int argc, char** argv) {
+	if (argc < 1) {
+		printf("Usage: pgn <file> [threads N] [print san|uci]\n");
+		return;
+	}
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int print = 0;  // 0 for none, 1 for SAN, 2 for UCI
+	for (int i = 1; i < argc; i++) {
+		char* value = i + 1 < argc ? argv[i + 1] : "";
+		if (strcmp(argv[i], "threads") == 0) { threads = atoi(value); i++; }
+		else if (strcmp(argv[i], "print") == 0) { print = strcmp(value, "uci") == 0 ? 2 : 1; i++; }
+		else { printf("Unknown pgn argument: %s\n", argv[i]); return; }
+	}
+	threads = threads < 1 ? 1 : (threads > MAX_PGN_THREADS ? MAX_PGN_THREADS : threads);
+
+	PgnReader reader;
+	if (!pgn_open(&reader, argv[0])) {
+		printf("Could not open %s\n", argv[0]);
+		return;
+	}
+
+	if (print) {
+		static PgnGame game;
+		while (pgn_next_game(&reader, &game)) {
+			print_pgn_game(&game, print == 2);
+		}
+		pgn_close(&reader);
+		return;
+	}
+
+	long long start_time = current_time_ms();
+	PgnReader parts[MAX_PGN_THREADS];
+	int part_count = pgn_split(&reader, threads, parts);
+	PgnWorker workers[MAX_PGN_THREADS] = {};
+	pthread_t handles[MAX_PGN_THREADS];
+	for (int i = 0; i < part_count; i++) {
+		workers[i].reader = parts[i];
+		pthread_create(&handles[i], 0, pgn_worker, &workers[i]);
+	}
+
+	long long games = 0, moves = 0, errors = 0;
+	for (int i = 0; i < part_count; i++) {
+		pthread_join(handles[i], 0);
+		games += workers[i].games;
+		moves += workers[i].moves;
+		errors += workers[i].errors;
+	}
+	long long time_elapsed = current_time_ms() - start_time;
+	pgn_close(&reader);
+
+	printf(
+		"games: %lld moves: %lld errors: %lld threads: %d time: %.3fs games/s: %.0f\n",
+		games, moves, errors, part_count, time_elapsed / 1000.0,
+		time_elapsed > 0 ? games * 1000.0 / time_elapsed : 0.0
+	);
+}
@@ -0,0 +1,64 @@
+#ifndef PGN_H
+#define PGN_H
+
+
+#include <stdbool.h>  // for bool
+#include <stddef.h>  // for size_t
+#include "chess.h"
+
+
+#define MAX_PGN_TAGS 32
+#define PGN_TAG_NAME_LENGTH 32
+#define PGN_TAG_VALUE_LENGTH 128
+
+
+typedef enum {
+	PGN_WHITE_WINS,
+	PGN_DRAW,
+	PGN_BLACK_WINS,
+	PGN_UNKNOWN,  // "*" or no result at all
+} PgnResult;
+
+
+typedef struct {
+	char name[PGN_TAG_NAME_LENGTH];
+	char value[PGN_TAG_VALUE_LENGTH];  // Truncated if longer
+} PgnTag;
+
+
+/* One game, reused from game to game so reading allocates nothing. After
+   pgn_next_game the board holds the final position and moves the game, and
+   board.history[i] is the key of the position moves[i] was played from */
+typedef struct {
+	PgnTag tags[MAX_PGN_TAGS];
+	int tag_count;
+	PgnResult result;
+
+	char start_fen[PGN_TAG_VALUE_LENGTH];
+	Board board;
+	Move moves[MAX_GAME_PLY];
+	int move_count;
+	bool error;  // A move could not be decoded, moves stops before it
+} PgnGame;
+
+
+/* A byte range of a memory mapped PGN file. Several readers can share one
+   mapping, each over its own range of whole games */
+typedef struct {
+	char* data;
+	size_t size;  // Of the whole mapping
+	char* position;
+	char* end;
+} PgnReader;
+
+
+/* FUNCTION DEFINITIONS */
+bool pgn_open(PgnReader* reader_ptr, char* path);
+void pgn_close(PgnReader* reader_ptr);
+int pgn_split(PgnReader* reader_ptr, int parts, PgnReader* part_readers);
+bool pgn_next_game(PgnReader* reader_ptr, PgnGame* game_ptr);
+char* pgn_tag(PgnGame* game_ptr, char* name);
+void run_pgn(int argc, char** argv);
+
+
+#endif  /* PGN_H */
@@ -0,0 +1,152 @@
+#include <stdbool.h>  // for bool
+#include <stdio.h>  // for printf
+#include <stdlib.h>  // for atoi
+#include <string.h>  // for strcmp
+#include <unistd.h>  // for sysconf
+#include "chess.h"
+#include "board.h"
+#include "interface.h"
+#include "move_generation.h"
+#include "play.h"
+#include "search.h"
+#include "tt.h"
+
+
+/*
+ * Game at the terminal. Without arguments both sides are entered by hand.
+ * The engine plays the colours it is given, and while the human chooses a
+ * reply it ponders on the one its principal variation expects. If that
+ * reply is played the ponder search carries on as the real search, already
+ * several iterations deep. Otherwise it is stopped and the move played is
+ * searched afresh, helped by the hash entries the ponder search left.
+ */
+
+
+#define PLAY_HASH_MB 64
+#define DEFAULT_PLAY_MOVE_TIME 2000  // Milliseconds
+
+
+/* Picks the engine's move once the human has played last_move_ptr */
+Move engine_move(BackgroundSearch* background_ptr, Board* board_ptr, SearchInfo* info_ptr, Move* pondered_ptr, Move* last_move_ptr) {
+	if (background_ptr->running) {
+		if (same_move(pondered_ptr, last_move_ptr)) {
+			ponderhit(background_ptr);
+			wait_background_search(background_ptr);
+			printf("Ponderhit, ");
+			return info_ptr->best_move;
+		}
+		stop_background_search(background_ptr);
+	}
+	search(board_ptr, info_ptr);
+	return info_ptr->best_move;
+}
+
+
+/* Searches the position after the expected reply on the human's time */
+void start_pondering(BackgroundSearch* background_ptr, Board* board_ptr, SearchInfo* info_ptr, Move* pondered_ptr) {
+	*pondered_ptr = info_ptr->ponder_move;
+	if (pondered_ptr->from == NONE) {
+		return;
+	}
+	MoveUndo undo;
+	play_move(pondered_ptr, board_ptr, &undo);
+	start_background_search(background_ptr, board_ptr, info_ptr, true);
+	unplay_move(pondered_ptr, board_ptr, &undo);
+}
+
+
+/* play [white] [black] [movetime <ms>] [noponder], naming the sides the
+   engine plays */
+void play_game(int argc, char** argv) {
+	bool engine_plays[2] = {false, false};
+	int move_time = DEFAULT_PLAY_MOVE_TIME;
+	bool ponder = true;
+	for (int i = 0; i < argc; i++) {
+		char* value = i + 1 < argc ? argv[i + 1] : "0";
+		if (strcmp(argv[i], "white") == 0) { engine_plays[WHITE] = true; }
+		else if (strcmp(argv[i], "black") == 0) { engine_plays[BLACK] = true; }
+		else if (strcmp(argv[i], "movetime") == 0) { move_time = atoi(value); i++; }
+		else if (strcmp(argv[i], "noponder") == 0) { ponder = false; }
+		else { printf("Unknown play argument: %s\n", argv[i]); return; }
+	}
+
+	static SearchInfo info;
+	static TranspositionTable tt;
+	static BackgroundSearch background;
+	if (engine_plays[WHITE] || engine_plays[BLACK]) {
+		tt_init(&tt, PLAY_HASH_MB, sysconf(_SC_NPROCESSORS_ONLN), true);
+		info.options = default_search_options;
+		info.tt_ptr = &tt;
+		info.limits = (SearchLimits){.move_time = move_time};
+		clear_search_tables(&info);
+	}
+
+	char* fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+	Board board = {};
+	setup_board(&board, fen);
+	Move last_move = {NONE, NONE, QUIET_MOVE};
+	Move pondered_move = {NONE, NONE, QUIET_MOVE};
+
+	while (1) {
+		// Generate all moves in a position for current player
+		MoveList* move_list_ptr = push_move_list();
+		generate_pseudo_moves(move_list_ptr, &board);
+		find_legal_moves(move_list_ptr, &board);
+
+		// Display board and moves
+		print_board(&board);
+		print_board_details(&board);
+		print_move_list(move_list_ptr);
+
+		// Check for gameover
+		if (move_list_ptr->move_count == 0) {
+			pop_move_list();
+			break;
+		}
+		if (count_repetitions(&board) >= 2) {
+			printf("Draw by threefold repetition\n");
+			pop_move_list();
+			break;
+		}
+		if (is_fifty_move_draw(&board)) {
+			printf("Draw by fifty move rule\n");
+			pop_move_list();
+			break;
+		}
+		if (is_insufficient_material(&board)) {
+			printf("Draw by insufficient material\n");
+			pop_move_list();
+			break;
+		}
+
+		// Get move
+		Colour us = board.current_turn;
+		Move selected_move;
+		if (engine_plays[us]) {
+			selected_move = engine_move(&background, &board, &info, &pondered_move, &last_move);
+			char san[SAN_LENGTH];
+			move_to_san(&board, &selected_move, san);
+			printf("engine plays %s (depth %d)\n", san, info.completed_depth);
+		}
+		else {
+			int i = get_move_index(move_list_ptr);
+			selected_move = move_list_ptr->moves[i];
+		}
+		Move* selected_move_ptr = &selected_move;
+		pop_move_list();
+
+		// Make move
+		MoveUndo undo;
+		play_move(selected_move_ptr, &board, &undo);
+		last_move = selected_move;
+
+		if (engine_plays[us] && !engine_plays[board.current_turn] && ponder) {
+			start_pondering(&background, &board, &info, &pondered_move);
+		}
+	}
+
+	stop_background_search(&background);
+	if (info.tt_ptr) {
+		tt_free(&tt);
+	}
+}
@@ -0,0 +1,9 @@
+#ifndef PLAY_H
+#define PLAY_H
+
+
+/* FUNCTION DEFINITIONS */
+void play_game(int argc, char** argv);
+
+
+#endif  /* PLAY_H */
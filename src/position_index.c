@@ -0,0 +1,568 @@
+#include <fcntl.h>  // for open
+#include <pthread.h>  // for pthread_create and pthread_join
+#include <stdbool.h>  // for bool
+#include <stdio.h>  // for fopen, fread, fwrite, fseek, printf, remove, rename and snprintf
+#include <stdlib.h>  // for atoi, atoll, malloc, free and qsort
+#include <string.h>  // for memcmp, memcpy and strcmp
+#include <sys/mman.h>  // for mmap, madvise and munmap
+#include <sys/stat.h>  // for fstat
+#include <time.h>  // for clock_gettime
+#include <unistd.h>  // for close, fsync and sysconf
+#include "chess.h"
+#include "board.h"
+#include "interface.h"
+#include "move_generation.h"
+#include "pgn.h"
+#include "position_index.h"
+#include "timeman.h"
+
+
+/*
+ * Opening statistics over a PGN collection, as a sorted file of IndexEntry
+ * records behind an IndexHeader. Building is an external sort: each thread
+ * replays its own range of games into a buffer, combines equal records when
+ * the buffer fills, and spills it to a sorted run file once combining no
+ * longer frees half of it. The runs are then merged into the index, so the
+ * memory used does not grow with the size of the collection.
+ *
+ * Lookups binary search the mapped file, touching about log2(entries) pages.
+ */
+
+
+#define MAX_INDEX_THREADS 256
+#define DEFAULT_INDEX_PLIES 40
+#define DEFAULT_INDEX_MEMORY_MB 1024
+#define RUN_BUFFER_SIZE (1 << 18)  // stdio buffer per open run while merging
+#define MAX_PATH_LENGTH 4096
+
+
+/* Orders by key, then move */
+int compare_index_entries(const void* a, const void* b) {
+	const IndexEntry* entry_a = a;
+	const IndexEntry* entry_b = b;
+	if (entry_a->key != entry_b->key) {
+		return entry_a->key < entry_b->key ? -1 : 1;
+	}
+	return (int)entry_a->move - (int)entry_b->move;
+}
+
+
+bool same_index_record(IndexEntry* entry_a, IndexEntry* entry_b) {
+	return entry_a->key == entry_b->key && entry_a->move == entry_b->move;
+}
+
+
+void add_index_results(IndexEntry* target_ptr, IndexEntry* source_ptr) {
+	for (int i = 0; i < 3; i++) {
+		uint32_t sum = target_ptr->results[i] + source_ptr->results[i];
+		target_ptr->results[i] = sum < target_ptr->results[i] ? UINT32_MAX : sum;
+	}
+}
+
+
+/* Sorts the entries and folds equal records into one. Returns the new count */
+size_t sort_and_combine(IndexEntry* entries, size_t count) {
+	if (count == 0) {
+		return 0;
+	}
+	qsort(entries, count, sizeof(IndexEntry), compare_index_entries);
+	size_t combined = 0;
+	for (size_t i = 1; i < count; i++) {
+		if (same_index_record(&entries[combined], &entries[i])) {
+			add_index_results(&entries[combined], &entries[i]);
+		}
+		else {
+			entries[++combined] = entries[i];
+		}
+	}
+	return combined + 1;
+}
+
+
+void run_file_path(char* buffer, char* output_path, int thread, int run) {
+	snprintf(buffer, MAX_PATH_LENGTH, "%s.run%d.%d", output_path, thread, run);
+}
+
+
+typedef struct {
+	PgnReader reader;
+	char* output_path;
+	int thread;
+	int max_plies;  // 0 indexes whole games
+
+	IndexEntry* buffer;
+	size_t capacity;
+	size_t count;
+	int run_count;
+
+	long long games;
+	long long skipped_games;
+	long long records;
+	bool failed;
+} IndexWorker;
+
+
+void spill_run(IndexWorker* worker_ptr) {
+	char path[MAX_PATH_LENGTH];
+	run_file_path(path, worker_ptr->output_path, worker_ptr->thread, worker_ptr->run_count);
+	FILE* file = fopen(path, "wb");
+	size_t written = file ? fwrite(worker_ptr->buffer, sizeof(IndexEntry), worker_ptr->count, file) : 0;
+	if (!file || fclose(file) != 0 || written != worker_ptr->count) {
+		worker_ptr->failed = true;
+	}
+	worker_ptr->run_count++;
+	worker_ptr->count = 0;
+}
+
+
+void add_index_record(IndexWorker* worker_ptr, uint64_t key, Move* move_ptr, PgnResult result) {
+	if (worker_ptr->count == worker_ptr->capacity) {
+		worker_ptr->count = sort_and_combine(worker_ptr->buffer, worker_ptr->count);
+		if (worker_ptr->count > worker_ptr->capacity / 2) {
+			spill_run(worker_ptr);
+		}
+	}
+	IndexEntry* entry_ptr = &worker_ptr->buffer[worker_ptr->count++];
+	*entry_ptr = (IndexEntry){key, pack_move(move_ptr), 0, {0, 0, 0}};
+	entry_ptr->results[result] = 1;
+	worker_ptr->records++;
+}
+
+
+void* index_worker(void* arg) {
+	IndexWorker* worker_ptr = arg;
+	PgnGame* game_ptr = malloc(sizeof(PgnGame));
+	if (!game_ptr) {
+		worker_ptr->failed = true;
+	}
+
+	while (!worker_ptr->failed && pgn_next_game(&worker_ptr->reader, game_ptr)) {
+		// Without a result the game adds nothing to the statistics, and a move
+		// that could not be decoded leaves the result unrelated to the moves
+		if (game_ptr->result == PGN_UNKNOWN || game_ptr->error) {
+			worker_ptr->skipped_games++;
+			continue;
+		}
+		worker_ptr->games++;
+
+		int plies = game_ptr->move_count;
+		if (worker_ptr->max_plies > 0 && plies > worker_ptr->max_plies) {
+			plies = worker_ptr->max_plies;
+		}
+		// Reading the game already played it, and the history kept the key
+		// of the position each move was made from
+		for (int i = 0; i < plies; i++) {
+			add_index_record(worker_ptr, game_ptr->board.history[i], &game_ptr->moves[i], game_ptr->result);
+		}
+	}
+
+	worker_ptr->count = sort_and_combine(worker_ptr->buffer, worker_ptr->count);
+	if (worker_ptr->count > 0 && !worker_ptr->failed) {
+		spill_run(worker_ptr);
+	}
+	free(game_ptr);
+	return 0;
+}
+
+
+typedef struct {
+	FILE* file;
+	IndexEntry entry;
+} RunCursor;
+
+
+bool advance_run(RunCursor* cursor_ptr) {
+	return fread(&cursor_ptr->entry, sizeof(IndexEntry), 1, cursor_ptr->file) == 1;
+}
+
+
+/* Min-heap of run cursors on their current entry */
+void sift_down(RunCursor** heap, int size, int index) {
+	while (true) {
+		int smallest = index;
+		for (int child = 2 * index + 1; child <= 2 * index + 2 && child < size; child++) {
+			if (compare_index_entries(&heap[child]->entry, &heap[smallest]->entry) < 0) {
+				smallest = child;
+			}
+		}
+		if (smallest == index) {
+			return;
+		}
+		RunCursor* swap = heap[index];
+		heap[index] = heap[smallest];
+		heap[smallest] = swap;
+		index = smallest;
+	}
+}
+
+
+/* K-way merge of the sorted runs into the index file. Equal records from
+   different runs are combined. Returns the number of entries written, or -1 */
+long long merge_runs(IndexWorker* workers, int worker_count, char* output_path, long long games) {
+	int run_count = 0;
+	for (int i = 0; i < worker_count; i++) {
+		run_count += workers[i].run_count;
+	}
+	RunCursor* cursors = malloc((run_count + 1) * sizeof(RunCursor));
+	RunCursor** heap = malloc((run_count + 1) * sizeof(RunCursor*));
+	char path[MAX_PATH_LENGTH];
+	char temporary_path[MAX_PATH_LENGTH];
+	snprintf(temporary_path, MAX_PATH_LENGTH, "%s.tmp", output_path);
+	FILE* output = fopen(temporary_path, "wb");
+	bool failed = !cursors || !heap || !output;
+
+	int heap_size = 0;
+	for (int i = 0; i < worker_count && !failed; i++) {
+		for (int run = 0; run < workers[i].run_count && !failed; run++) {
+			run_file_path(path, output_path, workers[i].thread, run);
+			RunCursor* cursor_ptr = &cursors[heap_size];
+			cursor_ptr->file = fopen(path, "rb");
+			if (!cursor_ptr->file) {
+				failed = true;
+				break;
+			}
+			setvbuf(cursor_ptr->file, 0, _IOFBF, RUN_BUFFER_SIZE);
+			if (advance_run(cursor_ptr)) {
+				heap[heap_size++] = cursor_ptr;
+			}
+			else {
+				fclose(cursor_ptr->file);
+			}
+		}
+	}
+
+	IndexHeader header = {INDEX_MAGIC, INDEX_VERSION, sizeof(IndexEntry), 0, games};
+	if (!failed) {
+		failed = fwrite(&header, sizeof(header), 1, output) != 1;
+	}
+	for (int i = heap_size / 2 - 1; i >= 0; i--) {
+		sift_down(heap, heap_size, i);
+	}
+
+	IndexEntry pending;
+	bool has_pending = false;
+	while (heap_size > 0 && !failed) {
+		RunCursor* cursor_ptr = heap[0];
+		if (has_pending && same_index_record(&pending, &cursor_ptr->entry)) {
+			add_index_results(&pending, &cursor_ptr->entry);
+		}
+		else {
+			if (has_pending) {
+				failed = fwrite(&pending, sizeof(IndexEntry), 1, output) != 1;
+				header.entry_count++;
+			}
+			pending = cursor_ptr->entry;
+			has_pending = true;
+		}
+
+		if (!advance_run(cursor_ptr)) {
+			fclose(cursor_ptr->file);
+			heap[0] = heap[--heap_size];
+		}
+		sift_down(heap, heap_size, 0);
+	}
+	if (has_pending && !failed) {
+		failed = fwrite(&pending, sizeof(IndexEntry), 1, output) != 1;
+		header.entry_count++;
+	}
+	for (int i = 0; i < heap_size; i++) {
+		fclose(heap[i]->file);
+	}
+
+	if (!failed) {
+		failed = fseek(output, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, output) != 1 ||
+			fflush(output) != 0 || fsync(fileno(output)) != 0;
+	}
+	if (output && fclose(output) != 0) {
+		failed = true;
+	}
+	if (!failed) {
+		failed = rename(temporary_path, output_path) != 0;
+	}
+	else {
+		remove(temporary_path);
+	}
+
+	for (int i = 0; i < worker_count; i++) {
+		for (int run = 0; run < workers[i].run_count; run++) {
+			run_file_path(path, output_path, workers[i].thread, run);
+			remove(path);
+		}
+	}
+	free(cursors);
+	free(heap);
+	return failed ? -1 : (long long)header.entry_count;
+}
+
+
+/* Usage: index build <pgn file> <index file> [threads N] [plies N] [memory MB] */
+void build_index(int argc, char** argv) {
+	if (argc < 2) {
+		printf("Usage: index build <pgn file> <index file> [threads N] [plies N] [memory MB]\n");
+		return;
+	}
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int max_plies = DEFAULT_INDEX_PLIES;
+	long long memory_mb = DEFAULT_INDEX_MEMORY_MB;
+	for (int i = 2; i < argc; i++) {
+		char* value = i + 1 < argc ? argv[i + 1] : "0";
+		if (strcmp(argv[i], "threads") == 0) { threads = atoi(value); i++; }
+		else if (strcmp(argv[i], "plies") == 0) { max_plies = atoi(value); i++; }
+		else if (strcmp(argv[i], "memory") == 0) { memory_mb = atoll(value); i++; }
+		else { printf("Unknown index argument: %s\n", argv[i]); return; }
+	}
+	threads = threads < 1 ? 1 : (threads > MAX_INDEX_THREADS ? MAX_INDEX_THREADS : threads);
+	if (memory_mb < 1) {
+		memory_mb = 1;
+	}
+
+	PgnReader reader;
+	if (!pgn_open(&reader, argv[0])) {
+		printf("Could not open %s\n", argv[0]);
+		return;
+	}
+
+	long long start_time = current_time_ms();
+	PgnReader parts[MAX_INDEX_THREADS];
+	int part_count = pgn_split(&reader, threads, parts);
+	size_t capacity = memory_mb * 1024 * 1024 / sizeof(IndexEntry) / (part_count > 0 ? part_count : 1);
+	if (capacity < 2) {
+		capacity = 2;
+	}
+
+	IndexWorker workers[MAX_INDEX_THREADS] = {};
+	pthread_t handles[MAX_INDEX_THREADS];
+	for (int i = 0; i < part_count; i++) {
+		workers[i].reader = parts[i];
+		workers[i].output_path = argv[1];
+		workers[i].thread = i;
+		workers[i].max_plies = max_plies;
+		workers[i].capacity = capacity;
+		workers[i].buffer = malloc(capacity * sizeof(IndexEntry));
+		workers[i].failed = !workers[i].buffer;
+		pthread_create(&handles[i], 0, index_worker, &workers[i]);
+	}
+
+	long long games = 0, skipped_games = 0, records = 0, runs = 0;
+	bool failed = false;
+	for (int i = 0; i < part_count; i++) {
+		pthread_join(handles[i], 0);
+		free(workers[i].buffer);
+		games += workers[i].games;
+		skipped_games += workers[i].skipped_games;
+		records += workers[i].records;
+		runs += workers[i].run_count;
+		failed |= workers[i].failed;
+	}
+	pgn_close(&reader);
+	long long replay_time = current_time_ms() - start_time;
+
+	long long entries = failed ? -1 : merge_runs(workers, part_count, argv[1], games);
+	if (failed) {
+		char path[MAX_PATH_LENGTH];
+		for (int i = 0; i < part_count; i++) {
+			for (int run = 0; run < workers[i].run_count; run++) {
+				run_file_path(path, argv[1], i, run);
+				remove(path);
+			}
+		}
+	}
+	if (entries < 0) {
+		printf("Could not write %s\n", argv[1]);
+		return;
+	}
+	long long time_elapsed = current_time_ms() - start_time;
+	printf(
+		"games: %lld skipped: %lld positions: %lld entries: %lld runs: %lld threads: %d replay: %.3fs total: %.3fs\n",
+		games, skipped_games, records, entries, runs, part_count, replay_time / 1000.0, time_elapsed / 1000.0
+	);
+}
+
+
+/* Maps an index file read only. Returns false if it is missing or malformed */
+bool index_open(PositionIndex* index_ptr, char* path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(IndexHeader)) {
+		close(fd);
+		return false;
+	}
+	index_ptr->size = file_stat.st_size;
+	index_ptr->data = mmap(0, index_ptr->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (index_ptr->data == MAP_FAILED) {
+		return false;
+	}
+	// Lookups jump around the file, readahead would only waste cache
+	madvise(index_ptr->data, index_ptr->size, MADV_RANDOM);
+
+	index_ptr->header_ptr = index_ptr->data;
+	index_ptr->entries = (IndexEntry*)(index_ptr->header_ptr + 1);
+	IndexHeader* header_ptr = index_ptr->header_ptr;
+	if (
+		memcmp(header_ptr->magic, INDEX_MAGIC, sizeof(header_ptr->magic)) != 0 ||
+		header_ptr->version != INDEX_VERSION || header_ptr->entry_size != sizeof(IndexEntry) ||
+		header_ptr->entry_count != (index_ptr->size - sizeof(IndexHeader)) / sizeof(IndexEntry)
+	) {
+		index_close(index_ptr);
+		return false;
+	}
+	return true;
+}
+
+
+void index_close(PositionIndex* index_ptr) {
+	munmap(index_ptr->data, index_ptr->size);
+	index_ptr->data = 0;
+}
+
+
+/* Returns the first entry for the position and stores how many there are,
+   one per move played from it. The count is 0 for unknown positions */
+IndexEntry* index_find(PositionIndex* index_ptr, uint64_t key, int* count_ptr) {
+	size_t low = 0;
+	size_t high = index_ptr->header_ptr->entry_count;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		if (index_ptr->entries[middle].key < key) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	size_t end = low;
+	while (end < index_ptr->header_ptr->entry_count && index_ptr->entries[end].key == key) {
+		end++;
+	}
+	*count_ptr = end - low;
+	return &index_ptr->entries[low];
+}
+
+
+long long entry_games(IndexEntry* entry_ptr) {
+	return (long long)entry_ptr->results[PGN_WHITE_WINS] + entry_ptr->results[PGN_DRAW] + entry_ptr->results[PGN_BLACK_WINS];
+}
+
+
+int compare_by_games(const void* a, const void* b) {
+	long long games_a = entry_games((IndexEntry*)a);
+	long long games_b = entry_games((IndexEntry*)b);
+	return games_a < games_b ? 1 : (games_a > games_b ? -1 : 0);
+}
+
+
+void print_index_line(char* name, IndexEntry* entry_ptr) {
+	long long games = entry_games(entry_ptr);
+	printf(
+		"%-8s %10lld %7.1f%% %7.1f%% %7.1f%%\n", name, games,
+		100.0 * entry_ptr->results[PGN_WHITE_WINS] / games,
+		100.0 * entry_ptr->results[PGN_DRAW] / games,
+		100.0 * entry_ptr->results[PGN_BLACK_WINS] / games
+	);
+}
+
+
+/* Usage: index probe <index file> [<fen> | startpos] [moves <san> ...]
+   Prints the moves played from the position, most popular first */
+void probe_index(int argc, char** argv) {
+	if (argc < 1) {
+		printf("Usage: index probe <index file> [<fen> | startpos] [moves <san> ...]\n");
+		return;
+	}
+	PositionIndex index;
+	if (!index_open(&index, argv[0])) {
+		printf("Could not open index %s\n", argv[0]);
+		return;
+	}
+
+	char* fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+	int next_argument = 1;
+	if (argc > 1 && strcmp(argv[1], "moves") != 0) {
+		if (strcmp(argv[1], "startpos") != 0) {
+			fen = argv[1];
+		}
+		next_argument = 2;
+	}
+	if (!validate_fen(fen)) {
+		printf("Invalid FEN: %s\n", fen);
+		index_close(&index);
+		return;
+	}
+	static Board board;
+	setup_board(&board, fen);
+	if (next_argument < argc && strcmp(argv[next_argument], "moves") == 0) {
+		for (int i = next_argument + 1; i < argc; i++) {
+			Move move;
+			if (!san_to_move(&board, argv[i], &move)) {
+				printf("Illegal move: %s\n", argv[i]);
+				index_close(&index);
+				return;
+			}
+			MoveUndo undo;
+			play_move(&move, &board, &undo);
+		}
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	int count;
+	IndexEntry* found = index_find(&index, board.hash, &count);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double lookup_us = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+
+	// Hash collisions can bring in moves of another position, only the legal
+	// ones are shown
+	IndexEntry entries[MAX_MOVES];
+	IndexEntry total = {board.hash, 0, 0, {0, 0, 0}};
+	int shown = 0;
+	MoveList* move_list_ptr = push_move_list();
+	generate_pseudo_moves(move_list_ptr, &board);
+	find_legal_moves(move_list_ptr, &board);
+	for (int i = 0; i < count && shown < MAX_MOVES; i++) {
+		Move move = unpack_move(found[i].move);
+		for (int j = 0; j < move_list_ptr->move_count; j++) {
+			Move* legal_ptr = &move_list_ptr->moves[j];
+			if (legal_ptr->from == move.from && legal_ptr->to == move.to && legal_ptr->type == move.type) {
+				entries[shown++] = found[i];
+				add_index_results(&total, &found[i]);
+				break;
+			}
+		}
+	}
+	pop_move_list();
+	qsort(entries, shown, sizeof(IndexEntry), compare_by_games);
+
+	printf("entries: %llu games: %llu lookup: %.1fus\n",
+		(unsigned long long)index.header_ptr->entry_count, (unsigned long long)index.header_ptr->game_count, lookup_us);
+	printf("%-8s %10s %8s %8s %8s\n", "move", "games", "white", "draw", "black");
+	for (int i = 0; i < shown; i++) {
+		char san[SAN_LENGTH];
+		Move move = unpack_move(entries[i].move);
+		move_to_san(&board, &move, san);
+		print_index_line(san, &entries[i]);
+	}
+	if (shown > 0) {
+		print_index_line("total", &total);
+	}
+	else {
+		printf("Position not in index\n");
+	}
+	index_close(&index);
+}
+
+
+void run_index(int argc, char** argv) {
+	if (argc > 0 && strcmp(argv[0], "build") == 0) {
+		build_index(argc - 1, argv + 1);
+	}
+	else if (argc > 0 && strcmp(argv[0], "probe") == 0) {
+		probe_index(argc - 1, argv + 1);
+	}
+	else {
+		printf("Usage: index build|probe ...\n");
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef POSITION_INDEX_H
+#define POSITION_INDEX_H
+
+
+#include <stdbool.h>  // for bool
+#include <stddef.h>  // for size_t
+#include <stdint.h>  // for uint16_t, uint32_t and uint64_t
+#include "chess.h"
+
+
+#define INDEX_MAGIC "CHESSIDX"
+#define INDEX_VERSION 1
+
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t entry_size;  // sizeof(IndexEntry), guards against layout changes
+	uint64_t entry_count;
+	uint64_t game_count;
+} IndexHeader;
+
+
+/* How often a move was played from a position and how those games ended.
+   The file holds these sorted by key then move, so all the moves of one
+   position are next to each other */
+typedef struct {
+	uint64_t key;  // Zobrist hash of the position before the move
+	uint16_t move;  // from | to << 6 | type << 12
+	uint16_t unused;
+	uint32_t results[3];  // Indexed by PgnResult, saturates instead of wrapping
+} IndexEntry;
+
+
+/* A read only mapping of an index file, pages are only read as lookups
+   touch them */
+typedef struct {
+	void* data;
+	size_t size;
+	IndexHeader* header_ptr;
+	IndexEntry* entries;
+} PositionIndex;
+
+
+/* FUNCTION DEFINITIONS */
+bool index_open(PositionIndex* index_ptr, char* path);
+void index_close(PositionIndex* index_ptr);
+IndexEntry* index_find(PositionIndex* index_ptr, uint64_t key, int* count_ptr);
+void run_index(int argc, char** argv);
+
+
+#endif  /* POSITION_INDEX_H */
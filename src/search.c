@@ -0,0 +1,648 @@
+#include <math.h>  // for log
+#include <pthread.h>  // for pthread_create and pthread_join
+#include <stdbool.h>  // for bool
+#include <stdio.h>  // for printf
+#include <string.h>  // for memset and strcmp
+#include "chess.h"
+#include "board.h"
+#include "evaluate.h"
+#include "interface.h"
+#include "move_generation.h"
+#include "search.h"
+
+
+const SearchOptions default_search_options = {
+	.pvs = true,
+	.null_move = true,
+	.late_move_reductions = true,
+	.reverse_futility = true,
+	.futility = true,
+	.check_extensions = true,
+};
+
+
+// Largest depth at which each pruning technique is tried
+#define REVERSE_FUTILITY_DEPTH 6
+#define FUTILITY_DEPTH 3
+#define NULL_MOVE_DEPTH 3
+#define LMR_DEPTH 3
+#define LMR_MOVE_INDEX 3  // Number of moves searched at full depth first
+
+// Move ordering score bands
+#define TT_MOVE_SCORE 40000
+#define PROMOTION_SCORE 30000
+#define CAPTURE_SCORE 20000
+#define KILLER_SCORE 10000
+
+
+/* Switches off the technique named by a flag such as "no-lmr", returns
+   false if the flag is not recognised */
+bool parse_search_option(char* flag, SearchOptions* options_ptr) {
+	if (strcmp(flag, "no-pvs") == 0) { options_ptr->pvs = false; }
+	else if (strcmp(flag, "no-null") == 0) { options_ptr->null_move = false; }
+	else if (strcmp(flag, "no-lmr") == 0) { options_ptr->late_move_reductions = false; }
+	else if (strcmp(flag, "no-rfp") == 0) { options_ptr->reverse_futility = false; }
+	else if (strcmp(flag, "no-fp") == 0) { options_ptr->futility = false; }
+	else if (strcmp(flag, "no-ext") == 0) { options_ptr->check_extensions = false; }
+	else { return false; }
+	return true;
+}
+
+
+void clear_search_tables(SearchInfo* info_ptr) {
+	memset(info_ptr->killers, 0, sizeof(info_ptr->killers));
+	memset(info_ptr->history, 0, sizeof(info_ptr->history));
+}
+
+
+bool is_quiet(Move* move_ptr) {
+	return (
+		move_ptr->type == QUIET_MOVE || move_ptr->type == DOUBLE_PAWN_PUSH ||
+		move_ptr->type == CASTLE_KINGSIDE || move_ptr->type == CASTLE_QUEENSIDE
+	);
+}
+
+
+bool same_move(Move* a_ptr, Move* b_ptr) {
+	return a_ptr->from == b_ptr->from && a_ptr->to == b_ptr->to && a_ptr->type == b_ptr->type;
+}
+
+
+void score_moves(MoveList* move_list_ptr, Board* board_ptr, SearchInfo* info_ptr, int ply, Move* tt_move_ptr, int* scores) {
+	Colour us = board_ptr->current_turn;
+	for (int i = 0; i < move_list_ptr->move_count; i++) {
+		Move* move_ptr = &move_list_ptr->moves[i];
+		Piece* attacker_ptr = board_ptr->squares[move_ptr->from];
+		Piece* victim_ptr = board_ptr->squares[move_ptr->to];
+
+		if (same_move(move_ptr, tt_move_ptr)) {
+			scores[i] = TT_MOVE_SCORE;
+		}
+		else if (move_ptr->type == PROMOTION_QUEEN || move_ptr->type == CAPTURE_PROMOTION_QUEEN) {
+			scores[i] = PROMOTION_SCORE;
+		}
+		else if (victim_ptr || move_ptr->type == EN_PASSANT) {
+			// Most valuable victim, least valuable attacker
+			PieceType victim = victim_ptr ? victim_ptr->type : PAWN;
+			scores[i] = CAPTURE_SCORE + victim * 8 - attacker_ptr->type;
+		}
+		else if (same_move(move_ptr, &info_ptr->killers[ply][0])) {
+			scores[i] = KILLER_SCORE + 1;
+		}
+		else if (same_move(move_ptr, &info_ptr->killers[ply][1])) {
+			scores[i] = KILLER_SCORE;
+		}
+		else if (!is_quiet(move_ptr)) {
+			// Under-promotions go last
+			scores[i] = -2 * HISTORY_MAX;
+		}
+		else {
+			scores[i] = info_ptr->history[us][move_ptr->from][move_ptr->to];
+		}
+	}
+}
+
+
+/* Selection sort step: swaps the best scoring remaining move into index */
+void pick_move(MoveList* move_list_ptr, int* scores, int index) {
+	int best = index;
+	for (int i = index + 1; i < move_list_ptr->move_count; i++) {
+		if (scores[i] > scores[best]) {
+			best = i;
+		}
+	}
+	if (best != index) {
+		Move move = move_list_ptr->moves[index];
+		move_list_ptr->moves[index] = move_list_ptr->moves[best];
+		move_list_ptr->moves[best] = move;
+		int score = scores[index];
+		scores[index] = scores[best];
+		scores[best] = score;
+	}
+}
+
+
+/* History gravity keeps entries within +-HISTORY_MAX */
+void update_history(int* entry_ptr, int bonus) {
+	int magnitude = bonus < 0 ? -bonus : bonus;
+	*entry_ptr += bonus - *entry_ptr * magnitude / HISTORY_MAX;
+}
+
+
+void update_quiet_heuristics(SearchInfo* info_ptr, Board* board_ptr, Move* best_ptr, Move* tried, int tried_count, int depth, int ply) {
+	Colour us = board_ptr->current_turn;
+	int bonus = depth * depth > 1200 ? 1200 : depth * depth;
+
+	if (!same_move(best_ptr, &info_ptr->killers[ply][0])) {
+		info_ptr->killers[ply][1] = info_ptr->killers[ply][0];
+		info_ptr->killers[ply][0] = *best_ptr;
+	}
+
+	update_history(&info_ptr->history[us][best_ptr->from][best_ptr->to], bonus);
+	for (int i = 0; i < tried_count; i++) {
+		update_history(&info_ptr->history[us][tried[i].from][tried[i].to], -bonus);
+	}
+}
+
+
+void update_pv(SearchInfo* info_ptr, Move* move_ptr, int ply) {
+	info_ptr->pv[ply][ply] = *move_ptr;
+	for (int i = ply + 1; i < info_ptr->pv_length[ply + 1]; i++) {
+		info_ptr->pv[ply][i] = info_ptr->pv[ply + 1][i];
+	}
+	info_ptr->pv_length[ply] = info_ptr->pv_length[ply + 1];
+}
+
+
+/* The clock is not ours while pondering, so on the ponderhit the time
+   manager starts counting from then on, keeping everything searched so far */
+bool still_pondering(SearchInfo* info_ptr) {
+	if (info_ptr->pondering && !__atomic_load_n(&info_ptr->control_ptr->pondering, __ATOMIC_ACQUIRE)) {
+		info_ptr->pondering = false;
+		info_ptr->ponder_time = elapsed_time_ms(&info_ptr->time_manager);
+		info_ptr->time_manager.start_time += info_ptr->ponder_time;
+	}
+	return info_ptr->pondering;
+}
+
+
+bool should_stop(SearchInfo* info_ptr) {
+	if (info_ptr->limits.nodes && info_ptr->nodes >= info_ptr->limits.nodes) {
+		info_ptr->stopped = true;
+	}
+	// Reading the clock and the control flags is comparatively slow, so
+	// only do it every so often
+	if ((info_ptr->nodes & (TIME_CHECK_INTERVAL - 1)) == 0) {
+		if (info_ptr->control_ptr && __atomic_load_n(&info_ptr->control_ptr->stop, __ATOMIC_RELAXED)) {
+			info_ptr->stopped = true;
+		}
+		else if (!still_pondering(info_ptr) && hard_limit_reached(&info_ptr->time_manager)) {
+			info_ptr->stopped = true;
+		}
+	}
+	return info_ptr->stopped;
+}
+
+
+int late_move_reduction(SearchInfo* info_ptr, Board* board_ptr, Move* move_ptr, int depth, int move_index, bool pv_node) {
+	int reduction = (int)(0.75 + log(depth) * log(move_index) / 2.25);
+
+	// Reduce moves with a good history less and bad ones more
+	int history = info_ptr->history[board_ptr->current_turn][move_ptr->from][move_ptr->to];
+	reduction -= history / (HISTORY_MAX / 2);
+	if (pv_node) {
+		reduction--;
+	}
+
+	if (reduction < 0) {
+		return 0;
+	}
+	// Never drop straight into quiescence
+	if (reduction > depth - 2) {
+		return depth - 2;
+	}
+	return reduction;
+}
+
+
+/* Records a node when the search is being traced */
+ALWAYS_INLINE void trace_node(
+	SearchInfo* info_ptr, int ply, int depth, int alpha, int beta, int score, Move* move_ptr,
+	int legal_moves, int cutoff_index, int best_index, int flags
+) {
+	if (!info_ptr->trace_ptr) {
+		return;
+	}
+	TraceEvent* event_ptr = next_trace_event(info_ptr->trace_ptr);
+	event_ptr->move = pack_move(move_ptr);
+	event_ptr->alpha = alpha;
+	event_ptr->beta = beta;
+	event_ptr->score = score;
+	event_ptr->ply = ply;
+	event_ptr->depth = depth;
+	event_ptr->legal_moves = legal_moves;
+	event_ptr->cutoff_index = cutoff_index;
+	event_ptr->best_index = best_index;
+	event_ptr->flags = flags;
+	event_ptr->unused = 0;
+}
+
+
+int quiescence(Board* board_ptr, SearchInfo* info_ptr, int alpha, int beta, int ply) {
+	Move no_move = {NONE, NONE, QUIET_MOVE};
+	int entry_alpha = alpha;
+	info_ptr->pv_length[ply] = ply;
+	info_ptr->nodes++;
+	if (should_stop(info_ptr)) {
+		return 0;
+	}
+	if (ply >= MAX_PLY - 1) {
+		return evaluate(board_ptr);
+	}
+
+	bool in_check = king_in_check(board_ptr, board_ptr->current_turn);
+	int best_score = -INFINITE_SCORE;
+
+	if (!in_check) {
+		// Stand pat, the side to move can usually do at least as well as this
+		best_score = evaluate(board_ptr);
+		if (best_score >= beta) {
+			trace_node(info_ptr, ply, 0, entry_alpha, beta, best_score, &no_move, 0, 0, 0, TRACE_QUIESCENCE);
+			return best_score;
+		}
+		if (best_score > alpha) {
+			alpha = best_score;
+		}
+	}
+
+	MoveList* move_list_ptr = push_move_list();
+	generate_moves(move_list_ptr, board_ptr, in_check ? GEN_EVASIONS : GEN_CAPTURES);
+	int scores[MAX_MOVES];
+	score_moves(move_list_ptr, board_ptr, info_ptr, ply, &no_move, scores);
+
+	Move best_move = no_move;
+	int best_index = 0;
+	int cutoff_index = 0;
+	int legal_moves = 0;
+	for (int i = 0; i < move_list_ptr->move_count; i++) {
+		pick_move(move_list_ptr, scores, i);
+		Move* move_ptr = &move_list_ptr->moves[i];
+		if (!is_legal_move(move_ptr, board_ptr)) {
+			continue;
+		}
+		legal_moves++;
+
+		MoveUndo undo;
+		play_move(move_ptr, board_ptr, &undo);
+		prefetch_tt(info_ptr->tt_ptr, board_ptr->hash);
+		int score = -quiescence(board_ptr, info_ptr, -beta, -alpha, ply + 1);
+		unplay_move(move_ptr, board_ptr, &undo);
+
+		if (info_ptr->stopped) {
+			pop_move_list();
+			return 0;
+		}
+		if (score > best_score) {
+			best_score = score;
+			if (score > alpha) {
+				alpha = score;
+				best_move = *move_ptr;
+				best_index = legal_moves;
+				update_pv(info_ptr, move_ptr, ply);
+				if (score >= beta) {
+					cutoff_index = legal_moves;
+					break;
+				}
+			}
+		}
+	}
+	pop_move_list();
+
+	if (in_check && legal_moves == 0) {
+		best_score = -MATE_SCORE + ply;
+	}
+	trace_node(info_ptr, ply, 0, entry_alpha, beta, best_score, &best_move, legal_moves, cutoff_index, best_index, TRACE_QUIESCENCE);
+	return best_score;
+}
+
+
+int negamax(Board* board_ptr, SearchInfo* info_ptr, int alpha, int beta, int depth, int ply, bool null_allowed) {
+	SearchOptions* options_ptr = &info_ptr->options;
+	bool pv_node = beta - alpha > 1;
+	Colour us = board_ptr->current_turn;
+	info_ptr->pv_length[ply] = ply;
+
+	if (ply > 0 && (is_repetition(board_ptr) || is_fifty_move_draw(board_ptr))) {
+		return 0;
+	}
+
+	TTHit hit = {.move = {NONE, NONE, QUIET_MOVE}};
+	bool tt_hit = info_ptr->tt_ptr && tt_probe(info_ptr->tt_ptr, board_ptr->hash, ply, &hit);
+	if (
+		tt_hit && !pv_node && hit.depth >= depth && (
+			hit.bound == BOUND_EXACT ||
+			(hit.bound == BOUND_LOWER && hit.score >= beta) ||
+			(hit.bound == BOUND_UPPER && hit.score <= alpha)
+		)
+	) {
+		trace_node(info_ptr, ply, depth, alpha, beta, hit.score, &hit.move, 0, 0, 0, TRACE_TT_HIT | TRACE_TT_CUTOFF);
+		return hit.score;
+	}
+	int tt_flag = tt_hit ? TRACE_TT_HIT : 0;
+
+	bool in_check = king_in_check(board_ptr, us);
+	if (in_check && options_ptr->check_extensions) {
+		depth++;
+	}
+
+	if (depth <= 0) {
+		return quiescence(board_ptr, info_ptr, alpha, beta, ply);
+	}
+
+	info_ptr->nodes++;
+	if (should_stop(info_ptr)) {
+		return 0;
+	}
+	if (ply >= MAX_PLY - 1) {
+		return evaluate(board_ptr);
+	}
+
+	int static_eval = in_check ? -INFINITE_SCORE : evaluate(board_ptr);
+
+	// Reverse futility pruning: far enough above beta that a quiet move is
+	// not going to bring the score back down
+	if (
+		options_ptr->reverse_futility && !pv_node && !in_check &&
+		depth <= REVERSE_FUTILITY_DEPTH && beta > -MATE_BOUND && beta < MATE_BOUND &&
+		static_eval - 80 * depth >= beta
+	) {
+		trace_node(info_ptr, ply, depth, alpha, beta, static_eval, &hit.move, 0, 0, 0, tt_flag | TRACE_PRUNED);
+		return static_eval;
+	}
+
+	// Null move pruning: if passing still fails high, a real move will too.
+	// Skipped with only pawns left, where zugzwang makes passing unsound
+	if (
+		options_ptr->null_move && null_allowed && !pv_node && !in_check &&
+		depth >= NULL_MOVE_DEPTH && static_eval >= beta && has_non_pawn_material(board_ptr, us)
+	) {
+		// Adaptive reduction grows with depth and with the margin over beta
+		int eval_margin = (static_eval - beta) / 200;
+		int reduction = 3 + depth / 6 + (eval_margin > 3 ? 3 : eval_margin);
+
+		MoveUndo undo;
+		play_null_move(board_ptr, &undo);
+		int score = -negamax(board_ptr, info_ptr, -beta, -beta + 1, depth - 1 - reduction, ply + 1, false);
+		unplay_null_move(board_ptr, &undo);
+
+		if (info_ptr->stopped) {
+			return 0;
+		}
+		if (score >= beta) {
+			// Don't trust mate scores found after passing
+			score = score >= MATE_BOUND ? beta : score;
+			trace_node(info_ptr, ply, depth, alpha, beta, score, &hit.move, 0, 0, 0, tt_flag | TRACE_NULL_CUTOFF);
+			return score;
+		}
+	}
+
+	// Futility pruning: quiet moves cannot raise a score this far below alpha
+	bool futile = (
+		options_ptr->futility && !pv_node && !in_check && depth <= FUTILITY_DEPTH &&
+		alpha > -MATE_BOUND && alpha < MATE_BOUND && static_eval + 100 + 120 * depth <= alpha
+	);
+
+	MoveList* move_list_ptr = push_move_list();
+	generate_moves(move_list_ptr, board_ptr, in_check ? GEN_EVASIONS : GEN_ALL);
+	int scores[MAX_MOVES];
+	score_moves(move_list_ptr, board_ptr, info_ptr, ply, &hit.move, scores);
+
+	Move tried_quiets[64];
+	int tried_quiet_count = 0;
+
+	int original_alpha = alpha;
+	int best_score = -INFINITE_SCORE;
+	Move best_move = {NONE, NONE, QUIET_MOVE};
+	int best_index = 0;
+	int cutoff_index = 0;
+	int legal_moves = 0;
+	for (int i = 0; i < move_list_ptr->move_count; i++) {
+		pick_move(move_list_ptr, scores, i);
+		Move* move_ptr = &move_list_ptr->moves[i];
+		if (!is_legal_move(move_ptr, board_ptr)) {
+			continue;
+		}
+		legal_moves++;
+		bool quiet = is_quiet(move_ptr);
+
+		MoveUndo undo;
+		play_move(move_ptr, board_ptr, &undo);
+		prefetch_tt(info_ptr->tt_ptr, board_ptr->hash);
+		bool gives_check = king_in_check(board_ptr, board_ptr->current_turn);
+
+		if (futile && quiet && legal_moves > 1 && !gives_check) {
+			unplay_move(move_ptr, board_ptr, &undo);
+			continue;
+		}
+
+		int new_depth = depth - 1;
+		int score;
+		if (legal_moves == 1) {
+			score = -negamax(board_ptr, info_ptr, -beta, -alpha, new_depth, ply + 1, true);
+		}
+		else {
+			int reduction = 0;
+			if (
+				options_ptr->late_move_reductions && depth >= LMR_DEPTH && legal_moves > LMR_MOVE_INDEX &&
+				quiet && !in_check && !gives_check
+			) {
+				reduction = late_move_reduction(info_ptr, board_ptr, move_ptr, depth, legal_moves, pv_node);
+			}
+
+			// Principal variation search: prove later moves are worse with a
+			// null window and only re-search the ones that are not
+			int window_beta = options_ptr->pvs ? alpha + 1 : beta;
+			score = -negamax(board_ptr, info_ptr, -window_beta, -alpha, new_depth - reduction, ply + 1, true);
+			if (score > alpha && reduction > 0) {
+				score = -negamax(board_ptr, info_ptr, -window_beta, -alpha, new_depth, ply + 1, true);
+			}
+			if (score > alpha && score < beta && window_beta != beta) {
+				score = -negamax(board_ptr, info_ptr, -beta, -alpha, new_depth, ply + 1, true);
+			}
+		}
+
+		unplay_move(move_ptr, board_ptr, &undo);
+
+		if (info_ptr->stopped) {
+			pop_move_list();
+			return 0;
+		}
+
+		if (score > best_score) {
+			best_score = score;
+			if (score > alpha) {
+				alpha = score;
+				best_move = *move_ptr;
+				best_index = legal_moves;
+				update_pv(info_ptr, move_ptr, ply);
+				if (score >= beta) {
+					cutoff_index = legal_moves;
+					if (quiet) {
+						update_quiet_heuristics(info_ptr, board_ptr, move_ptr, tried_quiets, tried_quiet_count, depth, ply);
+					}
+					break;
+				}
+			}
+		}
+		if (quiet && tried_quiet_count < 64) {
+			tried_quiets[tried_quiet_count++] = *move_ptr;
+		}
+	}
+	pop_move_list();
+
+	if (legal_moves == 0) {
+		best_score = in_check ? -MATE_SCORE + ply : 0;
+		trace_node(info_ptr, ply, depth, original_alpha, beta, best_score, &best_move, 0, 0, 0, tt_flag);
+		return best_score;
+	}
+	if (info_ptr->tt_ptr) {
+		Bound bound = best_score >= beta ? BOUND_LOWER : best_score > original_alpha ? BOUND_EXACT : BOUND_UPPER;
+		tt_store(info_ptr->tt_ptr, board_ptr->hash, &best_move, best_score, depth, bound, ply);
+	}
+	trace_node(info_ptr, ply, depth, original_alpha, beta, best_score, &best_move, legal_moves, cutoff_index, best_index, tt_flag);
+	return best_score;
+}
+
+
+void print_search_info(SearchInfo* info_ptr, int depth, int score) {
+	printf("info depth %d ", depth);
+	if (score >= MATE_BOUND) {
+		printf("score mate %d ", (MATE_SCORE - score + 1) / 2);
+	}
+	else if (score <= -MATE_BOUND) {
+		printf("score mate %d ", -(MATE_SCORE + score) / 2);
+	}
+	else {
+		printf("score cp %d ", score);
+	}
+	long long time_elapsed = info_ptr->ponder_time + elapsed_time_ms(&info_ptr->time_manager);
+	long long nps = time_elapsed > 0 ? info_ptr->nodes * 1000 / time_elapsed : 0;
+	printf("nodes %lld nps %lld time %lld pv", info_ptr->nodes, nps, time_elapsed);
+
+	char move_string[6];
+	for (int i = 0; i < info_ptr->pv_length[0]; i++) {
+		move_to_string(&info_ptr->pv[0][i], move_string);
+		printf(" %s", move_string);
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+
+/* Iterative deepening driver. The result of an iteration that was stopped
+   part way through is thrown away, except at depth 1. On a clock the time
+   manager decides when to stop between iterations */
+void search(Board* board_ptr, SearchInfo* info_ptr) {
+	info_ptr->nodes = 0;
+	info_ptr->stopped = false;
+	info_ptr->completed_depth = 0;
+	info_ptr->best_score = 0;
+	info_ptr->best_move = (Move){NONE, NONE, QUIET_MOVE};
+	info_ptr->ponder_move = (Move){NONE, NONE, QUIET_MOVE};
+	info_ptr->pondering = info_ptr->control_ptr && __atomic_load_n(&info_ptr->control_ptr->pondering, __ATOMIC_ACQUIRE);
+	info_ptr->ponder_time = 0;
+	if (info_ptr->tt_ptr) {
+		tt_new_search(info_ptr->tt_ptr);
+	}
+
+	Colour us = board_ptr->current_turn;
+	SearchLimits* limits_ptr = &info_ptr->limits;
+	init_time_manager(
+		&info_ptr->time_manager, limits_ptr->time[us], limits_ptr->increment[us],
+		limits_ptr->moves_to_go, limits_ptr->move_time
+	);
+
+	// Fall back to any legal move if the limits stop the first iteration
+	MoveList* move_list_ptr = push_move_list();
+	generate_pseudo_moves(move_list_ptr, board_ptr);
+	find_legal_moves(move_list_ptr, board_ptr);
+	int legal_moves = move_list_ptr->move_count;
+	if (legal_moves > 0) {
+		info_ptr->best_move = move_list_ptr->moves[0];
+	}
+	pop_move_list();
+
+	Move no_move = {NONE, NONE, QUIET_MOVE};
+	trace_node(info_ptr, 0, 0, 0, 0, 0, &no_move, 0, 0, 0, TRACE_NEW_SEARCH);
+
+	// Nothing to search when the game is already over
+	if (legal_moves == 0) {
+		info_ptr->best_score = king_in_check(board_ptr, us) ? -MATE_SCORE : 0;
+		return;
+	}
+
+	int max_depth = MAX_PLY - 1;
+	if (info_ptr->limits.depth && info_ptr->limits.depth < max_depth) {
+		max_depth = info_ptr->limits.depth;
+	}
+
+	for (int depth = 1; depth <= max_depth; depth++) {
+		int score = negamax(board_ptr, info_ptr, -INFINITE_SCORE, INFINITE_SCORE, depth, 0, true);
+
+		if (info_ptr->stopped && depth > 1) {
+			break;
+		}
+		if (info_ptr->pv_length[0] > 0) {
+			info_ptr->best_move = info_ptr->pv[0][0];
+			if (info_ptr->pv_length[0] > 1) {
+				info_ptr->ponder_move = info_ptr->pv[0][1];
+			}
+			info_ptr->best_score = score;
+			info_ptr->completed_depth = depth;
+		}
+		if (!info_ptr->stopped) {
+			trace_node(info_ptr, 0, depth, 0, 0, score, &info_ptr->best_move, 0, 0, 0, TRACE_ITERATION);
+		}
+		if (info_ptr->verbose) {
+			print_search_info(info_ptr, depth, score);
+		}
+		if (info_ptr->stopped) {
+			break;
+		}
+
+		// Not worth starting an iteration that is unlikely to finish. The
+		// time manager still sees every iteration while pondering, so a best
+		// move that stayed stable then lets it stop early after the ponderhit
+		bool out_of_time = soft_limit_reached(&info_ptr->time_manager, &info_ptr->best_move, info_ptr->best_score);
+		if (out_of_time && !still_pondering(info_ptr)) {
+			break;
+		}
+	}
+}
+
+
+void* background_search_thread(void* argument) {
+	BackgroundSearch* background_ptr = argument;
+	search(&background_ptr->board, background_ptr->info_ptr);
+	if (background_ptr->on_finish) {
+		background_ptr->on_finish(background_ptr);
+	}
+	return 0;
+}
+
+
+/* The SearchInfo belongs to the search until it is waited for or stopped.
+   A ponder search ignores the clock until ponderhit is called */
+void start_background_search(BackgroundSearch* background_ptr, Board* board_ptr, SearchInfo* info_ptr, bool ponder) {
+	copy_board(&background_ptr->board, board_ptr);
+	background_ptr->info_ptr = info_ptr;
+	background_ptr->control = (SearchControl){.stop = false, .pondering = ponder};
+	info_ptr->control_ptr = &background_ptr->control;
+	background_ptr->running = true;
+	pthread_create(&background_ptr->thread, 0, background_search_thread, background_ptr);
+}
+
+
+/* The opponent played the expected move, so the search carries on as a
+   normal one on our clock */
+void ponderhit(BackgroundSearch* background_ptr) {
+	__atomic_store_n(&background_ptr->control.pondering, false, __ATOMIC_RELEASE);
+}
+
+
+void wait_background_search(BackgroundSearch* background_ptr) {
+	if (!background_ptr->running) {
+		return;
+	}
+	pthread_join(background_ptr->thread, 0);
+	background_ptr->running = false;
+	background_ptr->info_ptr->control_ptr = 0;
+}
+
+
+/* Also how a ponder search is discarded on a miss. Its hash entries stay
+   and help the search of the move actually played */
+void stop_background_search(BackgroundSearch* background_ptr) {
+	__atomic_store_n(&background_ptr->control.stop, true, __ATOMIC_RELAXED);
+	wait_background_search(background_ptr);
+}
@@ -0,0 +1,106 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+
+#include <pthread.h>  // for pthread_t
+#include <stdbool.h>  // for bool
+#include "chess.h"
+#include "timeman.h"
+#include "trace.h"
+#include "tt.h"
+
+
+#define INFINITE_SCORE 32000
+#define MATE_SCORE 30000
+#define MATE_BOUND (MATE_SCORE - MAX_PLY)  // Scores beyond this are mates
+#define HISTORY_MAX 16384
+
+
+/* Each selective search technique can be switched off to measure it */
+typedef struct {
+	bool pvs;
+	bool null_move;
+	bool late_move_reductions;
+	bool reverse_futility;
+	bool futility;
+	bool check_extensions;
+} SearchOptions;
+
+
+typedef struct {
+	int depth;  // 0 for no limit
+	long long nodes;  // 0 for no limit
+
+	// Clock in milliseconds, indexed by [Colour], 0 when not playing on a clock
+	int time[2];
+	int increment[2];
+	int moves_to_go;
+	int move_time;  // Fixed time per move, 0 for none
+} SearchLimits;
+
+
+/* Flags another thread uses to steer a running search, read with atomics */
+typedef struct {
+	bool stop;
+	bool pondering;  // Searching on the opponent's time, clock limits wait for the ponderhit
+} SearchControl;
+
+
+typedef struct {
+	SearchOptions options;
+	SearchLimits limits;
+	bool verbose;  // Print an info line after each iteration
+	TimeManager time_manager;
+	TranspositionTable* tt_ptr;  // 0 to search without one
+	SearchTrace* trace_ptr;  // 0 unless every node should be recorded
+	SearchControl* control_ptr;  // 0 unless the search can be stopped or ponders
+	bool pondering;  // This search's view of control_ptr->pondering
+	long long ponder_time;  // Milliseconds spent before the ponderhit, not on our clock
+
+	// Results of the last search
+	Move best_move;
+	Move ponder_move;  // Reply the principal variation expects, from is NONE when unknown
+	int best_score;
+	int completed_depth;
+	long long nodes;
+	bool stopped;
+
+	// Move ordering heuristics, kept between searches
+	Move killers[MAX_PLY][2];
+	int history[2][64][64];
+
+	// Triangular principal variation table
+	Move pv[MAX_PLY][MAX_PLY];
+	int pv_length[MAX_PLY];
+} SearchInfo;
+
+
+/* A search on a thread of its own, so the caller can keep reading input.
+   The position is copied, and on_finish (if any) runs on the search thread
+   once it returns */
+typedef struct BackgroundSearch {
+	Board board;
+	SearchInfo* info_ptr;
+	SearchControl control;
+	void (*on_finish)(struct BackgroundSearch*);
+	pthread_t thread;
+	bool running;
+} BackgroundSearch;
+
+
+extern const SearchOptions default_search_options;
+
+
+/* FUNCTION DEFINITIONS */
+bool parse_search_option(char* flag, SearchOptions* options_ptr);
+bool same_move(Move* a_ptr, Move* b_ptr);
+void clear_search_tables(SearchInfo* info_ptr);
+int quiescence(Board* board_ptr, SearchInfo* info_ptr, int alpha, int beta, int ply);
+void search(Board* board_ptr, SearchInfo* info_ptr);
+void start_background_search(BackgroundSearch* background_ptr, Board* board_ptr, SearchInfo* info_ptr, bool ponder);
+void ponderhit(BackgroundSearch* background_ptr);
+void wait_background_search(BackgroundSearch* background_ptr);
+void stop_background_search(BackgroundSearch* background_ptr);
+
+
+#endif  /* SEARCH_H */
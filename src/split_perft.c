@@ -0,0 +1,419 @@
+#include <errno.h>  // for errno and ESRCH
+#include <fcntl.h>  // for open
+#include <signal.h>  // for kill
+#include <stdbool.h>  // for bool
+#include <stdio.h>  // for fopen, fprintf, printf, snprintf, sscanf and rename
+#include <stdlib.h>  // for atoi
+#include <string.h>  // for memcpy, strcmp, strcspn, strlen, strstr and strtok
+#include <sys/file.h>  // for flock
+#include <unistd.h>  // for close, getpid, lseek, pread, pwrite, fsync and fdatasync
+#include "chess.h"
+#include "board.h"
+#include "interface.h"
+#include "move_generation.h"
+#include "perft.h"
+
+
+/*
+ * Deep perft split into work units that several processes can share through
+ * a journal file. The journal is a short text header followed by one fixed
+ * length record per unit, so a record can be rewritten in place:
+ *
+ *   perft-journal
+ *   fen <fen>
+ *   depth <depth>
+ *   split <split depth>
+ *   units <count>
+ *   <state> <pid> <boot id> <nodes> <moves from the root>
+ *   ...
+ *   reported
+ *
+ * Every change to a record is made under an exclusive flock on the whole
+ * file, and completed units are synced before the lock is released. A unit
+ * claimed by a process that has since died, or that was claimed before a
+ * reboot, is handed out again, so rerunning "work" resumes a killed run.
+ * The "reported" line is appended by the worker that prints the total.
+ */
+
+
+#define RECORD_LENGTH 96
+#define MOVES_FIELD_LENGTH 52
+#define MAX_SPLIT_DEPTH 8  // Six characters per move must fit the moves field
+#define MAX_HEADER_LENGTH 512
+#define BOOT_ID_LENGTH 8
+#define SCAN_CHUNK 256  // Records read per pread while looking for work
+#define REPORTED_LINE "reported\n"
+
+
+typedef enum {
+	UNIT_PENDING = 'P',
+	UNIT_CLAIMED = 'C',
+	UNIT_DONE = 'D',
+} UnitState;
+
+
+typedef struct {
+	char state;
+	int pid;
+	char boot_id[BOOT_ID_LENGTH + 1];  // "-" when not claimed
+	long long nodes;
+	char moves[MOVES_FIELD_LENGTH + 1];
+} WorkUnit;
+
+
+typedef struct {
+	int fd;
+	char fen[128];
+	int depth;
+	int split_depth;
+	long long unit_count;
+	long long records_offset;  // Byte offset of the first record
+} Journal;
+
+
+/* First characters of the kernel's boot id, which tell claims made before a
+   reboot apart from ones by a live process that reused the pid */
+void read_boot_id(char* boot_id) {
+	strcpy(boot_id, "-");
+	FILE* file = fopen("/proc/sys/kernel/random/boot_id", "r");
+	if (!file) {
+		return;
+	}
+	char line[64];
+	if (fgets(line, sizeof(line), file) && strlen(line) > BOOT_ID_LENGTH) {
+		memcpy(boot_id, line, BOOT_ID_LENGTH);
+		boot_id[BOOT_ID_LENGTH] = 0;
+	}
+	fclose(file);
+}
+
+
+void format_unit(WorkUnit* unit_ptr, char* record) {
+	int length = snprintf(
+		record, RECORD_LENGTH + 1, "%c %10d %8s %20lld %-*s", unit_ptr->state, unit_ptr->pid,
+		unit_ptr->boot_id, unit_ptr->nodes, MOVES_FIELD_LENGTH, unit_ptr->moves
+	);
+	memset(record + length, ' ', RECORD_LENGTH - 1 - length);
+	record[RECORD_LENGTH - 1] = '\n';
+}
+
+
+bool parse_unit(char* record, WorkUnit* unit_ptr) {
+	int consumed = 0;
+	if (sscanf(record, "%c %d %8s %lld %n", &unit_ptr->state, &unit_ptr->pid, unit_ptr->boot_id, &unit_ptr->nodes, &consumed) != 4) {
+		return false;
+	}
+	int length = RECORD_LENGTH - 1 - consumed;
+	memcpy(unit_ptr->moves, record + consumed, length);
+	// Trim the padding
+	while (length > 0 && unit_ptr->moves[length - 1] == ' ') {
+		length--;
+	}
+	unit_ptr->moves[length] = 0;
+	return true;
+}
+
+
+bool write_unit(Journal* journal_ptr, long long index, WorkUnit* unit_ptr) {
+	char record[RECORD_LENGTH + 1];
+	format_unit(unit_ptr, record);
+	long long offset = journal_ptr->records_offset + index * RECORD_LENGTH;
+	return pwrite(journal_ptr->fd, record, RECORD_LENGTH, offset) == RECORD_LENGTH;
+}
+
+
+/* Collects every legal line of moves split_depth plies long. Lines that end
+   in mate or stalemate sooner have no leaves at full depth and are left out */
+void enumerate_units(Board* board_ptr, int ply, int split_depth, char* line, FILE* file, long long* count_ptr) {
+	if (ply == split_depth) {
+		WorkUnit unit = {.state = UNIT_PENDING, .boot_id = "-"};
+		strcpy(unit.moves, line + 1);
+		char record[RECORD_LENGTH + 1];
+		format_unit(&unit, record);
+		fwrite(record, 1, RECORD_LENGTH, file);
+		(*count_ptr)++;
+		return;
+	}
+
+	MoveList* move_list_ptr = push_move_list();
+	generate_pseudo_moves(move_list_ptr, board_ptr);
+	find_legal_moves(move_list_ptr, board_ptr);
+	int length = strlen(line);
+	for (int i = 0; i < move_list_ptr->move_count; i++) {
+		Move* move_ptr = &move_list_ptr->moves[i];
+		line[length] = ' ';
+		move_to_string(move_ptr, line + length + 1);
+
+		MoveUndo undo;
+		play_move(move_ptr, board_ptr, &undo);
+		enumerate_units(board_ptr, ply + 1, split_depth, line, file, count_ptr);
+		unplay_move(move_ptr, board_ptr, &undo);
+	}
+	line[length] = 0;
+	pop_move_list();
+}
+
+
+/* Writes the journal beside its final path and renames it into place, so a
+   worker never sees one half written */
+void init_journal(char* path, char* fen, int depth, int split_depth) {
+	if (split_depth < 1 || split_depth > MAX_SPLIT_DEPTH || depth <= split_depth) {
+		printf("Split depth must be between 1 and %d and below the perft depth\n", MAX_SPLIT_DEPTH);
+		return;
+	}
+	if (!validate_fen(fen)) {
+		printf("Invalid fen: %s\n", fen);
+		return;
+	}
+
+	char temporary_path[4096];
+	snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", path);
+	FILE* file = fopen(temporary_path, "w");
+	if (!file) {
+		printf("Could not create %s\n", temporary_path);
+		return;
+	}
+
+	Board board = {};
+	setup_board(&board, fen);
+
+	// The unit count goes in the header, so the header is rewritten at the end
+	fprintf(file, "perft-journal\nfen %s\ndepth %d\nsplit %d\nunits %20d\n", fen, depth, split_depth, 0);
+	long long records_offset = ftell(file);
+	long long count = 0;
+	char line[MAX_SPLIT_DEPTH * 6 + 2] = "";
+	enumerate_units(&board, 0, split_depth, line, file, &count);
+
+	fseek(file, 0, SEEK_SET);
+	fprintf(file, "perft-journal\nfen %s\ndepth %d\nsplit %d\nunits %20lld\n", fen, depth, split_depth, count);
+	if (ftell(file) != records_offset || fflush(file) != 0 || fsync(fileno(file)) != 0) {
+		printf("Could not write %s\n", temporary_path);
+		fclose(file);
+		return;
+	}
+	fclose(file);
+	rename(temporary_path, path);
+	printf("%lld units of depth %d written to %s\n", count, depth - split_depth, path);
+}
+
+
+bool open_journal(char* path, Journal* journal_ptr) {
+	journal_ptr->fd = open(path, O_RDWR);
+	if (journal_ptr->fd < 0) {
+		printf("Could not open %s\n", path);
+		return false;
+	}
+
+	char header[MAX_HEADER_LENGTH + 1];
+	int length = pread(journal_ptr->fd, header, MAX_HEADER_LENGTH, 0);
+	header[length > 0 ? length : 0] = 0;
+
+	// The header is exactly five lines
+	char* line_end = header;
+	for (int i = 0; i < 5 && line_end; i++) {
+		line_end = strchr(line_end, '\n');
+		line_end = line_end ? line_end + 1 : 0;
+	}
+	char* fen_line = strstr(header, "\nfen ");
+	if (strncmp(header, "perft-journal\n", 14) != 0 || !line_end || !fen_line) {
+		printf("%s is not a perft journal\n", path);
+		close(journal_ptr->fd);
+		return false;
+	}
+	journal_ptr->records_offset = line_end - header;
+
+	fen_line += strlen("\nfen ");
+	int fen_length = strcspn(fen_line, "\n");
+	snprintf(journal_ptr->fen, sizeof(journal_ptr->fen), "%.*s", fen_length, fen_line);
+	sscanf(strstr(header, "\ndepth ") + 1, "depth %d", &journal_ptr->depth);
+	sscanf(strstr(header, "\nsplit ") + 1, "split %d", &journal_ptr->split_depth);
+	sscanf(strstr(header, "\nunits ") + 1, "units %lld", &journal_ptr->unit_count);
+	return true;
+}
+
+
+bool is_stale_claim(WorkUnit* unit_ptr, char* boot_id) {
+	if (strcmp(unit_ptr->boot_id, boot_id) != 0) {
+		return true;
+	}
+	return kill(unit_ptr->pid, 0) != 0 && errno == ESRCH;
+}
+
+
+/* Marks the first pending or stale unit at or after start (wrapping round)
+   as claimed by this process. Returns its index, or -1 when none is left */
+long long claim_unit(Journal* journal_ptr, long long start, char* boot_id, WorkUnit* unit_ptr) {
+	long long claimed = -1;
+	flock(journal_ptr->fd, LOCK_EX);
+
+	static char chunk[SCAN_CHUNK * RECORD_LENGTH];
+	for (long long scanned = 0; scanned < journal_ptr->unit_count && claimed < 0;) {
+		long long first = (start + scanned) % journal_ptr->unit_count;
+		long long records = journal_ptr->unit_count - first;
+		if (records > SCAN_CHUNK) {
+			records = SCAN_CHUNK;
+		}
+		long long offset = journal_ptr->records_offset + first * RECORD_LENGTH;
+		if (pread(journal_ptr->fd, chunk, records * RECORD_LENGTH, offset) != records * RECORD_LENGTH) {
+			break;
+		}
+
+		for (long long i = 0; i < records; i++) {
+			WorkUnit unit;
+			if (!parse_unit(chunk + i * RECORD_LENGTH, &unit)) {
+				continue;
+			}
+			if (unit.state == UNIT_PENDING || (unit.state == UNIT_CLAIMED && is_stale_claim(&unit, boot_id))) {
+				unit.state = UNIT_CLAIMED;
+				unit.pid = getpid();
+				strcpy(unit.boot_id, boot_id);
+				if (write_unit(journal_ptr, first + i, &unit)) {
+					*unit_ptr = unit;
+					claimed = first + i;
+				}
+				break;
+			}
+		}
+		scanned += records;
+	}
+
+	flock(journal_ptr->fd, LOCK_UN);
+	return claimed;
+}
+
+
+long long run_unit(Journal* journal_ptr, WorkUnit* unit_ptr) {
+	Board board = {};
+	setup_board(&board, journal_ptr->fen);
+
+	char moves[MOVES_FIELD_LENGTH + 1];
+	strcpy(moves, unit_ptr->moves);
+	for (char* token = strtok(moves, " "); token; token = strtok(0, " ")) {
+		Move move;
+		if (!string_to_move(&board, token, &move)) {
+			return -1;
+		}
+		MoveUndo undo;
+		play_move(&move, &board, &undo);
+	}
+	return perft(&board, journal_ptr->depth - journal_ptr->split_depth);
+}
+
+
+/* Sums the finished units. Returns true when every unit is done */
+bool journal_status(Journal* journal_ptr, bool verbose) {
+	long long counts[3] = {};  // Pending, claimed, done
+	long long nodes = 0;
+
+	flock(journal_ptr->fd, LOCK_SH);
+	char record[RECORD_LENGTH];
+	for (long long i = 0; i < journal_ptr->unit_count; i++) {
+		long long offset = journal_ptr->records_offset + i * RECORD_LENGTH;
+		WorkUnit unit;
+		if (pread(journal_ptr->fd, record, RECORD_LENGTH, offset) != RECORD_LENGTH || !parse_unit(record, &unit)) {
+			continue;
+		}
+		if (unit.state == UNIT_DONE) {
+			counts[2]++;
+			nodes += unit.nodes;
+		}
+		else {
+			counts[unit.state == UNIT_CLAIMED ? 1 : 0]++;
+		}
+	}
+	flock(journal_ptr->fd, LOCK_UN);
+
+	bool complete = counts[2] == journal_ptr->unit_count;
+	if (verbose) {
+		printf("%s\n", journal_ptr->fen);
+		printf(
+			"[depth:%d] units: %lld done: %lld claimed: %lld pending: %lld nodes: %lld%s\n",
+			journal_ptr->depth, journal_ptr->unit_count, counts[2], counts[1], counts[0], nodes,
+			complete ? "" : " (partial)"
+		);
+	}
+	return complete;
+}
+
+
+/* Every worker that finishes after the last unit sees a complete journal,
+   so only the first of them to append the reported line prints the total */
+bool claim_report(Journal* journal_ptr) {
+	long long records_end = journal_ptr->records_offset + journal_ptr->unit_count * RECORD_LENGTH;
+	int length = strlen(REPORTED_LINE);
+	flock(journal_ptr->fd, LOCK_EX);
+	bool claimed = (
+		lseek(journal_ptr->fd, 0, SEEK_END) == records_end &&
+		pwrite(journal_ptr->fd, REPORTED_LINE, length, records_end) == length
+	);
+	flock(journal_ptr->fd, LOCK_UN);
+	return claimed;
+}
+
+
+/* Claims and completes units until none are left */
+void work_journal(Journal* journal_ptr) {
+	char boot_id[BOOT_ID_LENGTH + 1];
+	read_boot_id(boot_id);
+
+	// Start each process at a different place so they rarely contend
+	long long start = journal_ptr->unit_count ? getpid() % journal_ptr->unit_count : 0;
+	long long completed = 0;
+	WorkUnit unit;
+	long long index;
+	while ((index = claim_unit(journal_ptr, start, boot_id, &unit)) >= 0) {
+		unit.nodes = run_unit(journal_ptr, &unit);
+		if (unit.nodes < 0) {
+			printf("Unit %lld has an illegal move: %s\n", index, unit.moves);
+			return;
+		}
+		unit.state = UNIT_DONE;
+
+		flock(journal_ptr->fd, LOCK_EX);
+		bool written = write_unit(journal_ptr, index, &unit) && fdatasync(journal_ptr->fd) == 0;
+		flock(journal_ptr->fd, LOCK_UN);
+		if (!written) {
+			printf("Could not record unit %lld\n", index);
+			return;
+		}
+
+		completed++;
+		start = index + 1;
+	}
+	printf("Completed %lld units\n", completed);
+	if (journal_status(journal_ptr, false) && claim_report(journal_ptr)) {
+		journal_status(journal_ptr, true);
+	}
+}
+
+
+/* Usage:
+     splitperft init <journal> <depth> <split depth> [fen]
+     splitperft work <journal>
+     splitperft status <journal>
+   Run "work" in as many processes as there are cores. Each one exits when
+   no unit is left to claim, and one of them prints the total once every
+   unit is done */
+void run_split_perft(int argc, char** argv) {
+	if (argc >= 4 && strcmp(argv[0], "init") == 0) {
+		char* fen = argc >= 5 ? argv[4] : "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+		init_journal(argv[1], fen, atoi(argv[2]), atoi(argv[3]));
+		return;
+	}
+	if (argc < 2 || (strcmp(argv[0], "work") != 0 && strcmp(argv[0], "status") != 0)) {
+		printf("Usage: splitperft init <journal> <depth> <split depth> [fen] | work <journal> | status <journal>\n");
+		return;
+	}
+
+	Journal journal;
+	if (!open_journal(argv[1], &journal)) {
+		return;
+	}
+	if (strcmp(argv[0], "work") == 0) {
+		work_journal(&journal);
+	}
+	else {
+		journal_status(&journal, true);
+	}
+	close(journal.fd);
+}
@@ -0,0 +1,9 @@
+#ifndef SPLIT_PERFT_H
+#define SPLIT_PERFT_H
+
+
+/* FUNCTION DEFINITIONS */
+void run_split_perft(int argc, char** argv);
+
+
+#endif  /* SPLIT_PERFT_H */
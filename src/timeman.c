@@ -0,0 +1,104 @@
+#include <stdbool.h>  // for bool
+#include <time.h>  // for clock_gettime
+#include "chess.h"
+#include "timeman.h"
+
+
+#define MOVE_OVERHEAD 30  // Milliseconds kept back for communication lag
+#define DEFAULT_MOVES_TO_GO 30  // Assumed moves left when the clock has no movestogo
+
+
+long long current_time_ms() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+/* All times in milliseconds. With no time_left and no move_time the manager
+   stays inactive and only depth or node limits end the search */
+void init_time_manager(TimeManager* manager_ptr, int time_left, int increment, int moves_to_go, int move_time) {
+	manager_ptr->start_time = current_time_ms();
+	manager_ptr->active = false;
+	manager_ptr->last_best_move = (Move){NONE, NONE, QUIET_MOVE};
+	manager_ptr->last_score = 0;
+	manager_ptr->stable_iterations = 0;
+
+	if (move_time > 0) {
+		manager_ptr->active = true;
+		manager_ptr->soft_limit = move_time;
+		manager_ptr->hard_limit = move_time;
+		return;
+	}
+	if (time_left <= 0) {
+		return;
+	}
+
+	long long available = time_left - MOVE_OVERHEAD;
+	if (available < 1) {
+		available = 1;
+	}
+	int moves = moves_to_go > 0 && moves_to_go < DEFAULT_MOVES_TO_GO ? moves_to_go : DEFAULT_MOVES_TO_GO;
+
+	// Aim for an even share of the clock plus most of the increment, and
+	// allow overrunning it several times over when the search is unstable
+	long long soft_limit = available / moves + increment * 3 / 4;
+	long long hard_limit = soft_limit * 4;
+	long long hard_cap = moves == 1 ? available * 9 / 10 : available / 2;
+	if (hard_limit > hard_cap) {
+		hard_limit = hard_cap;
+	}
+	if (soft_limit > hard_limit) {
+		soft_limit = hard_limit;
+	}
+
+	manager_ptr->active = true;
+	manager_ptr->soft_limit = soft_limit;
+	manager_ptr->hard_limit = hard_limit;
+}
+
+
+long long elapsed_time_ms(TimeManager* manager_ptr) {
+	return current_time_ms() - manager_ptr->start_time;
+}
+
+
+bool hard_limit_reached(TimeManager* manager_ptr) {
+	return manager_ptr->active && elapsed_time_ms(manager_ptr) >= manager_ptr->hard_limit;
+}
+
+
+/* Called after every completed iteration. The soft limit shrinks while the
+   best move stays the same and grows when it changes or the score drops */
+bool soft_limit_reached(TimeManager* manager_ptr, Move* best_move_ptr, int score) {
+	// Percentage of the soft limit to use, by number of stable iterations
+	static const int stability_scale[5] = {250, 120, 90, 80, 70};
+
+	Move* last_ptr = &manager_ptr->last_best_move;
+	if (last_ptr->from == best_move_ptr->from && last_ptr->to == best_move_ptr->to && last_ptr->type == best_move_ptr->type) {
+		if (manager_ptr->stable_iterations < 4) {
+			manager_ptr->stable_iterations++;
+		}
+	}
+	else {
+		manager_ptr->stable_iterations = 0;
+	}
+
+	int scale = stability_scale[manager_ptr->stable_iterations];
+	int score_drop = manager_ptr->last_score - score;
+	if (last_ptr->from != NONE && score_drop > 20) {
+		scale += score_drop > 100 ? 100 : score_drop;
+	}
+
+	manager_ptr->last_best_move = *best_move_ptr;
+	manager_ptr->last_score = score;
+
+	if (!manager_ptr->active) {
+		return false;
+	}
+	long long limit = manager_ptr->soft_limit * scale / 100;
+	if (limit > manager_ptr->hard_limit) {
+		limit = manager_ptr->hard_limit;
+	}
+	return elapsed_time_ms(manager_ptr) >= limit;
+}
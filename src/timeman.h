@@ -0,0 +1,33 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+
+#include <stdbool.h>  // for bool
+#include "chess.h"
+
+
+#define TIME_CHECK_INTERVAL 2048  // Nodes between clock reads, must be a power of two
+
+
+typedef struct {
+	bool active;
+	long long start_time;  // Milliseconds, monotonic
+	long long soft_limit;  // Don't start another iteration after this
+	long long hard_limit;  // Abort the search after this
+
+	// Iteration history used to scale the soft limit
+	Move last_best_move;
+	int last_score;
+	int stable_iterations;
+} TimeManager;
+
+
+/* FUNCTION DEFINITIONS */
+long long current_time_ms();
+void init_time_manager(TimeManager* manager_ptr, int time_left, int increment, int moves_to_go, int move_time);
+long long elapsed_time_ms(TimeManager* manager_ptr);
+bool hard_limit_reached(TimeManager* manager_ptr);
+bool soft_limit_reached(TimeManager* manager_ptr, Move* best_move_ptr, int score);
+
+
+#endif  /* TIMEMAN_H */
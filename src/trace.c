@@ -0,0 +1,196 @@
+#include <stdbool.h>  // for bool
+#include <stdio.h>  // for fopen, fread, fwrite, fclose, printf and snprintf
+#include <stdlib.h>  // for malloc and free
+#include <string.h>  // for memcmp and memcpy
+#include "chess.h"
+#include "trace.h"
+
+
+/*
+ * Search trace recorder. A search given a SearchTrace writes one TraceEvent
+ * per node into the trace's buffer, and the buffer goes to the file in one
+ * write whenever it fills up. Searches without one only pay a null check per
+ * node. The report reads a trace back and summarises, per remaining depth,
+ * how many moves were searched, how often the first move failed high and how
+ * far down the list cutoffs happened.
+ */
+
+
+#define TRACE_MAGIC "CHESSTRC"
+#define TRACE_MAX_DEPTH 64
+#define TRACE_MAX_ITERATIONS 128  // Covers every depth an int8_t can hold
+
+
+bool trace_open(SearchTrace* trace_ptr, char* path) {
+	trace_ptr->count = 0;
+	trace_ptr->written = 0;
+	trace_ptr->file = fopen(path, "wb");
+	if (!trace_ptr->file) {
+		return false;
+	}
+	trace_ptr->events = malloc(TRACE_BUFFER_EVENTS * sizeof(TraceEvent));
+	if (!trace_ptr->events) {
+		fclose(trace_ptr->file);
+		return false;
+	}
+
+	TraceHeader header = {.version = TRACE_VERSION, .event_bytes = sizeof(TraceEvent)};
+	memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	fwrite(&header, sizeof(header), 1, trace_ptr->file);
+	return true;
+}
+
+
+void trace_flush(SearchTrace* trace_ptr) {
+	fwrite(trace_ptr->events, sizeof(TraceEvent), trace_ptr->count, trace_ptr->file);
+	trace_ptr->written += trace_ptr->count;
+	trace_ptr->count = 0;
+}
+
+
+void trace_close(SearchTrace* trace_ptr) {
+	trace_flush(trace_ptr);
+	fclose(trace_ptr->file);
+	free(trace_ptr->events);
+	trace_ptr->events = 0;
+	trace_ptr->file = 0;
+}
+
+
+typedef struct {
+	long long nodes;
+	long long moves;  // Summed over nodes that searched any
+	long long searched_nodes;
+	long long tt_hits;
+	long long tt_cutoffs;
+	long long pruned;  // Null move and reverse futility cutoffs
+	long long cutoffs;
+	long long first_move_cutoffs;
+	long long cutoff_index_sum;
+	long long best_index_sum;  // Over nodes where a move raised alpha without failing high
+	long long pv_nodes;
+} DepthStats;
+
+
+void add_event(DepthStats* stats_ptr, TraceEvent* event_ptr) {
+	stats_ptr->nodes++;
+	stats_ptr->tt_hits += (event_ptr->flags & TRACE_TT_HIT) != 0;
+	if (event_ptr->flags & TRACE_TT_CUTOFF) {
+		stats_ptr->tt_cutoffs++;
+		return;
+	}
+	if (event_ptr->flags & (TRACE_NULL_CUTOFF | TRACE_PRUNED)) {
+		stats_ptr->pruned++;
+		return;
+	}
+	if (event_ptr->legal_moves) {
+		stats_ptr->searched_nodes++;
+		stats_ptr->moves += event_ptr->legal_moves;
+	}
+	if (event_ptr->cutoff_index) {
+		stats_ptr->cutoffs++;
+		stats_ptr->first_move_cutoffs += event_ptr->cutoff_index == 1;
+		stats_ptr->cutoff_index_sum += event_ptr->cutoff_index;
+	}
+	else if (event_ptr->best_index) {
+		stats_ptr->pv_nodes++;
+		stats_ptr->best_index_sum += event_ptr->best_index;
+	}
+}
+
+
+double ratio(long long part, long long whole) {
+	return whole ? (double)part / whole : 0.0;
+}
+
+
+void print_depth_stats(char* label, DepthStats* stats_ptr) {
+	printf(
+		"%5s %12lld %6.1f%% %6.1f%% %6.1f%% %7.2f %6.1f%% %6.2f %6.2f\n", label, stats_ptr->nodes,
+		100 * ratio(stats_ptr->tt_hits, stats_ptr->nodes), 100 * ratio(stats_ptr->tt_cutoffs, stats_ptr->nodes),
+		100 * ratio(stats_ptr->pruned, stats_ptr->nodes), ratio(stats_ptr->moves, stats_ptr->searched_nodes),
+		100 * ratio(stats_ptr->first_move_cutoffs, stats_ptr->cutoffs),
+		ratio(stats_ptr->cutoff_index_sum, stats_ptr->cutoffs), ratio(stats_ptr->best_index_sum, stats_ptr->pv_nodes)
+	);
+}
+
+
+/* trace <file>. Nodes are counted per iteration between the markers, so the
+   effective branching factor compares one iteration with the one before */
+void run_trace_report(int argc, char** argv) {
+	if (argc < 1) {
+		printf("usage: trace <file>\n");
+		return;
+	}
+	FILE* file = fopen(argv[0], "rb");
+	if (!file) {
+		printf("could not open %s\n", argv[0]);
+		return;
+	}
+	TraceHeader header;
+	if (
+		fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != TRACE_VERSION || header.event_bytes != sizeof(TraceEvent)
+	) {
+		printf("%s is not a trace this build can read\n", argv[0]);
+		fclose(file);
+		return;
+	}
+
+	static DepthStats depth_stats[TRACE_MAX_DEPTH + 1];  // Quiescence at index 0
+	static long long iteration_nodes[TRACE_MAX_ITERATIONS];
+	static int iteration_searches[TRACE_MAX_ITERATIONS];
+	DepthStats total = {};
+	long long events = 0, searches = 0, since_marker = 0;
+
+	TraceEvent* buffer = malloc(TRACE_BUFFER_EVENTS * sizeof(TraceEvent));
+	size_t read;
+	while ((read = fread(buffer, sizeof(TraceEvent), TRACE_BUFFER_EVENTS, file)) > 0) {
+		for (size_t i = 0; i < read; i++) {
+			TraceEvent* event_ptr = &buffer[i];
+			if (event_ptr->flags & TRACE_NEW_SEARCH) {
+				searches++;
+				since_marker = 0;
+				continue;
+			}
+			if (event_ptr->flags & TRACE_ITERATION) {
+				if (event_ptr->depth > 0) {
+					iteration_nodes[event_ptr->depth] += since_marker;
+					iteration_searches[event_ptr->depth]++;
+				}
+				since_marker = 0;
+				continue;
+			}
+			events++;
+			since_marker++;
+			int depth = event_ptr->flags & TRACE_QUIESCENCE || event_ptr->depth < 0 ? 0 : event_ptr->depth;
+			add_event(&depth_stats[depth > TRACE_MAX_DEPTH ? TRACE_MAX_DEPTH : depth], event_ptr);
+			add_event(&total, event_ptr);
+		}
+	}
+	free(buffer);
+	fclose(file);
+
+	printf("%lld nodes over %lld searches\n\n", events, searches);
+	printf("%5s %12s %7s %7s %7s %7s %7s %6s %6s\n", "depth", "nodes", "tt hit", "tt cut", "pruned", "moves", "first", "cutidx", "bestidx");
+	char label[8];
+	for (int depth = TRACE_MAX_DEPTH; depth >= 0; depth--) {
+		if (depth_stats[depth].nodes) {
+			snprintf(label, sizeof(label), depth ? "%d" : "q", depth);
+			print_depth_stats(label, &depth_stats[depth]);
+		}
+	}
+	print_depth_stats("all", &total);
+
+	// Iterations that only some searches completed are compared as averages
+	printf("\n%5s %12s %6s\n", "iter", "nodes", "ebf");
+	double previous = 0;
+	for (int depth = 1; depth < TRACE_MAX_ITERATIONS; depth++) {
+		if (!iteration_searches[depth]) {
+			continue;
+		}
+		double average = (double)iteration_nodes[depth] / iteration_searches[depth];
+		printf("%5d %12.0f %6.2f\n", depth, average, previous > 0 ? average / previous : 0.0);
+		previous = average;
+	}
+}
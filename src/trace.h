@@ -0,0 +1,74 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+
+#include <stdbool.h>  // for bool
+#include <stdint.h>  // for int8_t, int16_t, uint8_t, uint16_t and uint32_t
+#include <stdio.h>  // for FILE
+#include "chess.h"
+
+
+#define TRACE_BUFFER_EVENTS 65536  // Events a search thread holds before writing them out
+#define TRACE_VERSION 1
+
+
+typedef enum {
+	TRACE_TT_HIT = 1,
+	TRACE_TT_CUTOFF = 2,  // Returned the table's score without searching
+	TRACE_QUIESCENCE = 4,
+	TRACE_NULL_CUTOFF = 8,
+	TRACE_PRUNED = 16,  // Reverse futility pruning
+	TRACE_ITERATION = 32,  // Marker after each completed iteration at the root
+	TRACE_NEW_SEARCH = 64,  // Marker at the start of a search
+} TraceFlag;
+
+
+/* One searched node, written when the node returns */
+typedef struct {
+	uint16_t move;  // Best move, from | to << 6 | type << 12, 0 for none
+	int16_t alpha;  // Window on entry
+	int16_t beta;
+	int16_t score;
+	uint8_t ply;
+	int8_t depth;  // Remaining depth, the iteration's depth for markers
+	uint8_t legal_moves;  // Moves searched
+	uint8_t cutoff_index;  // Position of the move that failed high counting from 1, 0 for none
+	uint8_t best_index;  // Position of the move that last raised alpha, 0 for none
+	uint8_t flags;  // TraceFlag bits
+	uint16_t unused;
+} TraceEvent;
+
+
+typedef struct {
+	char magic[8];  // "CHESSTRC"
+	uint32_t version;
+	uint32_t event_bytes;
+} TraceHeader;
+
+
+/* Owned by one search thread, so recording takes no locks */
+typedef struct {
+	TraceEvent* events;
+	int count;
+	FILE* file;
+	long long written;
+} SearchTrace;
+
+
+/* FUNCTION DEFINITIONS */
+bool trace_open(SearchTrace* trace_ptr, char* path);
+void trace_flush(SearchTrace* trace_ptr);
+void trace_close(SearchTrace* trace_ptr);
+void run_trace_report(int argc, char** argv);
+
+
+/* Slot for the next event, writing the buffer out first when it is full */
+ALWAYS_INLINE TraceEvent* next_trace_event(SearchTrace* trace_ptr) {
+	if (trace_ptr->count == TRACE_BUFFER_EVENTS) {
+		trace_flush(trace_ptr);
+	}
+	return &trace_ptr->events[trace_ptr->count++];
+}
+
+
+#endif  /* TRACE_H */
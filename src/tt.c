@@ -0,0 +1,527 @@
+#define _GNU_SOURCE  // for MAP_HUGETLB and MADV_HUGEPAGE
+#include <fcntl.h>  // for open
+#include <pthread.h>  // for pthread_create and pthread_join
+#include <stdbool.h>  // for bool
+#include <stdint.h>  // for uint64_t
+#include <stdio.h>  // for fopen, fgets and printf
+#include <stdlib.h>  // for atoi, atoll and strtol
+#include <string.h>  // for memcmp, memset, strcmp and strcpy
+#include <sys/mman.h>  // for mmap, madvise and munmap
+#include <sys/stat.h>  // for fstat
+#include <sys/syscall.h>  // for SYS_mbind
+#include <unistd.h>  // for access, close, ftruncate, pread, pwrite and syscall
+#include "chess.h"
+#include "search.h"
+#include "tt.h"
+#include "zobrist.h"
+
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define MPOL_INTERLEAVE 3  // From linux/mempolicy.h, which is not always installed
+#define MAX_NUMA_NODES 64
+#define TT_FILE_MAGIC "CHESSTT"
+#define DEFAULT_TT_FILE_MB 256
+#define MIN_CLEAR_CHUNK (16 * 1024 * 1024)  // Smaller tables are not worth a thread each
+
+
+/* Layout of the data word: move 0-15, score 16-31, depth 32-39, bound 40-41,
+   age 48-55 */
+uint64_t pack_entry(Move* move_ptr, int score, int depth, Bound bound, uint8_t age) {
+	return (
+		pack_move(move_ptr) | (uint64_t)(uint16_t)(int16_t)score << 16 |
+		(uint64_t)(uint8_t)depth << 32 | (uint64_t)bound << 40 | (uint64_t)age << 48
+	);
+}
+
+
+int entry_depth(uint64_t data) {
+	return (data >> 32) & 0xFF;
+}
+
+
+uint8_t entry_age(uint64_t data) {
+	return (data >> 48) & 0xFF;
+}
+
+
+/* Parses /sys/devices/system/node/online, e.g. "0-1,3", into a bit mask */
+unsigned long online_numa_nodes() {
+	unsigned long mask = 0;
+	FILE* file = fopen("/sys/devices/system/node/online", "r");
+	if (!file) {
+		return 0;
+	}
+	char line[256];
+	if (fgets(line, sizeof(line), file)) {
+		char* position = line;
+		while (*position >= '0' && *position <= '9') {
+			long first = strtol(position, &position, 10);
+			long last = first;
+			if (*position == '-') {
+				last = strtol(position + 1, &position, 10);
+			}
+			for (long node = first; node <= last && node < MAX_NUMA_NODES; node++) {
+				mask |= 1UL << node;
+			}
+			if (*position == ',') {
+				position++;
+			}
+		}
+	}
+	fclose(file);
+	return mask;
+}
+
+
+/* Spreads pages round robin over every NUMA node so no single memory
+   controller serves the whole table. Silently does nothing on failure */
+void interleave_memory(void* memory, size_t bytes) {
+	unsigned long nodes = online_numa_nodes();
+	// Only worth it with more than one node
+	if (nodes & (nodes - 1)) {
+		syscall(SYS_mbind, memory, bytes, MPOL_INTERLEAVE, &nodes, MAX_NUMA_NODES, 0);
+	}
+}
+
+
+/* Tries explicit huge pages first, then transparent huge pages, then plain
+   pages. Returns 0 if no memory could be mapped at all */
+void* allocate_tt_memory(size_t bytes, bool* huge_pages_ptr) {
+	*huge_pages_ptr = false;
+#ifdef MAP_HUGETLB
+	if (bytes % HUGE_PAGE_SIZE == 0) {
+		void* memory = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (memory != MAP_FAILED) {
+			*huge_pages_ptr = true;
+			return memory;
+		}
+	}
+#endif
+
+	void* memory = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		return 0;
+	}
+#ifdef MADV_HUGEPAGE
+	madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+	return memory;
+}
+
+
+typedef struct {
+	char* start;
+	size_t bytes;
+} ClearJob;
+
+
+void* clear_tt_chunk(void* arg) {
+	ClearJob* job_ptr = arg;
+	memset(job_ptr->start, 0, job_ptr->bytes);
+	return 0;
+}
+
+
+/* Zeroes the table from several threads at once. The first write to a page
+   decides which NUMA node it lives on, so this also spreads it out */
+void tt_clear(TranspositionTable* tt_ptr, int threads) {
+	if (threads > (int)(tt_ptr->size_bytes / MIN_CLEAR_CHUNK)) {
+		threads = tt_ptr->size_bytes / MIN_CLEAR_CHUNK;
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+	pthread_t workers[threads];
+	ClearJob jobs[threads];
+
+	size_t chunk = tt_ptr->size_bytes / threads;
+	for (int i = 0; i < threads; i++) {
+		jobs[i].start = (char*)tt_ptr->buckets + chunk * i;
+		jobs[i].bytes = i == threads - 1 ? tt_ptr->size_bytes - chunk * i : chunk;
+		if (i > 0) {
+			pthread_create(&workers[i], 0, clear_tt_chunk, &jobs[i]);
+		}
+	}
+	clear_tt_chunk(&jobs[0]);
+	for (int i = 1; i < threads; i++) {
+		pthread_join(workers[i], 0);
+	}
+	tt_ptr->age = 0;
+	if (tt_ptr->file_header_ptr) {
+		tt_ptr->file_header_ptr->age = 0;
+	}
+}
+
+
+/* Largest power of two number of buckets that fits in the size */
+size_t table_bucket_count(size_t megabytes) {
+	size_t bytes = megabytes * 1024 * 1024;
+	size_t bucket_count = 1;
+	while (bucket_count * 2 * sizeof(TTBucket) <= bytes) {
+		bucket_count *= 2;
+	}
+	return bucket_count;
+}
+
+
+/* Rounds the size down to a power of two number of buckets. Returns false
+   if the memory could not be allocated */
+bool tt_init(TranspositionTable* tt_ptr, size_t megabytes, int threads, bool interleave) {
+	size_t bucket_count = table_bucket_count(megabytes);
+	tt_ptr->size_bytes = bucket_count * sizeof(TTBucket);
+	tt_ptr->bucket_mask = bucket_count - 1;
+	tt_ptr->file_header_ptr = 0;
+	tt_ptr->buckets = allocate_tt_memory(tt_ptr->size_bytes, &tt_ptr->huge_pages);
+	if (!tt_ptr->buckets) {
+		tt_ptr->size_bytes = 0;
+		return false;
+	}
+
+	if (interleave) {
+		interleave_memory(tt_ptr->buckets, tt_ptr->size_bytes);
+	}
+	tt_clear(tt_ptr, threads);
+	return true;
+}
+
+
+/* A file backed table is written back by the kernel after the unmap */
+void tt_free(TranspositionTable* tt_ptr) {
+	if (tt_ptr->file_header_ptr) {
+		munmap(tt_ptr->file_header_ptr, TT_FILE_HEADER_BYTES + tt_ptr->size_bytes);
+	}
+	else if (tt_ptr->buckets) {
+		munmap(tt_ptr->buckets, tt_ptr->size_bytes);
+	}
+	tt_ptr->buckets = 0;
+	tt_ptr->file_header_ptr = 0;
+	tt_ptr->size_bytes = 0;
+}
+
+
+void tt_new_search(TranspositionTable* tt_ptr) {
+	tt_ptr->age++;
+	if (tt_ptr->file_header_ptr) {
+		tt_ptr->file_header_ptr->age = tt_ptr->age;
+	}
+}
+
+
+/* Mate scores are stored relative to the node rather than the root */
+bool tt_probe(TranspositionTable* tt_ptr, uint64_t hash, int ply, TTHit* hit_ptr) {
+	TTBucket* bucket_ptr = &tt_ptr->buckets[hash & tt_ptr->bucket_mask];
+	for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+		TTEntry* entry_ptr = &bucket_ptr->entries[i];
+		uint64_t data = entry_ptr->data;
+		if ((entry_ptr->key_xor_data ^ data) != hash || data == 0) {
+			continue;
+		}
+
+		hit_ptr->move = unpack_move(data & 0xFFFF);
+		hit_ptr->score = (int16_t)((data >> 16) & 0xFFFF);
+		hit_ptr->depth = entry_depth(data);
+		hit_ptr->bound = (data >> 40) & 3;
+		if (hit_ptr->score >= MATE_BOUND) {
+			hit_ptr->score -= ply;
+		}
+		else if (hit_ptr->score <= -MATE_BOUND) {
+			hit_ptr->score += ply;
+		}
+		return true;
+	}
+	return false;
+}
+
+
+/* How much an entry is worth keeping, empty entries least of all */
+int replacement_value(TranspositionTable* tt_ptr, uint64_t data) {
+	if (data == 0) {
+		return -(1 << 30);
+	}
+	int age_distance = (uint8_t)(tt_ptr->age - entry_age(data));
+	return entry_depth(data) - 8 * age_distance;
+}
+
+
+/* The entry for this position, otherwise the shallowest and oldest one */
+TTEntry* replacement_entry(TranspositionTable* tt_ptr, TTBucket* bucket_ptr, uint64_t hash) {
+	TTEntry* replace_ptr = &bucket_ptr->entries[0];
+	int replace_value = 1 << 30;
+	for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+		TTEntry* entry_ptr = &bucket_ptr->entries[i];
+		uint64_t data = entry_ptr->data;
+		if ((entry_ptr->key_xor_data ^ data) == hash) {
+			return entry_ptr;
+		}
+		int value = replacement_value(tt_ptr, data);
+		if (value < replace_value) {
+			replace_value = value;
+			replace_ptr = entry_ptr;
+		}
+	}
+	return replace_ptr;
+}
+
+
+void tt_store(TranspositionTable* tt_ptr, uint64_t hash, Move* move_ptr, int score, int depth, Bound bound, int ply) {
+	TTBucket* bucket_ptr = &tt_ptr->buckets[hash & tt_ptr->bucket_mask];
+	TTEntry* replace_ptr = replacement_entry(tt_ptr, bucket_ptr, hash);
+
+	// Keep the old best move rather than lose it to a node that had none
+	Move move = *move_ptr;
+	uint64_t old_data = replace_ptr->data;
+	if (move.from == NONE && (replace_ptr->key_xor_data ^ old_data) == hash) {
+		move = unpack_move(old_data & 0xFFFF);
+	}
+
+	if (score >= MATE_BOUND) {
+		score += ply;
+	}
+	else if (score <= -MATE_BOUND) {
+		score -= ply;
+	}
+
+	uint64_t data = pack_entry(&move, score, depth, bound, tt_ptr->age);
+	replace_ptr->key_xor_data = hash ^ data;
+	replace_ptr->data = data;
+}
+
+
+uint64_t fold_keys(uint64_t fingerprint, const uint64_t* keys, int count) {
+	for (int i = 0; i < count; i++) {
+		fingerprint = (fingerprint << 7 | fingerprint >> 57) ^ keys[i];
+	}
+	return fingerprint;
+}
+
+
+void fill_file_header(TTFileHeader* header_ptr, uint64_t bucket_count) {
+	memset(header_ptr, 0, sizeof(TTFileHeader));
+	strcpy(header_ptr->magic, TT_FILE_MAGIC);
+	header_ptr->version = TT_FILE_VERSION;
+	header_ptr->bucket_bytes = sizeof(TTBucket);
+	uint64_t fingerprint = fold_keys(0, &zobrist_piece_keys[0][0][0], 2 * 6 * 64);
+	fingerprint = fold_keys(fingerprint, &zobrist_castling_keys[0][0], 2 * 2);
+	fingerprint = fold_keys(fingerprint, zobrist_en_passant_keys, 8);
+	header_ptr->key_scheme = fold_keys(fingerprint, &zobrist_side_key, 1);
+	header_ptr->bucket_count = bucket_count;
+}
+
+
+bool valid_file_header(TTFileHeader* header_ptr, size_t file_bytes) {
+	TTFileHeader expected;
+	fill_file_header(&expected, header_ptr->bucket_count);
+	uint64_t bucket_count = header_ptr->bucket_count;
+	return (
+		memcmp(header_ptr->magic, expected.magic, sizeof(expected.magic)) == 0 &&
+		header_ptr->version == expected.version &&
+		header_ptr->bucket_bytes == expected.bucket_bytes &&
+		header_ptr->key_scheme == expected.key_scheme &&
+		bucket_count > 0 && (bucket_count & (bucket_count - 1)) == 0 &&
+		file_bytes == TT_FILE_HEADER_BYTES + bucket_count * sizeof(TTBucket)
+	);
+}
+
+
+/* Opens a file whose header is checked into header_ptr. Returns -1 if it
+   cannot be read or is not a table this build can use */
+int open_table_file(char* path, int flags, TTFileHeader* header_ptr, size_t* file_bytes_ptr) {
+	int file = open(path, flags, 0644);
+	if (file < 0) {
+		return -1;
+	}
+	struct stat file_stat;
+	if (fstat(file, &file_stat) != 0) {
+		close(file);
+		return -1;
+	}
+	*file_bytes_ptr = file_stat.st_size;
+	if (*file_bytes_ptr == 0 && (flags & O_CREAT)) {
+		return file;
+	}
+	if (pread(file, header_ptr, sizeof(TTFileHeader), 0) != sizeof(TTFileHeader) || !valid_file_header(header_ptr, *file_bytes_ptr)) {
+		close(file);
+		return -1;
+	}
+	return file;
+}
+
+
+/* Backs a freed or never initialised table with a file, so its entries
+   survive the process. An existing file keeps its own size, otherwise one of
+   megabytes is created */
+TTFileStatus tt_open_file(TranspositionTable* tt_ptr, char* path, size_t megabytes) {
+	TTFileHeader header;
+	size_t file_bytes;
+	int file = open_table_file(path, O_RDWR | O_CREAT, &header, &file_bytes);
+	if (file < 0) {
+		// Tell a file we could not open apart from one we refuse
+		int existing = open(path, O_RDONLY);
+		if (existing < 0) {
+			return TT_FILE_ERROR;
+		}
+		close(existing);
+		return TT_FILE_INVALID;
+	}
+
+	TTFileStatus status = TT_FILE_LOADED;
+	if (file_bytes == 0) {
+		// Sized sparsely, so only pages that are written take disk space
+		status = TT_FILE_CREATED;
+		fill_file_header(&header, table_bucket_count(megabytes));
+		file_bytes = TT_FILE_HEADER_BYTES + header.bucket_count * sizeof(TTBucket);
+		if (ftruncate(file, file_bytes) != 0 || pwrite(file, &header, sizeof(header), 0) != sizeof(header)) {
+			close(file);
+			return TT_FILE_ERROR;
+		}
+	}
+
+	void* memory = mmap(0, file_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file);
+	if (memory == MAP_FAILED) {
+		return TT_FILE_ERROR;
+	}
+	madvise(memory, file_bytes, MADV_RANDOM);
+
+	tt_ptr->file_header_ptr = memory;
+	tt_ptr->buckets = (TTBucket*)((char*)memory + TT_FILE_HEADER_BYTES);
+	tt_ptr->bucket_mask = header.bucket_count - 1;
+	tt_ptr->size_bytes = header.bucket_count * sizeof(TTBucket);
+	tt_ptr->huge_pages = false;
+	tt_ptr->age = header.age;
+	return status;
+}
+
+
+/* Adds the entries of another table file, keeping whichever is worth more
+   where both want the same slot. Ages are carried over relative to each
+   table's own age. Returns the entries taken, or -1 if the file is not a
+   usable table */
+long long tt_merge_file(TranspositionTable* tt_ptr, char* path) {
+	TTFileHeader header;
+	size_t file_bytes;
+	int file = open_table_file(path, O_RDONLY, &header, &file_bytes);
+	if (file < 0) {
+		return -1;
+	}
+	void* memory = mmap(0, file_bytes, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (memory == MAP_FAILED) {
+		return -1;
+	}
+	madvise(memory, file_bytes, MADV_SEQUENTIAL);
+
+	TTBucket* buckets = (TTBucket*)((char*)memory + TT_FILE_HEADER_BYTES);
+	long long merged = 0;
+	for (uint64_t i = 0; i < header.bucket_count; i++) {
+		for (int j = 0; j < TT_BUCKET_SIZE; j++) {
+			uint64_t data = buckets[i].entries[j].data;
+			uint64_t hash = buckets[i].entries[j].key_xor_data ^ data;
+			// A torn entry gives a key that does not belong in this bucket
+			if (data == 0 || (hash & (header.bucket_count - 1)) != i) {
+				continue;
+			}
+			uint8_t age = tt_ptr->age - (uint8_t)(header.age - entry_age(data));
+			data = (data & ~(0xFFULL << 48)) | (uint64_t)age << 48;
+
+			TTEntry* entry_ptr = replacement_entry(tt_ptr, &tt_ptr->buckets[hash & tt_ptr->bucket_mask], hash);
+			if (replacement_value(tt_ptr, entry_ptr->data) > replacement_value(tt_ptr, data)) {
+				continue;
+			}
+			entry_ptr->key_xor_data = hash ^ data;
+			entry_ptr->data = data;
+			merged++;
+		}
+	}
+	munmap(memory, file_bytes);
+	return merged;
+}
+
+
+/* Empties every entry not written in the last max_age searches. Returns how
+   many were dropped */
+long long tt_age_entries(TranspositionTable* tt_ptr, int max_age) {
+	long long dropped = 0;
+	for (uint64_t i = 0; i <= tt_ptr->bucket_mask; i++) {
+		for (int j = 0; j < TT_BUCKET_SIZE; j++) {
+			TTEntry* entry_ptr = &tt_ptr->buckets[i].entries[j];
+			if (entry_ptr->data && (uint8_t)(tt_ptr->age - entry_age(entry_ptr->data)) > max_age) {
+				entry_ptr->key_xor_data = 0;
+				entry_ptr->data = 0;
+				dropped++;
+			}
+		}
+	}
+	return dropped;
+}
+
+
+long long tt_count_entries(TranspositionTable* tt_ptr) {
+	long long entries = 0;
+	for (uint64_t i = 0; i <= tt_ptr->bucket_mask; i++) {
+		for (int j = 0; j < TT_BUCKET_SIZE; j++) {
+			entries += tt_ptr->buckets[i].entries[j].data != 0;
+		}
+	}
+	return entries;
+}
+
+
+/*
+ * Maintenance of table files between analysis sessions:
+ *   ttfile info <file>
+ *   ttfile merge <file> <other file>... [hash MB]   creates <file> if needed
+ *   ttfile age <file> <searches>                    drops older entries
+ */
+void run_tt_file(int argc, char** argv) {
+	if (argc < 2 || (strcmp(argv[0], "info") != 0 && strcmp(argv[0], "merge") != 0 && strcmp(argv[0], "age") != 0)) {
+		printf("usage: ttfile info <file> | merge <file> <other>... [hash MB] | age <file> <searches>\n");
+		return;
+	}
+	if (strcmp(argv[0], "merge") != 0 && access(argv[1], F_OK) != 0) {
+		printf("could not open %s\n", argv[1]);
+		return;
+	}
+	size_t megabytes = DEFAULT_TT_FILE_MB;
+	for (int i = 2; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "hash") == 0) {
+			megabytes = atoll(argv[i + 1]);
+		}
+	}
+
+	TranspositionTable tt = {};
+	TTFileStatus status = tt_open_file(&tt, argv[1], megabytes);
+	if (status == TT_FILE_INVALID) {
+		printf("%s is not a table file this engine can use\n", argv[1]);
+		return;
+	}
+	if (status == TT_FILE_ERROR) {
+		printf("could not open %s\n", argv[1]);
+		return;
+	}
+
+	if (strcmp(argv[0], "merge") == 0) {
+		for (int i = 2; i < argc; i++) {
+			if (strcmp(argv[i], "hash") == 0) {
+				i++;
+				continue;
+			}
+			long long merged = tt_merge_file(&tt, argv[i]);
+			if (merged < 0) {
+				printf("skipped %s, not a table file this engine can use\n", argv[i]);
+			}
+			else {
+				printf("merged %lld entries from %s\n", merged, argv[i]);
+			}
+		}
+	}
+	else if (strcmp(argv[0], "age") == 0 && argc > 2) {
+		printf("dropped %lld entries\n", tt_age_entries(&tt, atoi(argv[2])));
+	}
+
+	printf(
+		"%s: %zu MB, %lld entries, age %d%s\n", argv[1], tt.size_bytes / (1024 * 1024),
+		tt_count_entries(&tt), tt.age, status == TT_FILE_CREATED ? ", created" : ""
+	);
+	tt_free(&tt);
+}
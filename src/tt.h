@@ -0,0 +1,100 @@
+#ifndef TT_H
+#define TT_H
+
+
+#include <stdbool.h>  // for bool
+#include <stddef.h>  // for size_t
+#include <stdint.h>  // for uint64_t
+#include "chess.h"
+
+
+#define TT_BUCKET_SIZE 4  // Entries per 64 byte cache line
+#define TT_FILE_VERSION 1
+#define TT_FILE_HEADER_BYTES 4096  // A whole page, so the buckets after it stay aligned
+
+
+typedef enum {
+	BOUND_NONE,
+	BOUND_UPPER,  // Score is at most this (failed low)
+	BOUND_LOWER,  // Score is at least this (failed high)
+	BOUND_EXACT,
+} Bound;
+
+
+/* The data word is stored xor'ed into the key, so an entry torn by two
+   threads writing at once fails the key check instead of being trusted */
+typedef struct {
+	uint64_t key_xor_data;
+	uint64_t data;
+} TTEntry;
+
+
+typedef struct {
+	TTEntry entries[TT_BUCKET_SIZE];
+} __attribute__((aligned(64))) TTBucket;
+
+
+/* Start of a table file. Entries written by another engine, layout or set
+   of Zobrist keys would give wrong hits, so such files are refused */
+typedef struct {
+	char magic[8];  // "CHESSTT"
+	uint32_t version;
+	uint32_t bucket_bytes;
+	uint64_t key_scheme;  // Fingerprint of the Zobrist keys
+	uint64_t bucket_count;
+	uint8_t age;  // Of the table when last searched, so entries keep aging across runs
+} TTFileHeader;
+
+
+typedef enum {
+	TT_FILE_CREATED,
+	TT_FILE_LOADED,
+	TT_FILE_INVALID,  // Not a table file, or one this build cannot use
+	TT_FILE_ERROR,  // Could not be opened, sized or mapped
+} TTFileStatus;
+
+
+typedef struct {
+	TTBucket* buckets;
+	uint64_t bucket_mask;
+	size_t size_bytes;
+	bool huge_pages;  // Backed by explicit huge pages rather than madvise
+	uint8_t age;  // Bumped every search so old entries get replaced first
+	TTFileHeader* file_header_ptr;  // Start of the mapping when backed by a file, otherwise 0
+} TranspositionTable;
+
+
+/* Unpacked contents of an entry */
+typedef struct {
+	Move move;
+	int score;
+	int depth;
+	Bound bound;
+} TTHit;
+
+
+/* Loads the bucket the child position will probe while the caller does
+   other work on it */
+ALWAYS_INLINE void prefetch_tt(TranspositionTable* tt_ptr, uint64_t hash) {
+	if (tt_ptr) {
+		__builtin_prefetch(&tt_ptr->buckets[hash & tt_ptr->bucket_mask]);
+	}
+}
+
+
+/* FUNCTION DEFINITIONS */
+void* allocate_tt_memory(size_t bytes, bool* huge_pages_ptr);
+bool tt_init(TranspositionTable* tt_ptr, size_t megabytes, int threads, bool interleave);
+void tt_free(TranspositionTable* tt_ptr);
+void tt_clear(TranspositionTable* tt_ptr, int threads);
+void tt_new_search(TranspositionTable* tt_ptr);
+bool tt_probe(TranspositionTable* tt_ptr, uint64_t hash, int ply, TTHit* hit_ptr);
+void tt_store(TranspositionTable* tt_ptr, uint64_t hash, Move* move_ptr, int score, int depth, Bound bound, int ply);
+TTFileStatus tt_open_file(TranspositionTable* tt_ptr, char* path, size_t megabytes);
+long long tt_merge_file(TranspositionTable* tt_ptr, char* path);
+long long tt_age_entries(TranspositionTable* tt_ptr, int max_age);
+long long tt_count_entries(TranspositionTable* tt_ptr);
+void run_tt_file(int argc, char** argv);
+
+
+#endif  /* TT_H */
@@ -0,0 +1,463 @@
+#include <fcntl.h>  // for open
+#include <math.h>  // for exp, pow, sqrt, round and M_LN10
+#include <pthread.h>  // for pthread_create and pthread_join
+#include <stdbool.h>  // for bool
+#include <stdint.h>  // for int16_t, uint8_t and uint16_t
+#include <stdio.h>  // for fopen, fprintf, fflush and printf
+#include <stdlib.h>  // for atof, atoi, calloc, malloc, realloc and free
+#include <string.h>  // for memchr, memcpy, memset, strcmp, strrchr and strstr
+#include <sys/mman.h>  // for mmap, madvise and munmap
+#include <sys/stat.h>  // for fstat
+#include <unistd.h>  // for close and sysconf
+#include "chess.h"
+#include "board.h"
+#include "evaluate.h"
+#include "timeman.h"
+
+
+/*
+ * Texel tuning of the material and piece-square tables. evaluate() is linear
+ * in those weights once the game phase is known, so every position is turned
+ * into a short list of (weight, count) features when the file is loaded, with
+ * white and black pieces on mirrored squares already cancelled out. An
+ * iteration is then a sparse dot product per position, and the gradient of
+ *
+ *   E = mean((result - sigmoid(K * eval))^2)
+ *
+ * is summed by each thread over the positions it loaded. Adam steps all the
+ * weights once per pass over the data. The bishop pair, endgame scaling and
+ * specialised endgames of the material table are not tuned.
+ */
+
+
+#define MAX_TUNE_THREADS 256
+#define MAX_EPD_LINE 256
+#define PST_WEIGHTS (6 * 64)  // Indexed by [PieceType][square]
+#define BASE_WEIGHTS (PST_WEIGHTS + 6)  // Followed by piece values by [PieceType]
+#define TUNE_WEIGHTS (2 * BASE_WEIGHTS)  // Midgame weights, then endgame weights
+#define DEFAULT_TUNE_ITERATIONS 500
+#define DEFAULT_LEARNING_RATE 1.0
+
+
+/* Weight index into the midgame half and how many more white than black
+   pieces use it. The endgame weight is at index + BASE_WEIGHTS */
+typedef struct {
+	uint16_t index;
+	int16_t count;
+} TuneFeature;
+
+
+typedef struct {
+	size_t first_feature;
+	uint8_t feature_count;
+	uint8_t phase;
+	float result;  // 1 for a white win, 0.5 for a draw, 0 for a black win
+} TunePosition;
+
+
+typedef struct {
+	// Loading
+	char* start;
+	char* end;
+	long long skipped_lines;
+
+	TunePosition* positions;
+	size_t position_count;
+	size_t position_capacity;
+	TuneFeature* features;
+	size_t feature_count;
+	size_t feature_capacity;
+
+	// Each pass
+	double* weights;  // Shared, read only while threads run
+	double k;
+	bool with_gradient;
+	double loss;
+	double gradient[TUNE_WEIGHTS];
+} TuneThread;
+
+
+/* Reads the game result of an EPD line, as c9 "1-0", [1.0] or a bare score
+   at the end. Returns false if there is none */
+bool parse_epd_result(char* line, float* result_ptr) {
+	if (strstr(line, "\"1-0\"") || strstr(line, "[1.0]") || strstr(line, "[1]")) { *result_ptr = 1.0f; }
+	else if (strstr(line, "\"0-1\"") || strstr(line, "[0.0]") || strstr(line, "[0]")) { *result_ptr = 0.0f; }
+	else if (strstr(line, "\"1/2-1/2\"") || strstr(line, "[0.5]")) { *result_ptr = 0.5f; }
+	else {
+		char* last_space = strrchr(line, ' ');
+		if (!last_space) {
+			return false;
+		}
+		if (strcmp(last_space + 1, "1.0") == 0) { *result_ptr = 1.0f; }
+		else if (strcmp(last_space + 1, "0.5") == 0) { *result_ptr = 0.5f; }
+		else if (strcmp(last_space + 1, "0.0") == 0) { *result_ptr = 0.0f; }
+		else { return false; }
+	}
+	return true;
+}
+
+
+bool reserve_features(TuneThread* thread_ptr, size_t extra) {
+	if (thread_ptr->feature_count + extra > thread_ptr->feature_capacity) {
+		size_t capacity = thread_ptr->feature_capacity * 2 + extra + 1024;
+		TuneFeature* features = realloc(thread_ptr->features, capacity * sizeof(TuneFeature));
+		if (!features) {
+			return false;
+		}
+		thread_ptr->features = features;
+		thread_ptr->feature_capacity = capacity;
+	}
+	if (thread_ptr->position_count == thread_ptr->position_capacity) {
+		size_t capacity = thread_ptr->position_capacity * 2 + 1024;
+		TunePosition* positions = realloc(thread_ptr->positions, capacity * sizeof(TunePosition));
+		if (!positions) {
+			return false;
+		}
+		thread_ptr->positions = positions;
+		thread_ptr->position_capacity = capacity;
+	}
+	return true;
+}
+
+
+/* Appends the features of one position, mirroring how evaluate() looks the
+   tables up. Kings have no value weight, so none is added for them */
+bool add_tune_position(TuneThread* thread_ptr, Board* board_ptr, float result) {
+	int counts[BASE_WEIGHTS] = {0};
+	uint16_t used[64];
+	int used_count = 0;
+	for (Colour colour = WHITE; colour <= BLACK; colour++) {
+		int sign = colour == WHITE ? 1 : -1;
+		int flip = colour == WHITE ? 56 : 0;
+		for (int i = 0; i < 16; i++) {
+			Piece* piece_ptr = &board_ptr->player_pieces[colour][i];
+			if (!piece_ptr->alive) {
+				continue;
+			}
+			int indexes[2] = {piece_ptr->type * 64 + (piece_ptr->square ^ flip), PST_WEIGHTS + piece_ptr->type};
+			for (int j = 0; j < (piece_ptr->type == KING ? 1 : 2); j++) {
+				if (counts[indexes[j]] == 0) {
+					used[used_count++] = indexes[j];
+				}
+				// A weight can return to 0 and be listed again, which is harmless
+				counts[indexes[j]] += sign;
+			}
+		}
+	}
+
+	if (!reserve_features(thread_ptr, used_count)) {
+		return false;
+	}
+	TunePosition* position_ptr = &thread_ptr->positions[thread_ptr->position_count++];
+	position_ptr->first_feature = thread_ptr->feature_count;
+	position_ptr->feature_count = 0;
+	position_ptr->phase = game_phase(board_ptr);
+	position_ptr->result = result;
+	for (int i = 0; i < used_count; i++) {
+		if (counts[used[i]] != 0) {
+			thread_ptr->features[thread_ptr->feature_count++] = (TuneFeature){used[i], counts[used[i]]};
+			position_ptr->feature_count++;
+			counts[used[i]] = 0;
+		}
+	}
+	return true;
+}
+
+
+void* load_tune_positions(void* arg) {
+	TuneThread* thread_ptr = arg;
+	Board* board_ptr = malloc(sizeof(Board));
+	char line[MAX_EPD_LINE];
+	char* position = thread_ptr->start;
+	while (board_ptr && position < thread_ptr->end) {
+		char* newline = memchr(position, '\n', thread_ptr->end - position);
+		char* line_end = newline ? newline : thread_ptr->end;
+		size_t length = line_end - position;
+		while (length > 0 && (position[length - 1] == '\r' || position[length - 1] == ' ')) {
+			length--;
+		}
+
+		float result;
+		if (length > 0 && length < MAX_EPD_LINE) {
+			memcpy(line, position, length);
+			line[length] = 0;
+			if (validate_fen(line) && parse_epd_result(line, &result)) {
+				setup_board(board_ptr, line);
+				if (!add_tune_position(thread_ptr, board_ptr, result)) {
+					break;
+				}
+			}
+			else {
+				thread_ptr->skipped_lines++;
+			}
+		}
+		else if (length > 0) {
+			thread_ptr->skipped_lines++;
+		}
+		position = line_end + 1;
+	}
+	free(board_ptr);
+	return 0;
+}
+
+
+/* Expected score for WHITE, 1 / (1 + 10^(-k * eval / 400)) */
+double sigmoid(double k, double eval) {
+	return 1.0 / (1.0 + exp(-k * eval * M_LN10 / 400.0));
+}
+
+
+/* Tapered evaluation from WHITE's point of view, as evaluate() without the
+   rounding */
+double tune_eval(TunePosition* position_ptr, TuneFeature* features, double* weights) {
+	double midgame = 0, endgame = 0;
+	for (int i = 0; i < position_ptr->feature_count; i++) {
+		TuneFeature* feature_ptr = &features[position_ptr->first_feature + i];
+		midgame += feature_ptr->count * weights[feature_ptr->index];
+		endgame += feature_ptr->count * weights[feature_ptr->index + BASE_WEIGHTS];
+	}
+	return (midgame * position_ptr->phase + endgame * (MAX_PHASE - position_ptr->phase)) / MAX_PHASE;
+}
+
+
+void* tune_pass(void* arg) {
+	TuneThread* thread_ptr = arg;
+	double loss = 0;
+	if (thread_ptr->with_gradient) {
+		memset(thread_ptr->gradient, 0, sizeof(thread_ptr->gradient));
+	}
+	double k_scale = thread_ptr->k * M_LN10 / 400.0;  // d sigmoid / d eval = k_scale * s * (1 - s)
+	for (size_t p = 0; p < thread_ptr->position_count; p++) {
+		TunePosition* position_ptr = &thread_ptr->positions[p];
+		double s = sigmoid(thread_ptr->k, tune_eval(position_ptr, thread_ptr->features, thread_ptr->weights));
+		double error = position_ptr->result - s;
+		loss += error * error;
+		if (!thread_ptr->with_gradient) {
+			continue;
+		}
+		double common = -2.0 * error * k_scale * s * (1.0 - s);
+		double midgame = common * position_ptr->phase / MAX_PHASE;
+		double endgame = common * (MAX_PHASE - position_ptr->phase) / MAX_PHASE;
+		for (int i = 0; i < position_ptr->feature_count; i++) {
+			TuneFeature* feature_ptr = &thread_ptr->features[position_ptr->first_feature + i];
+			thread_ptr->gradient[feature_ptr->index] += midgame * feature_ptr->count;
+			thread_ptr->gradient[feature_ptr->index + BASE_WEIGHTS] += endgame * feature_ptr->count;
+		}
+	}
+	thread_ptr->loss = loss;
+	return 0;
+}
+
+
+/* One pass over every position on all threads. Returns the mean squared
+   error and, if gradient is given, stores the mean gradient there */
+double run_tune_pass(TuneThread* threads, int thread_count, double* weights, double k, double* gradient, size_t position_count) {
+	pthread_t handles[MAX_TUNE_THREADS];
+	for (int i = 0; i < thread_count; i++) {
+		threads[i].weights = weights;
+		threads[i].k = k;
+		threads[i].with_gradient = gradient != 0;
+		pthread_create(&handles[i], 0, tune_pass, &threads[i]);
+	}
+	double loss = 0;
+	if (gradient) {
+		memset(gradient, 0, TUNE_WEIGHTS * sizeof(double));
+	}
+	for (int i = 0; i < thread_count; i++) {
+		pthread_join(handles[i], 0);
+		loss += threads[i].loss;
+		for (int j = 0; gradient && j < TUNE_WEIGHTS; j++) {
+			gradient[j] += threads[i].gradient[j] / position_count;
+		}
+	}
+	return loss / position_count;
+}
+
+
+/* Scaling constant that best fits the current weights to the results, by
+   golden section search */
+double fit_k(TuneThread* threads, int thread_count, double* weights, size_t position_count) {
+	double ratio = (sqrt(5.0) - 1) / 2;
+	double low = 0.1, high = 5.0;
+	double a = high - ratio * (high - low), b = low + ratio * (high - low);
+	double loss_a = run_tune_pass(threads, thread_count, weights, a, 0, position_count);
+	double loss_b = run_tune_pass(threads, thread_count, weights, b, 0, position_count);
+	for (int i = 0; i < 30; i++) {
+		if (loss_a < loss_b) {
+			high = b;
+			b = a;
+			loss_b = loss_a;
+			a = high - ratio * (high - low);
+			loss_a = run_tune_pass(threads, thread_count, weights, a, 0, position_count);
+		}
+		else {
+			low = a;
+			a = b;
+			loss_a = loss_b;
+			b = low + ratio * (high - low);
+			loss_b = run_tune_pass(threads, thread_count, weights, b, 0, position_count);
+		}
+	}
+	return (low + high) / 2;
+}
+
+
+void load_weights(double* weights) {
+	for (int phase = MIDGAME; phase <= ENDGAME; phase++) {
+		double* base = weights + phase * BASE_WEIGHTS;
+		for (int type = PAWN; type <= KING; type++) {
+			for (int square = 0; square < 64; square++) {
+				base[type * 64 + square] = piece_square_table[phase][type][square];
+			}
+			base[PST_WEIGHTS + type] = piece_value[phase][type];
+		}
+	}
+}
+
+
+/* Writes the weights as the table definitions of evaluate.c */
+bool write_weights(char* path, double* weights) {
+	static char* type_names[6] = {"PAWN", "KNIGHT", "BISHOP", "ROOK", "QUEEN", "KING"};
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		return false;
+	}
+	fprintf(file, "// Indexed by [GamePhase][PieceType]\nconst int piece_value[2][6] = {\n");
+	for (int phase = MIDGAME; phase <= ENDGAME; phase++) {
+		fprintf(file, "\t{");
+		for (int type = PAWN; type <= KING; type++) {
+			fprintf(file, "%s%d", type > PAWN ? ", " : "", (int)round(weights[phase * BASE_WEIGHTS + PST_WEIGHTS + type]));
+		}
+		fprintf(file, "},\n");
+	}
+	fprintf(file, "};\n\n\n");
+
+	fprintf(file, "const int piece_square_table[2][6][64] = {\n");
+	for (int phase = MIDGAME; phase <= ENDGAME; phase++) {
+		fprintf(file, "\t{\n");
+		for (int type = PAWN; type <= KING; type++) {
+			fprintf(file, "\t\t{  // %s\n", type_names[type]);
+			for (int rank = 0; rank < 8; rank++) {
+				fprintf(file, "\t\t\t");
+				for (int file_index = 0; file_index < 8; file_index++) {
+					int weight = (int)round(weights[phase * BASE_WEIGHTS + type * 64 + rank * 8 + file_index]);
+					fprintf(file, "%d,%s", weight, file_index < 7 ? " " : "\n");
+				}
+			}
+			fprintf(file, "\t\t},\n");
+		}
+		fprintf(file, "\t},\n");
+	}
+	fprintf(file, "};\n");
+	return fclose(file) == 0;
+}
+
+
+/* Usage: tune <epd file> [threads N] [iterations N] [rate R] [output FILE]
+   Writes the tuned tables to the output file, tuned_eval.c by default */
+void run_tune(int argc, char** argv) {
+	if (argc < 1) {
+		printf("Usage: tune <epd file> [threads N] [iterations N] [rate R] [output FILE]\n");
+		return;
+	}
+	int thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+	int iterations = DEFAULT_TUNE_ITERATIONS;
+	double rate = DEFAULT_LEARNING_RATE;
+	char* output_path = "tuned_eval.c";
+	for (int i = 1; i < argc; i++) {
+		char* value = i + 1 < argc ? argv[i + 1] : "0";
+		if (strcmp(argv[i], "threads") == 0) { thread_count = atoi(value); i++; }
+		else if (strcmp(argv[i], "iterations") == 0) { iterations = atoi(value); i++; }
+		else if (strcmp(argv[i], "rate") == 0) { rate = atof(value); i++; }
+		else if (strcmp(argv[i], "output") == 0) { output_path = value; i++; }
+		else { printf("Unknown tune argument: %s\n", argv[i]); return; }
+	}
+	thread_count = thread_count < 1 ? 1 : (thread_count > MAX_TUNE_THREADS ? MAX_TUNE_THREADS : thread_count);
+
+	int fd = open(argv[0], O_RDONLY);
+	struct stat file_stat;
+	if (fd < 0 || fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+		printf("Could not open %s\n", argv[0]);
+		if (fd >= 0) { close(fd); }
+		return;
+	}
+	size_t size = file_stat.st_size;
+	char* data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		printf("Could not map %s\n", argv[0]);
+		return;
+	}
+	madvise(data, size, MADV_SEQUENTIAL);
+
+	// Each thread loads, and later scores, its own range of whole lines
+	long long start_time = current_time_ms();
+	TuneThread* threads = calloc(thread_count, sizeof(TuneThread));
+	pthread_t handles[MAX_TUNE_THREADS];
+	char* start = data;
+	for (int i = 0; i < thread_count; i++) {
+		char* end = data + size * (i + 1) / thread_count;
+		char* newline = end < data + size ? memchr(end, '\n', data + size - end) : 0;
+		end = newline ? newline + 1 : data + size;
+		threads[i].start = start < end ? start : end;
+		threads[i].end = end;
+		pthread_create(&handles[i], 0, load_tune_positions, &threads[i]);
+		start = end;
+	}
+	size_t position_count = 0, feature_count = 0;
+	long long skipped_lines = 0;
+	for (int i = 0; i < thread_count; i++) {
+		pthread_join(handles[i], 0);
+		position_count += threads[i].position_count;
+		feature_count += threads[i].feature_count;
+		skipped_lines += threads[i].skipped_lines;
+	}
+	munmap(data, size);
+	printf(
+		"positions: %zu features: %.1f per position skipped lines: %lld load: %.3fs\n",
+		position_count, position_count ? (double)feature_count / position_count : 0.0,
+		skipped_lines, (current_time_ms() - start_time) / 1000.0
+	);
+
+	if (position_count > 0) {
+		static double weights[TUNE_WEIGHTS], gradient[TUNE_WEIGHTS];
+		static double first_moment[TUNE_WEIGHTS], second_moment[TUNE_WEIGHTS];
+		load_weights(weights);
+		double k = fit_k(threads, thread_count, weights, position_count);
+		printf("k: %.4f loss: %.8f\n", k, run_tune_pass(threads, thread_count, weights, k, 0, position_count));
+
+		// Adam, with the step size in centipawns
+		double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+		start_time = current_time_ms();
+		for (int iteration = 1; iteration <= iterations; iteration++) {
+			double loss = run_tune_pass(threads, thread_count, weights, k, gradient, position_count);
+			double correction1 = 1 - pow(beta1, iteration);
+			double correction2 = 1 - pow(beta2, iteration);
+			for (int i = 0; i < TUNE_WEIGHTS; i++) {
+				first_moment[i] = beta1 * first_moment[i] + (1 - beta1) * gradient[i];
+				second_moment[i] = beta2 * second_moment[i] + (1 - beta2) * gradient[i] * gradient[i];
+				weights[i] -= rate * (first_moment[i] / correction1) / (sqrt(second_moment[i] / correction2) + epsilon);
+			}
+			if (iteration % 50 == 0 || iteration == iterations) {
+				printf(
+					"iteration: %d loss: %.8f time: %.3fs\n",
+					iteration, loss, (current_time_ms() - start_time) / 1000.0
+				);
+				fflush(stdout);
+			}
+		}
+
+		if (write_weights(output_path, weights)) {
+			printf("Tuned tables written to %s\n", output_path);
+		}
+		else {
+			printf("Could not write %s\n", output_path);
+		}
+	}
+
+	for (int i = 0; i < thread_count; i++) {
+		free(threads[i].positions);
+		free(threads[i].features);
+	}
+	free(threads);
+}
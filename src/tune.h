@@ -0,0 +1,9 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+
+/* FUNCTION DEFINITIONS */
+void run_tune(int argc, char** argv);
+
+
+#endif  /* TUNE_H */
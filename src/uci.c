@@ -0,0 +1,235 @@
+#include <stdbool.h>  // for bool
+#include <stdio.h>  // for fgets, printf and fflush
+#include <stdlib.h>  // for atoi and atoll
+#include <string.h>  // for strcmp, strcspn, strncmp, strstr and strtok
+#include <unistd.h>  // for sysconf and usleep
+#include "chess.h"
+#include "board.h"
+#include "interface.h"
+#include "search.h"
+#include "tt.h"
+
+
+#define UCI_LINE_LENGTH 16384  // Long enough for a position with a full game of moves
+#define DEFAULT_HASH_MB 64
+#define MAX_HASH_MB 65536
+
+
+char* start_position = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+
+/* position [startpos | fen <fen>] [moves <move> ...]. A FEN that does not
+   validate leaves the board, and so the moves after it, untouched */
+void uci_position(Board* board_ptr, char* line) {
+	char* moves = strstr(line, " moves");
+	if (moves) {
+		*moves = 0;
+		moves += strlen(" moves");
+	}
+
+	char* fen = strstr(line, "fen ");
+	if (fen) {
+		fen += strlen("fen ");
+		fen[strcspn(fen, "\r\n")] = 0;
+		if (!validate_fen(fen)) {
+			printf("info string invalid fen\n");
+			return;
+		}
+	}
+	setup_board(board_ptr, fen ? fen : start_position);
+
+	if (!moves) {
+		return;
+	}
+	for (char* token = strtok(moves, " \n"); token; token = strtok(0, " \n")) {
+		Move move;
+		if (!string_to_move(board_ptr, token, &move)) {
+			break;
+		}
+		MoveUndo undo;
+		play_move(&move, board_ptr, &undo);
+	}
+}
+
+
+/* GUIs expect no bestmove for a ponder or infinite search until they send
+   ponderhit or stop, even when the search itself is over */
+static bool infinite_search;
+
+
+void uci_print_bestmove(BackgroundSearch* background_ptr) {
+	SearchControl* control_ptr = &background_ptr->control;
+	while (
+		(infinite_search || __atomic_load_n(&control_ptr->pondering, __ATOMIC_ACQUIRE)) &&
+		!__atomic_load_n(&control_ptr->stop, __ATOMIC_RELAXED)
+	) {
+		usleep(1000);
+	}
+
+	SearchInfo* info_ptr = background_ptr->info_ptr;
+	char move_string[6];
+	move_to_string(&info_ptr->best_move, move_string);
+	printf("bestmove %s", move_string);
+	if (info_ptr->ponder_move.from != NONE) {
+		move_to_string(&info_ptr->ponder_move, move_string);
+		printf(" ponder %s", move_string);
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+
+/* go [ponder] [infinite] [wtime t] [btime t] [winc t] [binc t] [movestogo n] [movetime t] [depth n] [nodes n]
+   The search runs on its own thread so stop and ponderhit can be read */
+void uci_go(BackgroundSearch* background_ptr, Board* board_ptr, SearchInfo* info_ptr, char* line) {
+	SearchLimits limits = {};
+	bool ponder = false;
+	infinite_search = false;
+	char* token = strtok(line, " \n");
+	while (token) {
+		// Flags without a value
+		if (strcmp(token, "ponder") == 0) { ponder = true; token = strtok(0, " \n"); continue; }
+		if (strcmp(token, "infinite") == 0) { infinite_search = true; token = strtok(0, " \n"); continue; }
+		char* value = strtok(0, " \n");
+		if (!value) {
+			break;
+		}
+		if (strcmp(token, "wtime") == 0) { limits.time[WHITE] = atoi(value); }
+		else if (strcmp(token, "btime") == 0) { limits.time[BLACK] = atoi(value); }
+		else if (strcmp(token, "winc") == 0) { limits.increment[WHITE] = atoi(value); }
+		else if (strcmp(token, "binc") == 0) { limits.increment[BLACK] = atoi(value); }
+		else if (strcmp(token, "movestogo") == 0) { limits.moves_to_go = atoi(value); }
+		else if (strcmp(token, "movetime") == 0) { limits.move_time = atoi(value); }
+		else if (strcmp(token, "depth") == 0) { limits.depth = atoi(value); }
+		else if (strcmp(token, "nodes") == 0) { limits.nodes = atoll(value); }
+		else {
+			// Unknown flags step one token
+			token = value;
+			continue;
+		}
+		token = strtok(0, " \n");
+	}
+
+	info_ptr->limits = limits;
+	background_ptr->on_finish = uci_print_bestmove;
+	start_background_search(background_ptr, board_ptr, info_ptr, ponder);
+}
+
+
+/* An empty path goes back to a table in memory. A new file gets the current
+   hash size, an existing one keeps its own */
+void uci_set_hash_file(TranspositionTable* tt_ptr, char* path) {
+	size_t megabytes = tt_ptr->size_bytes / (1024 * 1024);
+	tt_free(tt_ptr);
+	if (path) {
+		path[strcspn(path, "\r\n")] = 0;
+	}
+	if (!path || !*path || strcmp(path, "<empty>") == 0) {
+		tt_init(tt_ptr, megabytes, sysconf(_SC_NPROCESSORS_ONLN), true);
+		return;
+	}
+
+	TTFileStatus status = tt_open_file(tt_ptr, path, megabytes);
+	if (status == TT_FILE_CREATED || status == TT_FILE_LOADED) {
+		printf(
+			"info string %s %zu MB hash file %s\n", status == TT_FILE_CREATED ? "created" : "loaded",
+			tt_ptr->size_bytes / (1024 * 1024), path
+		);
+		return;
+	}
+	printf("info string %s %s, hash stays in memory\n", status == TT_FILE_INVALID ? "cannot use" : "could not open", path);
+	tt_init(tt_ptr, megabytes, sysconf(_SC_NPROCESSORS_ONLN), true);
+}
+
+
+/* setoption name Hash value <megabytes>
+   setoption name HashFile value <path> */
+void uci_setoption(TranspositionTable* tt_ptr, char* line) {
+	char* value = strstr(line, " value ");
+	if (strstr(line, " name HashFile")) {
+		uci_set_hash_file(tt_ptr, value ? value + strlen(" value ") : 0);
+		return;
+	}
+	if (!strstr(line, " name Hash") || !value) {
+		return;
+	}
+	int megabytes = atoi(value + strlen(" value "));
+	if (megabytes < 1 || megabytes > MAX_HASH_MB) {
+		return;
+	}
+	if (tt_ptr->file_header_ptr) {
+		printf("info string the hash file sets the hash size\n");
+		return;
+	}
+	tt_free(tt_ptr);
+	if (!tt_init(tt_ptr, megabytes, sysconf(_SC_NPROCESSORS_ONLN), true)) {
+		printf("info string could not allocate %d MB, using %d MB\n", megabytes, DEFAULT_HASH_MB);
+		tt_init(tt_ptr, DEFAULT_HASH_MB, sysconf(_SC_NPROCESSORS_ONLN), true);
+	}
+}
+
+
+/* Universal Chess Interface loop reading commands from stdin. A search in
+   progress is stopped by any command that changes the position or the
+   engine's state, which is also how a ponder miss is discarded */
+void uci_loop() {
+	static Board board;
+	static SearchInfo info;
+	static TranspositionTable tt;
+	static BackgroundSearch background;
+	static char line[UCI_LINE_LENGTH];
+
+	tt_init(&tt, DEFAULT_HASH_MB, sysconf(_SC_NPROCESSORS_ONLN), true);
+	info.options = default_search_options;
+	info.verbose = true;
+	info.tt_ptr = &tt;
+	clear_search_tables(&info);
+	setup_board(&board, start_position);
+
+	while (fgets(line, sizeof(line), stdin)) {
+		if (strncmp(line, "ucinewgame", 10) == 0) {
+			stop_background_search(&background);
+			clear_search_tables(&info);
+			// Keeping the entries is the point of a hash file, aging retires them
+			if (!tt.file_header_ptr) {
+				tt_clear(&tt, sysconf(_SC_NPROCESSORS_ONLN));
+			}
+			setup_board(&board, start_position);
+		}
+		else if (strncmp(line, "uci", 3) == 0) {
+			printf("id name CHESS-ENGINE\n");
+			printf("id author SebZanardo\n");
+			printf("option name Hash type spin default %d min 1 max %d\n", DEFAULT_HASH_MB, MAX_HASH_MB);
+			printf("option name HashFile type string default <empty>\n");
+			printf("option name Ponder type check default false\n");
+			printf("uciok\n");
+		}
+		else if (strncmp(line, "isready", 7) == 0) {
+			printf("readyok\n");
+		}
+		else if (strncmp(line, "setoption", 9) == 0) {
+			stop_background_search(&background);
+			uci_setoption(&tt, line);
+		}
+		else if (strncmp(line, "position", 8) == 0) {
+			stop_background_search(&background);
+			uci_position(&board, line);
+		}
+		else if (strncmp(line, "go", 2) == 0) {
+			stop_background_search(&background);
+			uci_go(&background, &board, &info, line + 2);
+		}
+		else if (strncmp(line, "ponderhit", 9) == 0) {
+			ponderhit(&background);
+		}
+		else if (strncmp(line, "stop", 4) == 0) {
+			stop_background_search(&background);
+		}
+		else if (strncmp(line, "quit", 4) == 0) {
+			break;
+		}
+		fflush(stdout);
+	}
+	stop_background_search(&background);
+	tt_free(&tt);
+}
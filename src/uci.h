@@ -0,0 +1,9 @@
+#ifndef UCI_H
+#define UCI_H
+
+
+/* FUNCTION DEFINITIONS */
+void uci_loop();
+
+
+#endif  /* UCI_H */
@@ -0,0 +1,288 @@
+#include <stdint.h>  // for uint64_t
+#include "chess.h"
+
+
+/* Random keys generated offline with splitmix64 from a seed of 0. Kept as
+   constant data so no initialisation is needed and every thread and build
+   agrees on the same hashes. */
+const uint64_t zobrist_piece_keys[2][6][64] = {
+	{
+		{
+			0xe220a8397b1dcdafULL, 0x6e789e6aa1b965f4ULL, 0x06c45d188009454fULL, 0xf88bb8a8724c81ecULL,
+			0x1b39896a51a8749bULL, 0x53cb9f0c747ea2eaULL, 0x2c829abe1f4532e1ULL, 0xc584133ac916ab3cULL,
+			0x3ee5789041c98ac3ULL, 0xf3b8488c368cb0a6ULL, 0x657eecdd3cb13d09ULL, 0xc2d326e0055bdef6ULL,
+			0x8621a03fe0bbdb7bULL, 0x8e1f7555983aa92fULL, 0xb54e0f1600cc4d19ULL, 0x84bb3f97971d80abULL,
+			0x7d29825c75521255ULL, 0xc3cf17102b7f7f86ULL, 0x3466e9a083914f64ULL, 0xd81a8d2b5a4485acULL,
+			0xdb01602b100b9ed7ULL, 0xa9038a921825f10dULL, 0xedf5f1d90dca2f6aULL, 0x54496ad67bd2634cULL,
+			0xdd7c01d4f5407269ULL, 0x935e82f1db4c4f7bULL, 0x69b82ebc92233300ULL, 0x40d29eb57de1d510ULL,
+			0xa2f09dabb45c6316ULL, 0xee521d7a0f4d3872ULL, 0xf16952ee72f3454fULL, 0x377d35dea8e40225ULL,
+			0x0c7de8064963bab0ULL, 0x05582d37111ac529ULL, 0xd254741f599dc6f7ULL, 0x69630f7593d108c3ULL,
+			0x417ef96181daa383ULL, 0x3c3c41a3b43343a1ULL, 0x6e19905dcbe531dfULL, 0x4fa9fa7324851729ULL,
+			0x84eb4454a792922aULL, 0x134f7096918175ceULL, 0x07dc930b302278a8ULL, 0x12c015a97019e937ULL,
+			0xcc06c31652ebf438ULL, 0xecee65630a691e37ULL, 0x3e84ecb1763e79adULL, 0x690ed476743aae49ULL,
+			0x774615d7b1a1f2e1ULL, 0x22b353f04f4f52daULL, 0xe3ddd86ba71a5eb1ULL, 0xdf268adeb6513356ULL,
+			0x2098eb73d4367d77ULL, 0x03d6845323ce3c71ULL, 0xc952c5620043c714ULL, 0x9b196bca844f1705ULL,
+			0x30260345dd9e0ec1ULL, 0xcf448a5882bb9698ULL, 0xf4a578dccbc87656ULL, 0xbfdeaed9a17b3c8fULL,
+			0xed79402d1d5c5d7bULL, 0x55f070ab1cbbf170ULL, 0x3e00a34929a88f1dULL, 0xe255b237b8bb18fbULL,
+		},
+		{
+			0x2a7b67af6c6ad50eULL, 0x466d5e7f3e46f143ULL, 0x42375cb399a4fc72ULL, 0x8c8a1f148a8bb259ULL,
+			0x32fcab5daed5bdfcULL, 0x9e60398c8d8553c0ULL, 0xee89cceb8c4064c0ULL, 0xdb0215941d86a66fULL,
+			0x5ccde78203c367a8ULL, 0xf1bcbc6a1ec11786ULL, 0xef054fceee954551ULL, 0xdf82012d0555c6dfULL,
+			0x292566ff72403c08ULL, 0xc4dd302a1bfa1137ULL, 0xd85f219db5c554e1ULL, 0x6a27ff807441bcd2ULL,
+			0x96a573e9b48216e8ULL, 0x46a9fdac40bf0048ULL, 0x3dd12464a0ee15b4ULL, 0x451e521296a7eea1ULL,
+			0x56e4398a98f8a0fdULL, 0x7b7dc2160e3335a7ULL, 0xc679ee0bebcb1ccaULL, 0x928d6f2d7453424eULL,
+			0x1b38994205234c6dULL, 0x8086d193a6f2b568ULL, 0x21c6e26639ac2c65ULL, 0xd9dccac414d23c6fULL,
+			0x91cd642057e00235ULL, 0x77fc607dc6589373ULL, 0x05b8abe26dd3aee7ULL, 0x12f6436ac376cc66ULL,
+			0x64952424897b2307ULL, 0xee8c2baf6343e5c3ULL, 0xdc4c613d9eba2304ULL, 0x3505b7796bd1a506ULL,
+			0x8176daf800a05f50ULL, 0x8bd8ff7a0385cdbcULL, 0x1a764a3cd78101daULL, 0xbe4d15bf6ca266acULL,
+			0xa85e1f38bb2dc749ULL, 0x56759a968493cd8cULL, 0xf3a9bce7336bd182ULL, 0x365b15013741519bULL,
+			0x1f7a44a6b109ac94ULL, 0x3521d628813cb177ULL, 0x6a77afab0f7c9370ULL, 0x179642d8cde95015ULL,
+			0x5ef102a8fb354461ULL, 0xf51c504764ed82f2ULL, 0xc58427f041ce6808ULL, 0xfad8fc45c9643c37ULL,
+			0xcf8682f9a70fa9c0ULL, 0x7e1b3b75a4005729ULL, 0x992dd867927b52d8ULL, 0x7fbd5db142f6791fULL,
+			0x370595aacab4adaeULL, 0xb1392dbdc5ab61d6ULL, 0x9fea7dfc79d452d9ULL, 0x40b12b120085641cULL,
+			0xa192afe3157c85d0ULL, 0xc847729f4e08f3a3ULL, 0x6f1384a306c41fc2ULL, 0x12d05c4045a39c19ULL,
+		},
+		{
+			0x9899202fd20f0841ULL, 0xe9c7191857e774b8ULL, 0x4eead809af5b0cc3ULL, 0xe809acafa23864a4ULL,
+			0x4da1edaba1d0f7bdULL, 0x846eb9673349f8e4ULL, 0x87bae55b86039fe8ULL, 0x7f367b8bd953eff2ULL,
+			0x3884700f650d04e1ULL, 0xbfe4b2ab46980cadULL, 0xc5fc89075299106cULL, 0x37b2fa361adea7cdULL,
+			0x7d75d813f04895b4ULL, 0x702f5b393f62c0e0ULL, 0x0a3fc775f4ecf37fULL, 0xe4b23787a352437fULL,
+			0xf83fa245c34d6363ULL, 0xb99bcf040786cf50ULL, 0x38b6ea0a0e6c9d8aULL, 0x093fdc76776e37e1ULL,
+			0x1a75e6f76ba7eee8ULL, 0x442cdcfee9660c62ULL, 0x22d58d35116b5e0bULL, 0x87d4a5180f6a3645ULL,
+			0x589fb216bd82131bULL, 0x91d031cad319aec0ULL, 0xabecf76a553d320bULL, 0xb8686cb347612dcfULL,
+			0xfcab66337c0a77f5ULL, 0xac318214381ec437ULL, 0x6eb7f0fca24494aeULL, 0xcf42861dcdc895a9ULL,
+			0x4abad7a1586d7a91ULL, 0xc21b318dc2f49745ULL, 0xd49474dc2acbd1f0ULL, 0xb1d4873747c1c8e1ULL,
+			0x5434dc8c7d015bf6ULL, 0xe1c486287511b6a9ULL, 0xa8616df62e89a193ULL, 0x31ce6319498d8347ULL,
+			0xafd0b486123d6faaULL, 0xe6495f5d102301ebULL, 0x0dc51ced17a43c52ULL, 0x8bcbcde81355ef2dULL,
+			0x2412af73fdee7cfcULL, 0xc8d589e486e29eedULL, 0x23390e8664517f89ULL, 0x251ade58e8a6849dULL,
+			0xf8555dbd2e8f9cb0ULL, 0xcb417c3eef54f7c3ULL, 0x8028f8e1aac3a919ULL, 0x10e31052acf748a0ULL,
+			0x2d886c073b1e1b78ULL, 0x972974d90df9faeeULL, 0xbc1b7b38796893baULL, 0x1958ed432070e652ULL,
+			0xca5f297197a12dccULL, 0xe025a27375704f28ULL, 0x418010a570a924fbULL, 0x9828e2941bfc419cULL,
+			0x4fbacd2f52b85c1fULL, 0x33dd5b756211cc67ULL, 0x23c8dfdd1db57ff0ULL, 0x32f81801a1a8e901ULL,
+		},
+		{
+			0x26884eac5ada36daULL, 0xcaa82f9bb42e37d4ULL, 0x19fb1a7491d6a7d1ULL, 0x5aa0243aa357f38eULL,
+			0xb31d917809e447f0ULL, 0x3f9c197225215be0ULL, 0xdc3c315a1e33c095ULL, 0x3dd399ad533e80acULL,
+			0x566f32cce8301d95ULL, 0xc880188083d9ba21ULL, 0xb9cc357f3b0e7d2eULL, 0x0237d2123a8a8d6cULL,
+			0xbf636e9aa7cbf6bdULL, 0xd7bd4284c4e2a6a7ULL, 0xda2ebb47d50577a9ULL, 0x90ba1c11b539087dULL,
+			0x44993d31552b4f57ULL, 0x32c2d6f80a8a8898ULL, 0x450583ed7fb54b19ULL, 0xec2b0b09e50ef3efULL,
+			0xd918a0b6e2efd65cULL, 0xe37a868d9785f572ULL, 0x7d1a6118f2b0f37aULL, 0x9e2e3cc13b343439ULL,
+			0xefd82c11212e37e8ULL, 0xaf89c05cd4fc75edULL, 0x55bc16bb9697108eULL, 0x6c4701fa5db69beeULL,
+			0x9237338441daf445ULL, 0x248cf0831e81a5fcULL, 0xacc13557e77de273ULL, 0x520970c25e06513aULL,
+			0x657329cb02987cabULL, 0xa9b0b3366a4e55a8ULL, 0xc4d06ca2f39acdd4ULL, 0x5dce37d68170cde1ULL,
+			0x5f1e44e77e1854c9ULL, 0x6883d452d55df899ULL, 0x05c5bd62f1067032ULL, 0xe680b683ce60fab0ULL,
+			0x5dc9da3f286d18b1ULL, 0x94b4bf3ab85ed6d8ULL, 0xce65f449e3acc5a3ULL, 0x34b0209642cea639ULL,
+			0xc14c3c771d904827ULL, 0x6addcee2bd9cdee5ULL, 0xe24eed137ffbb613ULL, 0x75dd58ef79963d1bULL,
+			0xfdb83ecf6cc24920ULL, 0x7a1d0057c57169fbULL, 0x339200f4feb62d07ULL, 0xd33f4d4ac88469f4ULL,
+			0x8226f234e68dfee4ULL, 0x320def4f2a105536ULL, 0x7786f3b13aefc159ULL, 0xb28225ac9df63ee2ULL,
+			0x781b9d0376cc6044ULL, 0x05bd0115226c6ab6ULL, 0xd302230207bdfdabULL, 0xdb898abd8e0d2933ULL,
+			0x9e79a397ba00b9ccULL, 0x89df84a5f0003ee8ULL, 0x011f04f2a75fb9beULL, 0x5a5832bb47bcf19eULL,
+		},
+		{
+			0xcbdc6d34b7c7534dULL, 0x28a0d62b36f7e211ULL, 0x56c4553d5d0b9393ULL, 0x6926f3234c55dbf2ULL,
+			0x13fd156d281831abULL, 0x788fde493e59653dULL, 0x984456f3129d0de5ULL, 0x75fef0b6764f4cbaULL,
+			0x3d1500b0edf98a29ULL, 0xa149d1519fd97dc4ULL, 0x1288259c4a188588ULL, 0x304014a30b42d718ULL,
+			0x7e9d7e05138f2863ULL, 0x8379ec73f35176f4ULL, 0x72076caedab9cd77ULL, 0x933d40d047d5c211ULL,
+			0x521d6aec56c0137bULL, 0x4972307f6da2e896ULL, 0x6381fc65071e876dULL, 0xe5eba2b5b975969aULL,
+			0xf9819878b6052e93ULL, 0x42cab1f6274738afULL, 0xe8e4342ae5cfb767ULL, 0x6eb46bd2bd74a766ULL,
+			0x4dca29b4fd8880c0ULL, 0xf5de3740c3cb338dULL, 0x7c0dddf3352b6dbdULL, 0xa6208f121e7b9d80ULL,
+			0x22bb0c2a84214635ULL, 0x0f721606cabc211eULL, 0xa434826569f1a127ULL, 0x07c801c0f8fe99e7ULL,
+			0x77335155fdf6900bULL, 0x7de131ff132472a9ULL, 0x9614024d783ce84fULL, 0x0807e7c5ec9c7b14ULL,
+			0x0c5857e188e1c693ULL, 0x3c6250408655f23dULL, 0x1d94501ac76ca8cfULL, 0xa75002a693f4354aULL,
+			0x4bf2d03583341074ULL, 0xcec9908f230b6711ULL, 0xfc001b32f9982685ULL, 0xa837b30638cacfb2ULL,
+			0xdaa5f80fe9d0f70dULL, 0x45ab1a6a22d6bc17ULL, 0x476cf802330034e5ULL, 0x08b65c623f08199dULL,
+			0x619957d95328ea3cULL, 0xad6fed10cbda8dcdULL, 0xedb0d0d28761fcc0ULL, 0x23a06397a6335d81ULL,
+			0x2649be21534f387fULL, 0x6bad9f5f9193499bULL, 0x71cce7c3593342d9ULL, 0xd6f316c5c285c4deULL,
+			0xb73a83eeec718640ULL, 0x2804d8c04de3388bULL, 0xd9da1024dc5ea567ULL, 0xf47ec04292326b23ULL,
+			0xa6b94cf241e7e821ULL, 0x0c1dee5409bc203fULL, 0x33ba05bc3ee276faULL, 0x032cd31b757b30bbULL,
+		},
+		{
+			0x3ccd39a590b78295ULL, 0x4a264b709d0105efULL, 0x1fa19cfc9778db71ULL, 0x8436631985e92e8bULL,
+			0x5d34de04733d0a15ULL, 0x2b181597907baf2eULL, 0xcece4d103307428bULL, 0x63a90e6c8f8391c2ULL,
+			0x4c47a8c4017695ecULL, 0x5fe135a23112e31bULL, 0xcbd065fd22102737ULL, 0x63fa700bfc399149ULL,
+			0xe23b1de2babad561ULL, 0x50c2dbee5d134327ULL, 0x93c051781267eff5ULL, 0x9aa83a6d8eb8abb3ULL,
+			0x2d2fe50e4473ade9ULL, 0x5fa1690e247adf55ULL, 0x62f4f57b730a8d16ULL, 0x616308740e528066ULL,
+			0x861731f13c272113ULL, 0x3c6caec2abb41615ULL, 0x58dc98d3a4b965dfULL, 0xac67e58c447a30f3ULL,
+			0x717d1b34d0f226b5ULL, 0x5068123375a5b3c6ULL, 0x65955f41cfd0e893ULL, 0x7a05e7206258c3f8ULL,
+			0x530b98a49018d298ULL, 0x4164a427d5be9ebbULL, 0x8ed388d35f43ad87ULL, 0xeda8fa6a8a59bc0eULL,
+			0xa6b3a6712afcd38aULL, 0x857b0535c58d6b14ULL, 0x35ccc2bf24fbceb1ULL, 0x91757f9b2437ce51ULL,
+			0x4f9a23e2b151be74ULL, 0x78779a725ea2d9feULL, 0xcc4ec68084cc7e95ULL, 0xb6966a6140bf3535ULL,
+			0x89de59fa33170a0aULL, 0x45891bd34267a6efULL, 0x68eb3b32aa806aacULL, 0xae2e7ecc4c8e0da9ULL,
+			0x9c6973b1cd7c1a97ULL, 0xb2a774c1f3488fb5ULL, 0x00bb92e27d083dcaULL, 0x5d9f2c93ff73a7a1ULL,
+			0xf77effea672d02c9ULL, 0x2c8f635e04e16818ULL, 0x63ccdda60ab7b0a9ULL, 0x1cce0bba630053b2ULL,
+			0xeabd508b9df52a49ULL, 0x85232b4a312d42a2ULL, 0x907271a5478cde49ULL, 0x5a63530cfad0b243ULL,
+			0xab1a732b3f586b99ULL, 0xadeae4869d4467b3ULL, 0x2a4176cc70fa8c52ULL, 0x871ed802e15cf126ULL,
+			0x41a665fe26a7a248ULL, 0xe6855668819e63a0ULL, 0x7946342a93638d09ULL, 0xcee7f6ce76c24791ULL,
+		},
+	},
+	{
+		{
+			0x90746e60ef10929cULL, 0x303f222ec15a3656ULL, 0x91ca8850bdb392a5ULL, 0x282be21753fd8812ULL,
+			0x8da4658f613ba6a7ULL, 0x39f0f2e09ba26805ULL, 0xe10e043370f4ce5fULL, 0xe3ef8013856fc40cULL,
+			0x10155b096e22e7f7ULL, 0xb06fa4f0d3afe2d3ULL, 0x98dabb1c64aa2138ULL, 0x662426bd0482cb44ULL,
+			0xd49604a4e3af5c6aULL, 0x1d73b2634c39403eULL, 0x894fb150a04be81cULL, 0x2a2e37a33a8f339dULL,
+			0x412b63228c0d97d9ULL, 0xe4534eb1558ea880ULL, 0x22d471edcc01f620ULL, 0x1810596a0c2284f9ULL,
+			0x55ea875e6ee39c26ULL, 0xfda91f81674f3233ULL, 0x99fb91542b2ef76cULL, 0x4850117266c0d41fULL,
+			0x4c84fdeeb5b71336ULL, 0x5b65923ac30ec1f4ULL, 0x001fce785e79eaccULL, 0xe7035aadba840af9ULL,
+			0xef062cfb5d3a3fa4ULL, 0x91cf003dc64d2047ULL, 0x6a6bbae4c69f0558ULL, 0xbc83ebe6cd2818d8ULL,
+			0xc3a32910d5aeaa2dULL, 0x2f124b01d8c37ff7ULL, 0x89908fb20936c74fULL, 0x30307ace765d040bULL,
+			0x2efc3e93492e7d12ULL, 0xb5af6d95d72949eaULL, 0x9217fa5ec037abe8ULL, 0xa27ca1090743f1bdULL,
+			0x9e58d128e268bc60ULL, 0x331f5ff8d2f1cccaULL, 0x1318b39f628757d7ULL, 0xf1eedce334401c5eULL,
+			0x10448c3a57ddd877ULL, 0xc6220951fb35d453ULL, 0xa492fa1749559626ULL, 0xc16c742d1cc888f8ULL,
+			0x4ee6be96e6483c3bULL, 0xd8c4cbbb86af34bdULL, 0xc23fe6e086e66126ULL, 0x593573115d89d57dULL,
+			0xeae4b6ca31a0b512ULL, 0x1303e0c57b6e8645ULL, 0xa7ce5911a9cb5e60ULL, 0xac52a06a93326442ULL,
+			0x1cfa401114d214feULL, 0x657c7edd5a6a2d11ULL, 0x74f7dfc8ad75e5beULL, 0xb93bd966433a5eb5ULL,
+			0x395abf3428c5ef4dULL, 0x3a7c844c5ed8c333ULL, 0xc6a32156c0e52c52ULL, 0x811e01f4016f91f7ULL,
+		},
+		{
+			0x5fd205755dc324cfULL, 0x8b8e6cb9d7a25c5eULL, 0x6a393c91b09a4f24ULL, 0x2419d24941d2879eULL,
+			0xcb11d3d322378c3fULL, 0x89a0d947e7359ba9ULL, 0x9ac235af1b306ee2ULL, 0xdb17fbea36289ad2ULL,
+			0x5ede9c17dedafd6bULL, 0xef0cd7b4e4ec0de6ULL, 0xa4b32cc50529ec8aULL, 0x3729e60466e76c72ULL,
+			0xbc1b968695dfd347ULL, 0x1208879d7d4bde63ULL, 0x8eccc08b8c8ddefaULL, 0x61d1b6bfda572c2dULL,
+			0x2e5bfe8ae0bfc011ULL, 0xbb93b47e50da3162ULL, 0x4dc253ba47fe4964ULL, 0x214619698f00fb1aULL,
+			0x7065de8fd6721979ULL, 0x319c324c72c708c9ULL, 0x5ef5bbc18466cf1dULL, 0xf1cae3b64977eec5ULL,
+			0x6ff929d26a842420ULL, 0xe8bab64cef650d0eULL, 0xa0fff83df2901695ULL, 0xd0ae24de4223d192ULL,
+			0xbc60367453eec23fULL, 0x6d8046b801afbc9dULL, 0x26018251926c0991ULL, 0x1a68be3a035b5707ULL,
+			0x242ae4893b70b22eULL, 0xb99c78cbc599a070ULL, 0xed8916b381e9a6e2ULL, 0x37695a55e05cd381ULL,
+			0x5c6c9c4ed6632ee1ULL, 0xcd463f48a9a8274eULL, 0x24e864649fafa6c7ULL, 0xba69a8bac9998133ULL,
+			0x292bb3d3fb84ffd6ULL, 0x32fbf0c6bd46a684ULL, 0xffa0d42a285685ceULL, 0xf8ec28585e907988ULL,
+			0x955d78582b84939bULL, 0x7a8e5ece174ec569ULL, 0x0bde70207d0f01f9ULL, 0xf9d49516f6bcd773ULL,
+			0x5ca61d38ace08deaULL, 0x73acebd3d49d7857ULL, 0xf4721387d67a23c1ULL, 0x400830fb417eed4fULL,
+			0x43613db3f0b2e10dULL, 0x0c2683675b3e7196ULL, 0x0f0a3c18070a38e0ULL, 0x00fba4231f3fd447ULL,
+			0x4a83615e584ea5bbULL, 0xd1c390e9829e2e7dULL, 0x62c7bae420fe77b5ULL, 0xca9b275e0cfacc12ULL,
+			0x6e0bb5df568d5670ULL, 0x47b0f2e81ea86cf0ULL, 0x6b4b89c9cc0875b7ULL, 0x4980af326a4b65d8ULL,
+		},
+		{
+			0x83fcc71fa8833aa3ULL, 0x327eee6ec9598964ULL, 0x04dfae11b8dcf861ULL, 0x4c3433717af5c89aULL,
+			0x22b7ba9e68349351ULL, 0x47666d1b6fcaa9e7ULL, 0x556e1ab391b34d79ULL, 0xa6a3245dd1c3fe53ULL,
+			0xa8241f6fae45b8d5ULL, 0xc1d7ed7b9c6bec16ULL, 0x9fc26e2d14919f22ULL, 0x4fc2ccc9159d054fULL,
+			0x4a6881df0c028b9bULL, 0x45a577f1bab58960ULL, 0xa1bdb57c6ca2dbc1ULL, 0xebfde16cec9e9974ULL,
+			0x4e7911ddbed4fc71ULL, 0x71e606409319727bULL, 0xdc0d879ed0bbe640ULL, 0x4293a2a13fb2fb89ULL,
+			0xaf24d14180037e79ULL, 0x53be5793563e006cULL, 0x157786cbc486d2a0ULL, 0xb0752c30eaa58544ULL,
+			0xbb61ee342e9a8210ULL, 0x635d396b1bd1da07ULL, 0x4d7c14a84bc6fdb5ULL, 0x613a9c99235d15beULL,
+			0xfb7c05e13c1703fcULL, 0x3f7d3faa5694d6aeULL, 0x21dc527f0ab4ab9bULL, 0x0251b77b538e03fcULL,
+			0x802e57a14bf8215dULL, 0x51ec9407992ac5b8ULL, 0x48a69543e5dc1734ULL, 0x22abaa84fd19e270ULL,
+			0x8f34cbb275b951ecULL, 0xdf92f91b1cb7a033ULL, 0x157f0e4ccdb056a8ULL, 0xd889bab710a7570eULL,
+			0xe180887a35c9acd9ULL, 0x16c94ed584523d02ULL, 0x3cb6b899028ba353ULL, 0xade4153860320f39ULL,
+			0x62a15d96596742b3ULL, 0xc24e3101c5ab7a66ULL, 0xd2f48e99a11767a6ULL, 0x1542a77e8df4cc9fULL,
+			0x70450553f57c306fULL, 0x6596e4bb0ab6fe55ULL, 0xb31ad51edb07e16dULL, 0x14f8ec0b2dd720c3ULL,
+			0x66623fbeb6a18744ULL, 0xbac8a59c8fc9f445ULL, 0x0134cf3de391eae9ULL, 0x3934dcea8dd8e425ULL,
+			0x50621c6ebfc34e9bULL, 0xa0d5ee425797481aULL, 0xe65f9512ff9a97f3ULL, 0x12a9fea1d634c54eULL,
+			0x043aab402beaaba8ULL, 0x3fbaaa86d4844270ULL, 0xe179606eaa9381e4ULL, 0x54238caebf32828cULL,
+		},
+		{
+			0x6e3b64d7f5c88d2bULL, 0x685f1f2fc2e6b27aULL, 0xfd8563efde1f4398ULL, 0x4423c5046aa5f8faULL,
+			0x6bcf56187d539753ULL, 0xd03a3b54209703fbULL, 0x251d485d8178acd6ULL, 0x3f66ca397592e07fULL,
+			0x552bdfce433cc6cbULL, 0x44addd817db8b4dfULL, 0xb000cbf3ce21b869ULL, 0xd2e9983a72149fb3ULL,
+			0xaf947e60ad892ed4ULL, 0x577451b6ef6afcbfULL, 0x78da7cb7c466fbfdULL, 0xd5e3634444e34975ULL,
+			0x344e8d54603a3643ULL, 0x0b8d292730b546d0ULL, 0x8acfe26983852bafULL, 0xf4fe6ba91c741977ULL,
+			0x86d2315d1e0dc68aULL, 0x8d9d062df69ee643ULL, 0x9ba452ec9b87acabULL, 0x60d53c599f2efcf5ULL,
+			0x05cf9a10ae33fd6eULL, 0xed86e1913867a31fULL, 0xcbf6a4ee31486382ULL, 0x5c088030503f61eaULL,
+			0x371da374bf0bbd06ULL, 0x67325e50cebaafc4ULL, 0x40613d7fabc27df7ULL, 0x873450e33f8ec632ULL,
+			0xc87c2173dd433a8dULL, 0xa337defd2fa45812ULL, 0xc6d6572f9c4db5f7ULL, 0x43df2a2bb9dc1f8eULL,
+			0xa949f99ae4579ae7ULL, 0x2ce95f8710af973eULL, 0x9b6f7d1586d5c2a8ULL, 0x1591bcac785b49b3ULL,
+			0xefe019ea91a1cdb3ULL, 0x0f308d530055c460ULL, 0x549cbb2ebe9b6412ULL, 0xe45cd3103ac8afb2ULL,
+			0x8956d2c6a1c2a173ULL, 0x3c6a03f08df43ecaULL, 0x515e34df346c7f59ULL, 0xdb1b56d7efbf053cULL,
+			0xad13006e7260fc0fULL, 0x9aa291b6d59d39dfULL, 0x3a91dfda8521dd07ULL, 0x30e27d3a3f4ad189ULL,
+			0x1b7cd23c60e3768eULL, 0x1e65dbab69f02d4fULL, 0x647b114c433bbaa5ULL, 0x7dcdca42f34b7db1ULL,
+			0xc9bc4616c0261cf4ULL, 0xbb980258f543d9bdULL, 0xd0867d4a79935127ULL, 0x7faa29c4257de927ULL,
+			0x7c47efc4dc9daeb3ULL, 0xfc4455323ed6a688ULL, 0xa6c803ab2fc31dc5ULL, 0xfe3316e8a126c648ULL,
+		},
+		{
+			0x0e4d6fee8331db63ULL, 0x748cfa660c95016aULL, 0xb2747dbf2bc34adfULL, 0xfa6ed441e6468e9eULL,
+			0xae42190933ffc09aULL, 0xff9c92fd3654a582ULL, 0xd33fcd8cd9e61ac5ULL, 0x371ad28c40094647ULL,
+			0x5d9dc02bb2d14812ULL, 0xaa7bf2b3524699c7ULL, 0x4cb261d764240af1ULL, 0xeb0074eb49c8f038ULL,
+			0x2235c793c6b2ec94ULL, 0x326ce3de14b10487ULL, 0x7d26c935d601635cULL, 0xfb023c83c005f89bULL,
+			0x7a7abfe47cf11a74ULL, 0x326d14295729a098ULL, 0x4051c8e5a0e36e25ULL, 0xad5fb3df4788ab9bULL,
+			0xa06e91e446927881ULL, 0x24765f3e77532660ULL, 0x4ba5bdc5384f18c4ULL, 0xc7f4e017f8732292ULL,
+			0x6e992a983b7edde2ULL, 0x8e833aefb26a1864ULL, 0x1ba3adee92f08807ULL, 0xd033c438ac3973adULL,
+			0x109596208f6b9577ULL, 0xc15e6593e972512aULL, 0xcac8e49bb608b4daULL, 0x8d2dda6d5c05dbe7ULL,
+			0x61059bbb11e53600ULL, 0x890dd6765d924d3bULL, 0x326a9a09a42a8f64ULL, 0xba22ce1e7d55ac2eULL,
+			0x6e3070eca2371016ULL, 0x4e6545c9f7372bbfULL, 0x44285c955996db95ULL, 0xc2c610e81ca500cdULL,
+			0x6a2cf7bbc4f311bdULL, 0xfc4b27eaf1ce13b0ULL, 0xb82b569d4298bdeaULL, 0x73cbe4a05d9c604aULL,
+			0x0d0608d17a2f7994ULL, 0xcf7e1d758bc7f5b5ULL, 0x449c532e01903840ULL, 0x109385b3578bc434ULL,
+			0x5b0d87c9fca26014ULL, 0x491c73c8f628c62aULL, 0x3079ee10edbe7ba1ULL, 0x0cff6b3d3e6c15b8ULL,
+			0x1d6b458f2c076c70ULL, 0xc61d459c911f3537ULL, 0xda68adbdc675be53ULL, 0x8de990e037753ab0ULL,
+			0xa6092d6f9f9e0b84ULL, 0x5b3b3a90aa6ac400ULL, 0x66598cc7b6406583ULL, 0x1ca70aee97a1b837ULL,
+			0xaf82a4ce58ef93b7ULL, 0xc7ce4b9b13282484ULL, 0x2b889662669711b0ULL, 0x994f1f541e8ec4b1ULL,
+		},
+		{
+			0xa04691fbe4451815ULL, 0xe7450f8101bd21d5ULL, 0xaa94a8216c7141a7ULL, 0x06316d1c8dd41b5cULL,
+			0xfe600c367a8aa52bULL, 0x0577481e942a07a3ULL, 0x1a3704f86eefde92ULL, 0x1ddd864f1b50782bULL,
+			0x4e6e17f5f3b362dbULL, 0x36c4e9881a205ff0ULL, 0x87615288d5788a80ULL, 0xf0ef34e4bd45b3fcULL,
+			0x1bc57badac418d9eULL, 0x9fc338c00035d21bULL, 0x17dda7edf8cea21bULL, 0x9bdae11a59ed17e3ULL,
+			0x9aeb37281961af39ULL, 0x426ac051d05d0541ULL, 0x1f6bf9fcbd650853ULL, 0xb6b485c32054d2dbULL,
+			0x33cd737c1bd48bbcULL, 0xbf7d815f20c6aa90ULL, 0xbddcaa250dae14baULL, 0xeadf33672f2eef00ULL,
+			0x1dfcf9099f404e93ULL, 0x9322250b5159a644ULL, 0xf317f503a92d62bfULL, 0xc81c284dd319fe2fULL,
+			0x6c99b2aac29b7da3ULL, 0x09654e59fe299319ULL, 0x7fac22d4a36c1cdbULL, 0x031c79fc0e5d0ba8ULL,
+			0x6786f2a8b25df1e6ULL, 0xc5d9b45dc06a2973ULL, 0x494c1be2f16aa7e5ULL, 0xcd6572b288330281ULL,
+			0x1fec2ad7e539e591ULL, 0x70ff92eac7d644ebULL, 0xa23a58e2a5158332ULL, 0x8097046c8febebb5ULL,
+			0xf48ef92917693662ULL, 0xc768ecaf06040013ULL, 0x64da73f83a1654d7ULL, 0x4653bf0aa21d2e83ULL,
+			0x89ceaa06806a3ab2ULL, 0x11266d2e4dc768e4ULL, 0x72e16539c447b502ULL, 0xfa65940fded7d4c1ULL,
+			0x4d12ed9b2035457cULL, 0xe945d4cb35ed57edULL, 0x75d44c13bffb0f19ULL, 0xf690c8970c88d47aULL,
+			0xe1ae0e7fc137e303ULL, 0x5ce6c3417289b541ULL, 0xd71c344eab53f9bfULL, 0xac337044a96df7afULL,
+			0xafe25963a3014e07ULL, 0x5b92f7a78b315407ULL, 0x120a9962ff1fa138ULL, 0xbec62925bc2c2731ULL,
+			0x840784564071255bULL, 0xb96ac0ee3219851fULL, 0x2b686d2aaf437b55ULL, 0x862caf81e41a1a19ULL,
+		},
+	},
+};
+
+
+const uint64_t zobrist_castling_keys[2][2] = {
+	{0x1c787a8631a3cc4cULL, 0xada2b6b30a0fbd78ULL},
+	{0xe9bff1ac37cd3760ULL, 0x5b1c44f240a786dfULL},
+};
+
+
+const uint64_t zobrist_en_passant_keys[8] = {
+	0xdd2e5d6f2b4b30d5ULL, 0x74cdd16b7f0fb3c4ULL, 0x39edba15ba6d5deaULL, 0x893a48adc5c59fc3ULL,
+	0x5d88d67ac62f910aULL, 0x6637c1ce6357a2c8ULL, 0xfc7b432fba88a23cULL, 0xcbd18ebcd1f9b00dULL,
+};
+
+
+const uint64_t zobrist_side_key = 0xcc5d77cdfdf2f139ULL;
+
+
+uint64_t compute_hash(Board* board_ptr) {
+	uint64_t hash = 0;
+
+	for (Colour colour = WHITE; colour <= BLACK; colour++) {
+		for (int i = 0; i < 16; i++) {
+			Piece* piece_ptr = &board_ptr->player_pieces[colour][i];
+			if (piece_ptr->alive) {
+				hash ^= zobrist_piece_keys[colour][piece_ptr->type][piece_ptr->square];
+			}
+		}
+		if (board_ptr->castling_rights[colour][KINGSIDE]) {
+			hash ^= zobrist_castling_keys[colour][KINGSIDE];
+		}
+		if (board_ptr->castling_rights[colour][QUEENSIDE]) {
+			hash ^= zobrist_castling_keys[colour][QUEENSIDE];
+		}
+	}
+
+	if (board_ptr->en_passant_target != NONE) {
+		hash ^= zobrist_en_passant_keys[board_ptr->en_passant_target % 8];
+	}
+	if (board_ptr->current_turn == BLACK) {
+		hash ^= zobrist_side_key;
+	}
+
+	return hash;
+}
+
+
+/* Keyed on how many pieces of each kind there are, not where they stand:
+   the nth piece of a kind xors in the key it would have on square n */
+uint64_t compute_material_key(Board* board_ptr) {
+	uint64_t key = 0;
+	for (Colour colour = WHITE; colour <= BLACK; colour++) {
+		for (PieceType type = PAWN; type <= KING; type++) {
+			for (int i = 0; i < board_ptr->piece_counts[colour][type]; i++) {
+				key ^= zobrist_piece_keys[colour][type][i];
+			}
+		}
+	}
+	return key;
+}
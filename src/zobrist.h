@@ -0,0 +1,20 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+
+#include <stdint.h>  // for uint64_t
+#include "chess.h"
+
+
+extern const uint64_t zobrist_piece_keys[2][6][64];
+extern const uint64_t zobrist_castling_keys[2][2];
+extern const uint64_t zobrist_en_passant_keys[8];
+extern const uint64_t zobrist_side_key;
+
+
+/* FUNCTION DEFINITIONS */
+uint64_t compute_hash(Board* board_ptr);
+uint64_t compute_material_key(Board* board_ptr);
+
+
+#endif  /* ZOBRIST_H */